@@ -0,0 +1,51 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef COMMON_HOST_TREE
+#define COMMON_HOST_TREE
+
+#include <stdint.h>
+
+struct host_tree_entry;
+struct host_tree_entry {
+    struct host_tree_entry *next;
+    struct host_tree_entry *children;
+    char *name;
+    char *path;
+    uint64_t size;
+    uint8_t is_directory;
+    void *assoc_info;
+};
+typedef struct host_tree_entry * host_tree_entry_t;
+
+struct host_tree {
+    host_tree_entry_t root;
+    uint32_t file_count;
+    uint32_t directory_count;
+    uint64_t total_size;
+};
+typedef struct host_tree * host_tree_t;
+
+host_tree_t host_tree_scan(const char *path);
+void host_tree_destroy(host_tree_t tree);
+
+#endif
@@ -24,5 +24,6 @@
 #define COMMON_HOST
 
 const char *host_expand_path(const char *path);
+char *host_join_path(const char *dir, const char *name);
 
 #endif
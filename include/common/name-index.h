@@ -0,0 +1,66 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef COMMON_NAME_INDEX
+#define COMMON_NAME_INDEX
+
+#include <stdint.h>
+
+#define NAME_INDEX_NONE UINT32_MAX
+
+struct name_index_slot {
+    uint32_t hash;
+    uint32_t entry;
+};
+
+/// An open addressed hash table mapping the hash of a normalised directory
+/// entry name to the index of that entry within its directory. An entry may
+/// be present under more than one hash, such as those of both the short and
+/// long names of a FAT entry. The table does not store the names themselves,
+/// so a candidate must always be confirmed against the entry it refers to.
+struct name_index {
+    uint32_t capacity;
+    uint32_t count;
+    struct name_index_slot *slots;
+};
+
+uint32_t name_hash(const uint8_t *name, uint32_t len);
+uint32_t folded_name_hash(const char *name);
+
+void name_index_init(struct name_index *index, uint32_t expected);
+void name_index_destroy(struct name_index *index);
+
+void name_index_insert(struct name_index *index,
+                       uint32_t hash,
+                       uint32_t entry);
+void name_index_remove(struct name_index *index,
+                       uint32_t hash,
+                       uint32_t entry);
+
+uint32_t name_index_first(struct name_index *index,
+                          uint32_t hash,
+                          uint32_t *cursor);
+uint32_t name_index_next(struct name_index *index,
+                         uint32_t hash,
+                         uint32_t *cursor);
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef COMMON_SLOT_MAP
+#define COMMON_SLOT_MAP
+
+#include <stdint.h>
+
+#define SLOT_MAP_NONE UINT32_MAX
+
+/// A bitmap of the free entries of a directory, used to locate the lowest
+/// numbered free entry without walking the directory.
+struct slot_map {
+    uint32_t count;
+    uint32_t hint;
+    uint64_t *bits;
+};
+
+void slot_map_init(struct slot_map *map, uint32_t count);
+void slot_map_destroy(struct slot_map *map);
+void slot_map_resize(struct slot_map *map, uint32_t count);
+
+void slot_map_set_free(struct slot_map *map, uint32_t entry);
+void slot_map_set_used(struct slot_map *map, uint32_t entry);
+uint32_t slot_map_first_free(struct slot_map *map);
+uint32_t slot_map_first_free_run(struct slot_map *map, uint32_t length);
+
+#endif
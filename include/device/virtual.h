@@ -34,6 +34,7 @@ struct vdev {
     const char *path;
     FILE *handle;
     uint32_t sector_size;
+    uint32_t total_sectors;
     enum vmedia_type media;
 };
 
@@ -49,6 +50,8 @@ uint32_t device_total_sectors(vdevice_t device);
 
 uint8_t *device_read_sector(vdevice_t device, uint32_t sector);
 uint8_t *device_read_sectors(vdevice_t device, uint32_t sector, uint32_t n);
+void device_read_sectors_into(vdevice_t device, uint32_t sector, uint32_t n,
+                              uint8_t *data);
 
 void device_write_sector(vdevice_t device, uint32_t sector, uint8_t *data);
 void device_write_sectors(vdevice_t device, uint32_t sector, uint32_t n,
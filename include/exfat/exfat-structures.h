@@ -0,0 +1,221 @@
+/*
+  Copyright (c) 2017 Tom Hancocks
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <common/name-index.h>
+#include <common/slot-map.h>
+#include <common/arena.h>
+
+#ifndef EXFAT_STRUCTURES
+#define EXFAT_STRUCTURES
+
+struct vfs_node;
+struct vfs_extent_list;
+
+#define EXFAT_FS_NAME  "EXFAT   "
+#define EXFAT_BOOT_SIGNATURE  0xAA55
+#define EXFAT_EXTENDED_BOOT_SIGNATURE  0xAA550000
+#define EXFAT_REVISION  0x0100
+
+/// The main boot sector. It is followed by eight extended boot sectors, the
+/// OEM parameters, a reserved sector and a checksum of everything before it,
+/// and the whole region is then repeated as a backup.
+struct exfat_boot_sector {
+	uint8_t jmp[3];
+	uint8_t fs_name[8];
+	uint8_t must_be_zero[53];
+	uint64_t partition_offset;
+	uint64_t volume_length;
+	uint32_t fat_offset;
+	uint32_t fat_length;
+	uint32_t cluster_heap_offset;
+	uint32_t cluster_count;
+	uint32_t root_cluster;
+	uint32_t volume_serial;
+	uint16_t revision;
+	uint16_t volume_flags;
+	uint8_t bytes_per_sector_shift;
+	uint8_t sectors_per_cluster_shift;
+	uint8_t fat_count;
+	uint8_t drive_select;
+	uint8_t percent_in_use;
+	uint8_t reserved[7];
+	uint8_t boot_code[390];
+	uint16_t boot_signature;
+} __attribute__((packed));
+typedef struct exfat_boot_sector * exfat_boot_sector_t;
+
+enum exfat_entry_type {
+	exfat_entry_end = 0x00,
+	exfat_entry_in_use = 0x80,
+	exfat_entry_bitmap = 0x81,
+	exfat_entry_upcase = 0x82,
+	exfat_entry_label = 0x83,
+	exfat_entry_file = 0x85,
+	exfat_entry_stream = 0xC0,
+	exfat_entry_name = 0xC1,
+};
+
+/// Set in the flags of a stream entry when the file has clusters, and when
+/// those clusters are one contiguous run that has no chain in the FAT.
+#define EXFAT_FLAG_ALLOCATION_POSSIBLE  0x01
+#define EXFAT_FLAG_NO_FAT_CHAIN  0x02
+
+#define EXFAT_NAME_CHARS_PER_ENTRY  15
+#define EXFAT_NAME_MAX_LENGTH  255
+
+struct exfat_file_entry {
+	uint8_t type;
+	uint8_t secondary_count;
+	uint16_t checksum;
+	uint16_t attributes;
+	uint16_t reserved1;
+	uint32_t create_time;
+	uint32_t modify_time;
+	uint32_t access_time;
+	uint8_t create_10ms;
+	uint8_t modify_10ms;
+	uint8_t create_utc_offset;
+	uint8_t modify_utc_offset;
+	uint8_t access_utc_offset;
+	uint8_t reserved2[7];
+} __attribute__((packed));
+
+struct exfat_stream_entry {
+	uint8_t type;
+	uint8_t flags;
+	uint8_t reserved1;
+	uint8_t name_length;
+	uint16_t name_hash;
+	uint16_t reserved2;
+	uint64_t valid_data_length;
+	uint32_t reserved3;
+	uint32_t first_cluster;
+	uint64_t data_length;
+} __attribute__((packed));
+
+struct exfat_name_entry {
+	uint8_t type;
+	uint8_t flags;
+	uint16_t name[EXFAT_NAME_CHARS_PER_ENTRY];
+} __attribute__((packed));
+
+struct exfat_bitmap_entry {
+	uint8_t type;
+	uint8_t flags;
+	uint8_t reserved[18];
+	uint32_t first_cluster;
+	uint64_t data_length;
+} __attribute__((packed));
+
+struct exfat_upcase_entry {
+	uint8_t type;
+	uint8_t reserved1[3];
+	uint32_t checksum;
+	uint8_t reserved2[12];
+	uint32_t first_cluster;
+	uint64_t data_length;
+} __attribute__((packed));
+
+struct exfat_label_entry {
+	uint8_t type;
+	uint8_t length;
+	uint16_t label[11];
+	uint8_t reserved[8];
+} __attribute__((packed));
+
+union exfat_dir_entry {
+	struct exfat_file_entry file;
+	struct exfat_stream_entry stream;
+	struct exfat_name_entry name;
+	struct exfat_bitmap_entry bitmap;
+	struct exfat_upcase_entry upcase;
+	struct exfat_label_entry label;
+	uint8_t raw[32];
+};
+
+/// The parts of an entry set that the driver works with. Every node of an
+/// exFAT directory refers to one of these, and the entry set is rebuilt from
+/// it whenever it changes. The root directory has no entry set, but is
+/// described in the same way, and must always be chained through the FAT.
+struct exfat_entry {
+	struct exfat_directory *parent;
+	uint32_t index;
+	uint32_t slot_count;
+	uint16_t attributes;
+	uint16_t name_hash;
+	uint32_t create_time;
+	uint32_t modify_time;
+	uint32_t access_time;
+	uint32_t first_cluster;
+	uint64_t data_length;
+	uint64_t valid_data_length;
+	uint8_t is_contiguous:1;
+	uint8_t needs_chain:1;
+	uint8_t reserved:6;
+};
+
+/// The contents of a directory, held in memory from when it is first needed
+/// until the volume is unmounted. Entry sets are kept in their raw form, with
+/// a node for each file indexed by the slot its file entry occupies.
+struct exfat_directory {
+	struct exfat_directory *next;
+	struct exfat_entry *entry;
+	struct vfs_extent_list *extents;
+	uint8_t *data;
+	uint32_t slot_count;
+	struct vfs_node **nodes;
+	struct vfs_node *end;
+	struct name_index names;
+	struct slot_map free_slots;
+	struct arena arena;
+	uint8_t is_dirty:1;
+	uint8_t reserved:7;
+};
+
+struct exfat_file {
+	struct exfat_directory *dir;
+};
+
+struct exfat {
+	exfat_boot_sector_t boot;
+	uint32_t bytes_per_cluster;
+	uint16_t *upcase;
+	uint8_t *bitmap;
+	struct vfs_extent_list *bitmap_extents;
+	uint32_t bitmap_dirty_first;
+	uint32_t bitmap_dirty_last;
+	uint32_t free_count;
+	uint32_t next_free_cluster;
+	uint8_t *fat_sector;
+	uint32_t fat_sector_index;
+	struct exfat_entry root_entry;
+	struct exfat_directory *root;
+	struct exfat_directory *directories;
+	struct exfat_directory *current_dir;
+	uint8_t fat_dirty:1;
+	uint8_t bitmap_dirty:1;
+	uint8_t reserved:6;
+};
+typedef struct exfat * exfat_t;
+
+#endif
@@ -0,0 +1,287 @@
+/*
+  Copyright (c) 2017 Tom Hancocks
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <common/name-index.h>
+#include <common/arena.h>
+
+#ifndef EXT2_STRUCTURES
+#define EXT2_STRUCTURES
+
+struct vfs_node;
+struct vfs_extent_list;
+
+#define EXT2_SUPER_MAGIC  0xEF53
+#define EXT2_SUPERBLOCK_OFFSET  1024
+#define EXT2_SUPERBLOCK_SIZE  1024
+
+#define EXT2_GOOD_OLD_REV  0
+#define EXT2_DYNAMIC_REV  1
+#define EXT2_GOOD_OLD_INODE_SIZE  128
+#define EXT2_GOOD_OLD_FIRST_INO  11
+
+#define EXT2_ROOT_INO  2
+
+/// The features the driver understands. A volume using any other incompatible
+/// or read only compatible feature is refused, as it can not be written
+/// safely.
+#define EXT2_FEATURE_INCOMPAT_FILETYPE  0x0002
+#define EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER  0x0001
+#define EXT2_FEATURE_RO_COMPAT_LARGE_FILE  0x0002
+
+#define EXT2_VALID_FS  0x0001
+#define EXT2_ERRORS_CONTINUE  1
+
+/// The first twelve blocks of a file are mapped directly by its inode, and the
+/// rest through a single, double and triple indirect block.
+#define EXT2_NDIR_BLOCKS  12
+#define EXT2_IND_BLOCK  12
+#define EXT2_DIND_BLOCK  13
+#define EXT2_TIND_BLOCK  14
+#define EXT2_N_BLOCKS  15
+
+/// Set on a directory that carries a hashed index alongside its entries. The
+/// index is not maintained by the driver, so the flag is cleared whenever such
+/// a directory is modified.
+#define EXT2_INDEX_FL  0x00001000
+
+enum ext2_file_mode {
+	ext2_mode_type_mask = 0xF000,
+	ext2_mode_fifo = 0x1000,
+	ext2_mode_char_device = 0x2000,
+	ext2_mode_directory = 0x4000,
+	ext2_mode_block_device = 0x6000,
+	ext2_mode_regular = 0x8000,
+	ext2_mode_symlink = 0xA000,
+	ext2_mode_socket = 0xC000,
+	ext2_mode_write_bits = 0x0092,
+};
+
+enum ext2_file_type {
+	ext2_file_type_unknown = 0,
+	ext2_file_type_regular = 1,
+	ext2_file_type_directory = 2,
+	ext2_file_type_char_device = 3,
+	ext2_file_type_block_device = 4,
+	ext2_file_type_fifo = 5,
+	ext2_file_type_socket = 6,
+	ext2_file_type_symlink = 7,
+};
+
+/// The superblock, found 1024 bytes into the volume regardless of the block
+/// size. Copies are kept at the start of some or all of the block groups.
+struct ext2_superblock {
+	uint32_t inodes_count;
+	uint32_t blocks_count;
+	uint32_t r_blocks_count;
+	uint32_t free_blocks_count;
+	uint32_t free_inodes_count;
+	uint32_t first_data_block;
+	uint32_t log_block_size;
+	uint32_t log_frag_size;
+	uint32_t blocks_per_group;
+	uint32_t frags_per_group;
+	uint32_t inodes_per_group;
+	uint32_t mtime;
+	uint32_t wtime;
+	uint16_t mnt_count;
+	uint16_t max_mnt_count;
+	uint16_t magic;
+	uint16_t state;
+	uint16_t errors;
+	uint16_t minor_rev_level;
+	uint32_t lastcheck;
+	uint32_t checkinterval;
+	uint32_t creator_os;
+	uint32_t rev_level;
+	uint16_t def_resuid;
+	uint16_t def_resgid;
+	uint32_t first_ino;
+	uint16_t inode_size;
+	uint16_t block_group_nr;
+	uint32_t feature_compat;
+	uint32_t feature_incompat;
+	uint32_t feature_ro_compat;
+	uint8_t uuid[16];
+	char volume_name[16];
+	char last_mounted[64];
+	uint32_t algorithm_usage_bitmap;
+	uint8_t prealloc_blocks;
+	uint8_t prealloc_dir_blocks;
+	uint16_t padding1;
+	uint8_t journal_uuid[16];
+	uint32_t journal_inum;
+	uint32_t journal_dev;
+	uint32_t last_orphan;
+	uint32_t hash_seed[4];
+	uint8_t def_hash_version;
+	uint8_t padding2[3];
+	uint32_t default_mount_opts;
+	uint32_t first_meta_bg;
+	uint8_t reserved[760];
+} __attribute__((packed));
+typedef struct ext2_superblock * ext2_superblock_t;
+
+/// Describes where the bitmaps and inode table of a block group are, and how
+/// much of the group is still free. The descriptors of all of the groups are
+/// packed together in the blocks following the superblock.
+struct ext2_group_descriptor {
+	uint32_t block_bitmap;
+	uint32_t inode_bitmap;
+	uint32_t inode_table;
+	uint16_t free_blocks_count;
+	uint16_t free_inodes_count;
+	uint16_t used_dirs_count;
+	uint16_t pad;
+	uint8_t reserved[12];
+} __attribute__((packed));
+
+/// The leading part of an inode that is common to every revision. Larger
+/// inodes carry extra fields beyond it, which the driver preserves. Every
+/// field is naturally aligned, so the block map can be used in place.
+struct ext2_inode {
+	uint16_t mode;
+	uint16_t uid;
+	uint32_t size;
+	uint32_t atime;
+	uint32_t ctime;
+	uint32_t mtime;
+	uint32_t dtime;
+	uint16_t gid;
+	uint16_t links_count;
+	uint32_t blocks;
+	uint32_t flags;
+	uint32_t osd1;
+	uint32_t block[EXT2_N_BLOCKS];
+	uint32_t generation;
+	uint32_t file_acl;
+	uint32_t size_high;
+	uint32_t faddr;
+	uint8_t osd2[12];
+};
+
+/// A directory entry. Entries are a multiple of four bytes long, and the
+/// record length of the last one in a block always reaches the end of the
+/// block. An entry with an inode number of zero is unused.
+struct ext2_dir_entry {
+	uint32_t inode;
+	uint16_t rec_len;
+	uint8_t name_len;
+	uint8_t file_type;
+	char name[];
+} __attribute__((packed));
+
+#define EXT2_DIR_ENTRY_HEADER  8
+#define EXT2_NAME_MAX_LENGTH  255
+
+/// An inode that the driver has read, shared by every directory entry that
+/// links to it. Inodes stay in memory until the volume is unmounted, and are
+/// written back when they are synced.
+struct ext2_inode_info {
+	struct ext2_inode_info *next;
+	uint32_t number;
+	struct ext2_inode disk;
+	uint8_t is_dirty:1;
+	uint8_t is_new:1;
+	uint8_t reserved:6;
+};
+
+/// What a node of an ext2 directory refers to. The entry is identified by
+/// the offset of its record within the directory.
+struct ext2_entry {
+	struct ext2_directory *parent;
+	uint32_t offset;
+	struct ext2_inode_info *inode;
+};
+
+/// The contents of a directory, held in memory from when it is first needed
+/// until the volume is unmounted. The records are kept in their raw form,
+/// with a node for each entry indexed by the offset of its record. The space
+/// left over in each block is tracked so that new entries can be placed
+/// without walking the whole directory.
+struct ext2_directory {
+	struct ext2_directory *next;
+	struct ext2_inode_info *inode;
+	struct ext2_entry self;
+	struct vfs_extent_list *extents;
+	uint8_t *data;
+	uint32_t size;
+	uint32_t block_count;
+	uint32_t *slack;
+	struct vfs_node **nodes;
+	struct vfs_node *end;
+	struct name_index names;
+	struct arena arena;
+	uint8_t is_dirty:1;
+	uint8_t reserved:7;
+};
+
+struct ext2_file {
+	struct ext2_directory *dir;
+};
+
+/// A small write back cache of metadata blocks, used for the inode tables and
+/// indirect blocks.
+struct ext2_cached_block {
+	uint32_t number;
+	uint8_t *data;
+	uint8_t is_dirty:1;
+	uint8_t reserved:7;
+};
+
+#define EXT2_CACHED_BLOCKS  16
+
+/// The bitmaps of a block group, read when the group is first allocated from.
+struct ext2_group {
+	uint8_t *block_bitmap;
+	uint8_t *inode_bitmap;
+	uint8_t block_bitmap_dirty:1;
+	uint8_t inode_bitmap_dirty:1;
+	uint8_t reserved:6;
+};
+
+struct ext2 {
+	ext2_superblock_t superblock;
+	uint32_t block_size;
+	uint32_t sectors_per_block;
+	uint32_t inode_size;
+	uint32_t group_count;
+	struct ext2_group_descriptor *descriptors;
+	uint32_t descriptor_blocks;
+	struct ext2_group *groups;
+	struct ext2_cached_block cache[EXT2_CACHED_BLOCKS];
+	uint32_t cache_victim;
+	struct ext2_inode_info **inodes;
+	uint32_t inode_capacity;
+	uint32_t inode_count;
+	struct arena inode_arena;
+	struct ext2_directory *root;
+	struct ext2_directory *directories;
+	struct ext2_directory *current_dir;
+	uint8_t has_filetype:1;
+	uint8_t descriptors_dirty:1;
+	uint8_t superblock_dirty:1;
+	uint8_t reserved:5;
+};
+typedef struct ext2 * ext2_t;
+
+#endif
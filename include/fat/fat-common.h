@@ -21,10 +21,15 @@
 */
 
 #include <stdint.h>
+#include <fat/fat-index.h>
+#include <common/slot-map.h>
+#include <common/arena.h>
 
 #ifndef FAT_COMMON
 #define FAT_COMMON
 
+struct vfs_extent_list;
+
 struct fat_sfn {
 	uint8_t name[11];
 	uint8_t attribute;
@@ -33,7 +38,7 @@ struct fat_sfn {
 	uint16_t ctime;
 	uint16_t cdate;
 	uint16_t adate;
-	uint16_t unused;
+	uint16_t first_cluster_hi;
 	uint16_t mtime;
 	uint16_t mdate;
 	uint16_t first_cluster;
@@ -41,11 +46,109 @@ struct fat_sfn {
 } __attribute__((packed));
 typedef struct fat_sfn * fat_sfn_t;
 
+struct fat_lfn {
+	uint8_t ordinal;
+	uint16_t name1[5];
+	uint8_t attribute;
+	uint8_t type;
+	uint8_t checksum;
+	uint16_t name2[6];
+	uint16_t first_cluster;
+	uint16_t name3[2];
+} __attribute__((packed));
+
+/// A raw directory entry, which holds either a short name or one part of a
+/// long name.
+union fat_dir_entry {
+	struct fat_sfn sfn;
+	struct fat_lfn lfn;
+	uint8_t raw[32];
+};
+
+struct fat_sfn_details {
+	uint8_t nt_reserved;
+	uint8_t ctime_ms;
+	uint16_t ctime;
+	uint16_t cdate;
+	uint16_t adate;
+	uint16_t first_cluster_hi;
+	uint16_t mtime;
+	uint16_t mdate;
+} __attribute__((packed));
+
+/// The entries of a directory, split into one array per field. The names are
+/// packed back to back so that scanning them touches as little memory as
+/// possible. The fields that are rarely consulted are kept together.
+struct fat_directory_columns {
+	uint8_t (*names)[11];
+	uint8_t *attributes;
+	uint32_t *sizes;
+	uint16_t *first_clusters;
+	struct fat_sfn_details *details;
+	char **long_names;
+};
+
 struct fat_directory_buffer {
+	struct fat_directory_buffer *prev;
+	struct fat_directory_buffer *next;
 	struct fat_sfn sfn;
 	uint32_t index;
-	struct vfs_node *first_child;
-	struct vfs_node *last_child;
+	struct fat_directory_columns columns;
+	struct vfs_node **entries;
+	uint32_t entry_count;
+	uint32_t end;
+	struct name_index names;
+	struct fat_tail_index tails;
+	struct slot_map free_entries;
+	struct vfs_extent_list *extents;
+	struct arena arena;
+	uint32_t pin_count;
+	uint8_t is_dirty:1;
+	uint8_t is_indexed:1;
+	uint8_t reserved:6;
+};
+
+struct fat_file {
+	struct fat_directory_buffer *dir;
+	uint32_t cluster_count;
+	uint32_t last_cluster;
+	uint32_t cluster_index;
+	uint32_t cluster;
+};
+
+/// A file that has had clusters reserved beyond its end. The directory holding
+/// it stays in the cache, so that the chain can be cut back to the size of the
+/// file when the volume is unmounted.
+struct fat_reservation {
+	struct fat_reservation *next;
+	struct fat_directory_buffer *dir;
+	struct vfs_node *node;
+};
+
+struct fat_dentry_cache {
+	struct fat_directory_buffer *most_recent;
+	struct fat_directory_buffer *least_recent;
+	uint32_t count;
+};
+
+/// A run of sectors of the allocation table that is held in memory. When it
+/// is flushed, the same sectors of every copy of the table are written.
+struct fat_table_page {
+	struct fat_table_page *prev;
+	struct fat_table_page *next;
+	uint32_t index;
+	uint8_t *data;
+	uint8_t is_dirty:1;
+	uint8_t reserved:7;
+};
+
+/// The pages of the allocation table that are resident, ordered from the
+/// most recently used to the least.
+struct fat_table_cache {
+	struct fat_table_page *most_recent;
+	struct fat_table_page *least_recent;
+	uint32_t count;
+	uint32_t dirty_count;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+/*
+  Copyright (c) 2017 Tom Hancocks
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <stdint.h>
+
+#include <common/name-index.h>
+
+#ifndef FAT_INDEX
+#define FAT_INDEX
+
+#define FAT_INDEX_NONE	NAME_INDEX_NONE
+
+struct fat_tail_slot {
+	uint8_t basis[11];
+	uint32_t next;
+};
+
+/// The numeric tails handed out for the short names of a directory. A short
+/// name that can not reproduce the name it was made from is identified by its
+/// basis, the name it would have with a tail of one, and the table records
+/// the next tail worth trying for each basis. Tails are never handed out
+/// twice without the directory being reloaded, so generating many similar
+/// names stays linear.
+struct fat_tail_index {
+	uint32_t capacity;
+	uint32_t count;
+	struct fat_tail_slot *slots;
+};
+
+void fat_tail_index_destroy(struct fat_tail_index *index);
+uint32_t *fat_tail_index_next(struct fat_tail_index *index,
+                              const uint8_t *basis);
+
+#endif
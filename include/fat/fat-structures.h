@@ -23,10 +23,10 @@
 #include <stdint.h>
 #include <fat/fat-common.h>
 
-#ifndef FAT12_STRUCTURES
-#define FAT12_STRUCTURES
+#ifndef FAT_STRUCTURES
+#define FAT_STRUCTURES
 
-struct fat12_bpb {
+struct fat_bpb {
 	uint8_t jmp[3];
 	uint8_t oem[8];
 	uint16_t bytes_per_sector;
@@ -50,13 +50,16 @@ struct fat12_bpb {
 	uint8_t boot_code[448];
 	uint16_t boot_signature;
 } __attribute__((packed));
-typedef struct fat12_bpb * fat12_bpb_t;
+typedef struct fat_bpb * fat_bpb_t;
 
-struct fat12 {
-	fat12_bpb_t bpb;
-	uint8_t *fat_data;
-	struct fat_directory_buffer current_dir;
+struct fat {
+	fat_bpb_t bpb;
+	struct fat_table_cache table;
+	struct fat_directory_buffer *current_dir;
+	struct fat_dentry_cache dentries;
+	struct fat_reservation *reservations;
+	uint32_t next_free_cluster;
 };
-typedef struct fat12 * fat12_t;
+typedef struct fat * fat_t;
 
 #endif
@@ -23,15 +23,15 @@
 #include <vfs/interface.h>
 #include <device/virtual.h>
 #include <fat/fat-common.h>
-#include <fat/fat12-structures.h>
+#include <fat/fat-structures.h>
 
 #ifndef FAT12
 #define FAT12
 
-struct fat12_bpb;
+struct fat_bpb;
 
 vfs_interface_t fat12_init();
 
-uint8_t fat12_test(vdevice_t dev, struct fat12_bpb **bpb_out);
+uint8_t fat12_test(vdevice_t dev, struct fat_bpb **bpb_out);
 
 #endif
@@ -41,22 +41,53 @@ struct fat32_extended_bpb {
 	uint16_t heads;
 	uint32_t hidden_sectors;
 	uint32_t total_sectors_32;
+	uint32_t sectors_per_fat_32;
+	uint16_t flags;
+	uint16_t version;
+	uint32_t root_cluster;
+	uint16_t fs_info;
+	uint16_t backup_boot;
+	uint8_t reserved[12];
 	uint8_t drive;
 	uint8_t nt_reserved;
 	uint8_t signature;
 	uint32_t volume_id;
 	uint8_t label[11];
 	uint8_t system_id[8];
-	// ...additions here...
+	uint8_t boot_code[420];
 	uint16_t boot_signature;
 } __attribute__((packed));
 typedef struct fat32_extended_bpb * fat32_extended_bpb_t;
 
+#define FAT32_FSINFO_LEAD_SIGNATURE  0x41615252
+#define FAT32_FSINFO_SIGNATURE  0x61417272
+#define FAT32_FSINFO_TRAIL_SIGNATURE  0xAA550000
+#define FAT32_FSINFO_UNKNOWN  0xFFFFFFFF
+
+/// The FSInfo sector, which carries hints that save scanning the table. Either
+/// of the hints may be FAT32_FSINFO_UNKNOWN.
+struct fat32_fsinfo {
+	uint32_t lead_signature;
+	uint8_t reserved1[480];
+	uint32_t signature;
+	uint32_t free_count;
+	uint32_t next_free;
+	uint8_t reserved2[12];
+	uint32_t trail_signature;
+} __attribute__((packed));
+typedef struct fat32_fsinfo * fat32_fsinfo_t;
+
 struct fat32 {
-	fat32_extended_bpb_t ebpb;
-	uint8_t *fat_data;
-	struct fat_directory_buffer current_dir;
+	fat32_extended_bpb_t bpb;
+	struct fat_table_cache table;
+	struct fat_directory_buffer *current_dir;
+	struct fat_dentry_cache dentries;
+	struct fat_reservation *reservations;
+	uint32_t next_free_cluster;
+	uint32_t free_count;
+	uint8_t fsinfo_dirty:1;
+	uint8_t reserved:7;
 };
 typedef struct fat32 * fat32_t;
 
-#endif
\ No newline at end of file
+#endif
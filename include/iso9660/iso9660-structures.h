@@ -0,0 +1,188 @@
+/*
+  Copyright (c) 2017 Tom Hancocks
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <common/name-index.h>
+#include <common/arena.h>
+
+#ifndef ISO9660_STRUCTURES
+#define ISO9660_STRUCTURES
+
+struct vfs_node;
+
+/// The volume descriptors start after a system area of 16 sectors. Both are
+/// measured in 2048 byte sectors, whatever the logical block size.
+#define ISO9660_DESCRIPTOR_SECTOR_SIZE  2048
+#define ISO9660_FIRST_DESCRIPTOR  16
+#define ISO9660_STANDARD_ID  "CD001"
+
+#define ISO9660_ROOT_DIRECTORY  1
+
+enum iso9660_descriptor_type {
+	iso9660_boot_record = 0,
+	iso9660_primary_descriptor = 1,
+	iso9660_supplementary_descriptor = 2,
+	iso9660_partition_descriptor = 3,
+	iso9660_descriptor_terminator = 255,
+};
+
+enum iso9660_file_flags {
+	iso9660_flag_hidden = 0x01,
+	iso9660_flag_directory = 0x02,
+	iso9660_flag_associated = 0x04,
+	iso9660_flag_record = 0x08,
+	iso9660_flag_protection = 0x10,
+	iso9660_flag_multi_extent = 0x80,
+};
+
+/// Numbers are recorded in both byte orders. Only the little endian half is
+/// read.
+struct iso9660_both16 {
+	uint16_t le;
+	uint16_t be;
+} __attribute__((packed));
+
+struct iso9660_both32 {
+	uint32_t le;
+	uint32_t be;
+} __attribute__((packed));
+
+/// A directory record. Records never cross a logical block, and a record
+/// length of zero pads out the rest of the block. The first two records of a
+/// directory are its "." and "..", named by a single byte of 0 and 1.
+struct iso9660_dir_record {
+	uint8_t length;
+	uint8_t ext_attr_length;
+	struct iso9660_both32 extent;
+	struct iso9660_both32 size;
+	uint8_t date[7];
+	uint8_t flags;
+	uint8_t unit_size;
+	uint8_t interleave_gap;
+	struct iso9660_both16 volume_sequence;
+	uint8_t name_length;
+	char name[];
+} __attribute__((packed));
+
+#define ISO9660_DIR_RECORD_HEADER  33
+
+/// A record of the path table. Every directory of the volume has one, and
+/// they are ordered so that a directory always follows its parent. The
+/// directories are numbered from 1 in the order they appear.
+struct iso9660_path_record {
+	uint8_t name_length;
+	uint8_t ext_attr_length;
+	uint32_t extent;
+	uint16_t parent;
+	char name[];
+} __attribute__((packed));
+
+#define ISO9660_PATH_RECORD_HEADER  8
+
+/// The primary and supplementary volume descriptors share a layout. A
+/// supplementary descriptor for Joliet names is identified by its escape
+/// sequences, and records its names in big endian UCS-2.
+struct iso9660_volume_descriptor {
+	uint8_t type;
+	char standard_id[5];
+	uint8_t version;
+	uint8_t volume_flags;
+	char system_id[32];
+	char volume_id[32];
+	uint8_t unused1[8];
+	struct iso9660_both32 space_size;
+	uint8_t escape_sequences[32];
+	struct iso9660_both16 set_size;
+	struct iso9660_both16 sequence_number;
+	struct iso9660_both16 block_size;
+	struct iso9660_both32 path_table_size;
+	uint32_t l_path_table;
+	uint32_t l_path_table_optional;
+	uint32_t m_path_table;
+	uint32_t m_path_table_optional;
+	uint8_t root_record[34];
+	char set_id[128];
+	char publisher_id[128];
+	char preparer_id[128];
+	char application_id[128];
+	char copyright_file[37];
+	char abstract_file[37];
+	char bibliographic_file[37];
+	char creation_date[17];
+	char modification_date[17];
+	char expiration_date[17];
+	char effective_date[17];
+	uint8_t structure_version;
+	uint8_t reserved1;
+	uint8_t application_use[512];
+	uint8_t reserved2[653];
+} __attribute__((packed));
+typedef struct iso9660_volume_descriptor * iso9660_descriptor_t;
+
+/// A contiguous part of a file. Most files have a single section, but files
+/// of 4GB and over are recorded in several.
+struct iso9660_section {
+	uint32_t block;
+	uint32_t size;
+};
+
+/// What a node of the volume refers to. A directory refers to its entry in
+/// the path table, and its sections are not used.
+struct iso9660_entry {
+	struct iso9660_directory *directory;
+	uint32_t section_count;
+	struct iso9660_section sections[];
+};
+
+/// A directory of the volume, one for each record of the path table. The
+/// path table is read when the volume is mounted, so a path made up of
+/// directories is resolved without reading any of them. The records of a
+/// directory are only read when the files in it are needed, and then stay
+/// resident until the volume is unmounted.
+struct iso9660_directory {
+	uint32_t parent;
+	uint32_t block;
+	const char *name;
+	struct vfs_node *node;
+	struct vfs_node **nodes;
+	uint32_t count;
+	struct vfs_node *end;
+	struct name_index names;
+	uint8_t is_loaded:1;
+	uint8_t reserved:7;
+};
+
+struct iso9660 {
+	iso9660_descriptor_t descriptor;
+	uint32_t block_size;
+	uint32_t sectors_per_block;
+	struct iso9660_directory *directories;
+	uint32_t directory_count;
+	struct name_index paths;
+	struct arena arena;
+	struct iso9660_directory *current_dir;
+	uint8_t is_joliet:1;
+	uint8_t reserved:7;
+};
+typedef struct iso9660 * iso9660_t;
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef SHELL_LOCATION
+#define SHELL_LOCATION
+
+#include <vfs/vfs.h>
+
+struct shell;
+
+enum shell_location_kind {
+    shell_location_host = 0,
+    shell_location_image = 1,
+    shell_location_disc = 2,
+};
+
+struct shell_location {
+    enum shell_location_kind kind;
+    const char *path;
+};
+
+int shell_parse_location(const char *argument,
+                         enum shell_location_kind fallback,
+                         struct shell_location *location);
+
+/// Resolve an image or disc location to the mounted volume that it is
+/// within, and the path relative to that volume, which the caller must free.
+/// An error is reported and NULL returned when no volume is mounted there.
+vfs_t shell_resolve_location(struct shell *shell,
+                             const struct shell_location *location,
+                             char **path);
+
+/// Resolve a path argument, which may carry an `image:` or `disc:` prefix,
+/// in the same way. Host paths are rejected.
+vfs_t shell_resolve_image_path(struct shell *shell,
+                               const char *argument,
+                               char **path);
+
+#endif
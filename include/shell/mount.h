@@ -27,5 +27,10 @@ struct shell;
 
 int shell_mount(struct shell *, int, const char *[]);
 int shell_unmount(struct shell *, int, const char *[]);
+int shell_mounts(struct shell *, int, const char *[]);
+
+int shell_mount_image(struct shell *shell,
+                      const char *image,
+                      const char *point);
 
 #endif
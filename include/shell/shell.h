@@ -26,6 +26,7 @@
 #include <stdint.h>
 
 #include <vfs/vfs.h>
+#include <vfs/mount-table.h>
 #include <shell/scripting.h>
 #include <shell/variable.h>
 
@@ -37,6 +38,7 @@ struct shell {
     // Runtime
     vdevice_t attached_device;
     vfs_t device_filesystem;
+    vfs_mount_table_t mounts;
     shell_command_t first_command;
     shell_variable_t first_variable;
     shell_script_t script;
@@ -0,0 +1,66 @@
+/*
+  Copyright (c) 2017 Tom Hancocks
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef VFS_EXTENT
+#define VFS_EXTENT
+
+#include <stdint.h>
+
+/// A contiguous run of sectors on the device. The offset is the position of
+/// the first sector of the run within the file it belongs to.
+struct vfs_extent {
+    uint32_t start;
+    uint32_t length;
+    uint32_t offset;
+};
+
+/// The sectors occupied by a node, stored as an ordered list of runs rather
+/// than one entry per sector.
+struct vfs_extent_list {
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t sector_count;
+    struct vfs_extent *extents;
+};
+typedef struct vfs_extent_list * vfs_extent_list_t;
+
+struct vfs_extent_iterator {
+    vfs_extent_list_t list;
+    uint32_t index;
+};
+
+vfs_extent_list_t vfs_extent_list_init();
+void vfs_extent_list_destroy(vfs_extent_list_t list);
+
+void vfs_extent_list_append(vfs_extent_list_t list,
+                            uint32_t start,
+                            uint32_t length);
+
+uint32_t vfs_extent_list_sector(vfs_extent_list_t list, uint32_t n);
+
+void vfs_extent_iterator_init(struct vfs_extent_iterator *iterator,
+                              vfs_extent_list_t list);
+const struct vfs_extent *vfs_extent_iterator_next(
+    struct vfs_extent_iterator *iterator
+);
+
+#endif
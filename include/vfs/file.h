@@ -0,0 +1,44 @@
+/*
+  Copyright (c) 2017 Tom Hancocks
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef VFS_FILE
+#define VFS_FILE
+
+#include <stdint.h>
+#include <vfs/node.h>
+
+struct vfs;
+
+/// An open file. Files are opened through the filesystem interface, which
+/// keeps whatever state it needs to access the file efficiently, such as its
+/// current position in the cluster chain, in the associated info.
+struct vfs_file {
+    struct vfs *fs;
+    vfs_node_t node;
+    void *assoc_info;
+};
+typedef struct vfs_file * vfs_file_t;
+
+vfs_file_t vfs_file_init(struct vfs *fs, vfs_node_t node, void *file_info);
+void vfs_file_destroy(vfs_file_t file);
+
+#endif
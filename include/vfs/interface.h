@@ -25,6 +25,9 @@
 
 #include <device/virtual.h>
 #include <vfs/node.h>
+#include <vfs/extent.h>
+#include <vfs/file.h>
+#include <common/host-tree.h>
 
 struct vfs;
 
@@ -44,6 +47,16 @@ struct vfs_interface {
         uint16_t additional_reserved_sectors
     );
     
+    /// Works out how many sectors the device needs in order to hold the host
+    /// tree, including all of the filesystem metadata. Returns 0 if the tree
+    /// can not be represented by the filesystem.
+    uint32_t (*image_size)(vdevice_t dev, host_tree_t tree);
+    
+    /// Formats the device and populates it with the contents of the host tree
+    /// in a single pass. The device is written from start to end without
+    /// anything being read back. Returns 0 if the tree does not fit.
+    int (*build_device)(vdevice_t dev, const char *name, host_tree_t tree);
+    
     /// Mounts the filesystem in question. This action may vary from filesystem
     /// to filesystem, but will generally load all root directory metadata.
     void *(*mount_filesystem)(struct vfs *fs);
@@ -66,6 +79,17 @@ struct vfs_interface {
     /// Locate the node with the specified name inside the specified directory.
     vfs_node_t (*get_node)(struct vfs *fs, const char *name);
     
+    /// Gets a list of the nodes contained in the given directory, without
+    /// changing the current working directory. A NULL directory refers to
+    /// the root directory. The list is only valid until the filesystem next
+    /// loads a directory.
+    vfs_node_t (*list_directory)(struct vfs *fs, vfs_node_t dir);
+    
+    /// Locate the node with the specified name inside the given directory,
+    /// without changing the current working directory. A NULL directory
+    /// refers to the root directory.
+    vfs_node_t (*lookup)(struct vfs *fs, vfs_node_t dir, const char *name);
+    
     /// Create a new directory entry in the current working directory with the
     /// specified file name and attributes. This is absent any form of data.
     void (*create_file)(struct vfs *fs,
@@ -86,10 +110,57 @@ struct vfs_interface {
     /// file in bytes.
     uint32_t (*read)(struct vfs *fs, const char *name, void **bytes);
     
+    /// Open the named file in the specified directory for streaming access,
+    /// creating it if requested. A NULL directory refers to the root
+    /// directory. Returns NULL if the file could not be opened.
+    vfs_file_t (*open)(struct vfs *fs,
+                       vfs_node_t dir,
+                       const char *name,
+                       uint8_t create);
+    
+    /// Read up to `n` bytes from the file, starting at the specified offset.
+    /// Returns the number of bytes read, which is short at the end of file.
+    uint32_t (*pread)(struct vfs *fs,
+                      vfs_file_t file,
+                      void *bytes,
+                      uint32_t n,
+                      uint32_t offset);
+    
+    /// Write `n` bytes to the file at the specified offset, extending the file
+    /// if required. Returns the number of bytes written.
+    uint32_t (*pwrite)(struct vfs *fs,
+                       vfs_file_t file,
+                       const void *bytes,
+                       uint32_t n,
+                       uint32_t offset);
+    
+    /// Set the size of the file, releasing or allocating space as required.
+    /// Any newly exposed bytes read as zero.
+    int (*truncate)(struct vfs *fs, vfs_file_t file, uint32_t size);
+    
+    /// Reserve enough space for the file to grow to the specified size, in as
+    /// few runs as possible, without changing its size. Later writes fill in
+    /// the reserved space rather than allocating more. Filesystems that have
+    /// no way of doing this leave it unset.
+    int (*preallocate)(struct vfs *fs, vfs_file_t file, uint32_t size);
+    
+    /// Close the file, releasing any state held by the filesystem for it.
+    void (*close)(struct vfs *fs, vfs_file_t file);
+    
+    /// Get the runs of sectors occupied by the specified node, in file order.
+    /// The list is owned by the node and remains valid until the allocation
+    /// of the node changes.
+    vfs_extent_list_t (*extents)(struct vfs *fs, vfs_node_t node);
+    
     /// Force all metadata in the current working directory to be flushed to
     /// disk.
     void (*flush_directory)(struct vfs *fs);
     
+    /// Write back any metadata that has been modified in memory but not yet
+    /// written to the device. Filesystems are expected to defer metadata
+    /// writes until this is called, or until they are unmounted.
+    void (*sync)(struct vfs *fs);
+    
     /// Rename the specified entry in the current working directory.
     void (*rename)(struct vfs *fs, const char *old, const char *filename);
     
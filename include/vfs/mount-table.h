@@ -0,0 +1,61 @@
+/*
+  Copyright (c) 2017 Tom Hancocks
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef VFS_MOUNT_TABLE
+#define VFS_MOUNT_TABLE
+
+#include <stdint.h>
+
+struct vfs;
+
+struct vfs_mount_point {
+    struct vfs_mount_point *next;
+    char *path;
+    uint32_t length;
+    struct vfs *vfs;
+};
+
+/// The volumes mounted at named points, such as `/boot` or `/iso`. A path
+/// beginning with a mount point refers to the volume mounted there, and any
+/// other path to the volume the table falls back to. Mount points may be
+/// nested, in which case the longest one that matches is used.
+struct vfs_mount_table {
+    struct vfs_mount_point *first;
+};
+typedef struct vfs_mount_table * vfs_mount_table_t;
+
+vfs_mount_table_t vfs_mount_table_init();
+void vfs_mount_table_destroy(vfs_mount_table_t table);
+
+int vfs_mount_table_add(vfs_mount_table_t table,
+                        const char *path,
+                        struct vfs *vfs);
+struct vfs *vfs_mount_table_remove(vfs_mount_table_t table, const char *path);
+struct vfs *vfs_mount_table_find(vfs_mount_table_t table, const char *path);
+
+struct vfs *vfs_mount_table_resolve(vfs_mount_table_t table,
+                                    struct vfs *fallback,
+                                    const char *path,
+                                    char **relative);
+
+#endif
@@ -28,6 +28,8 @@
 
 struct vfs;
 struct vfs_node;
+struct arena;
+struct vfs_extent_list;
 
 enum vfs_node_state {
     vfs_node_unused = 0,
@@ -66,13 +68,18 @@ struct vfs_node {
     // Source Information
     void *assoc_info;
 
-    // Helper Information
-    uint32_t sector_count;
-    uint32_t *sectors;
+    // Helper Information. The sectors occupied by the node are built on
+    // demand, and discarded whenever its allocation changes.
+    struct vfs_extent_list *extents;
     
     // Editing
     uint8_t is_dirty:1;
-    uint8_t reserved:7;
+
+    // Ownership. Nodes placed in an arena are released along with it, as is
+    // their name until it is replaced.
+    uint8_t is_arena_owned:1;
+    uint8_t owns_name:1;
+    uint8_t reserved:5;
 };
 typedef struct vfs_node * vfs_node_t;
 
@@ -82,9 +89,17 @@ vfs_node_t vfs_node_init(struct vfs *fs,
                          enum vfs_node_attributes attributes,
                          enum vfs_node_state state,
                          void *node_info);
+vfs_node_t vfs_node_init_in_arena(struct arena *arena,
+                                  struct vfs *fs,
+                                  const char *name,
+                                  enum vfs_node_attributes attributes,
+                                  enum vfs_node_state state,
+                                  void *node_info);
 
 void vfs_node_destroy(vfs_node_t node);
 
+void vfs_node_set_name(vfs_node_t node, const char *name);
+
 int vfs_node_test_attribute(vfs_node_t node, enum vfs_node_attributes attr);
 void vfs_node_set_attribute(vfs_node_t node, enum vfs_node_attributes attr);
 void vfs_node_unset_attribute(vfs_node_t node, enum vfs_node_attributes attr);
@@ -0,0 +1,63 @@
+/*
+  Copyright (c) 2017 Tom Hancocks
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef VFS_PATH_CACHE
+#define VFS_PATH_CACHE
+
+#include <stdint.h>
+#include <vfs/node.h>
+
+#define VFS_PATH_CACHE_SIZE 512
+
+struct vfs_path_cache_entry {
+    uint32_t hash;
+    uint32_t generation;
+    uint32_t length;
+    char *path;
+    vfs_node_t node;
+};
+
+/// A direct mapped cache of absolute, normalised paths to the nodes they
+/// resolve to. Entries are only valid for the generation in which they were
+/// recorded. Invalidating the cache simply advances the generation, which
+/// makes every existing entry stale at once.
+struct vfs_path_cache {
+    uint32_t generation;
+    struct vfs_path_cache_entry entries[VFS_PATH_CACHE_SIZE];
+};
+typedef struct vfs_path_cache * vfs_path_cache_t;
+
+vfs_path_cache_t vfs_path_cache_init();
+void vfs_path_cache_destroy(vfs_path_cache_t cache);
+
+int vfs_path_cache_get(vfs_path_cache_t cache,
+                       const char *path,
+                       uint32_t length,
+                       vfs_node_t *node);
+void vfs_path_cache_put(vfs_path_cache_t cache,
+                        const char *path,
+                        uint32_t length,
+                        vfs_node_t node);
+
+void vfs_path_cache_invalidate(vfs_path_cache_t cache);
+
+#endif
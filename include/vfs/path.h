@@ -35,4 +35,6 @@ void vfs_parse_filename(const char *file, char **name, char **ext);
 
 vfs_path_node_t vfs_construct_path(const char *path);
 
+char *vfs_normalise_path(const char *cwd, const char *path);
+
 #endif
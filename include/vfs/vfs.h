@@ -26,6 +26,8 @@
 #include <device/virtual.h>
 #include <vfs/interface.h>
 #include <vfs/path.h>
+#include <vfs/path-cache.h>
+#include <vfs/file.h>
 
 struct vfs_directory;
 
@@ -34,6 +36,9 @@ struct vfs {
     void *assoc_info;
     vdevice_t device;
     vfs_interface_t filesystem_interface;
+    uint32_t transaction_depth;
+    char *cwd;
+    vfs_path_cache_t paths;
 };
 
 typedef struct vfs * vfs_t;
@@ -47,8 +52,12 @@ vfs_t vfs_unmount(vfs_t vfs);
 const char *vfs_pwd(vfs_t vfs);
 
 vfs_node_t vfs_get_directory_list(vfs_t vfs);
+vfs_node_t vfs_list_directory(vfs_t vfs, const char *path);
 
-void vfs_navigate_to_path(vfs_t vfs, const char *path);
+int vfs_resolve(vfs_t vfs, const char *path, vfs_node_t *node);
+void vfs_invalidate_paths(vfs_t vfs);
+
+int vfs_navigate_to_path(vfs_t vfs, const char *path);
 
 void vfs_touch(vfs_t vfs, const char *path);
 int vfs_mkdir(vfs_t vfs, const char *path);
@@ -56,8 +65,32 @@ int vfs_mkdir(vfs_t vfs, const char *path);
 void vfs_write(vfs_t vfs, const char *name, uint8_t *bytes, uint32_t size);
 uint32_t vfs_read(vfs_t vfs, const char *name, uint8_t **bytes);
 
-void vfs_remove(vfs_t vfs, const char *name);
+void vfs_remove(vfs_t vfs, const char *path);
+int vfs_rename(vfs_t vfs, const char *old_path, const char *new_path);
+
+vfs_file_t vfs_open(vfs_t vfs, const char *path, int create);
+uint32_t vfs_pread(vfs_file_t file, void *bytes, uint32_t n, uint32_t offset);
+uint32_t vfs_pwrite(vfs_file_t file,
+                    const void *bytes,
+                    uint32_t n,
+                    uint32_t offset);
+int vfs_truncate(vfs_file_t file, uint32_t size);
+void vfs_close(vfs_file_t file);
+
+int vfs_preallocate(vfs_t vfs, const char *path, uint32_t size);
+
+int vfs_copy(vfs_t source,
+             const char *source_path,
+             vfs_t destination,
+             const char *destination_path,
+             uint32_t *copied);
+
+int vfs_sync(vfs_t vfs);
+void vfs_begin(vfs_t vfs);
+int vfs_commit(vfs_t vfs);
 
+vfs_node_t vfs_get_file(vfs_t vfs, const char *path);
+vfs_extent_list_t vfs_extents_of(vfs_t vfs, const char *path);
 uint32_t vfs_sector_count_of(vfs_t vfs, const char *path);
 uint32_t vfs_nth_sector_of(vfs_t vfs, uint32_t n, const char *path);
 
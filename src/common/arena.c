@@ -0,0 +1,94 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/arena.h>
+
+#define ARENA_ALIGNMENT       16
+#define ARENA_MIN_BLOCK_SIZE  1024
+
+struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    unsigned char data[] __attribute__((aligned(ARENA_ALIGNMENT)));
+};
+
+void arena_init(struct arena *arena, size_t block_size)
+{
+    assert(arena);
+    arena->blocks = NULL;
+    arena->block_size = block_size > ARENA_MIN_BLOCK_SIZE
+                      ? block_size
+                      : ARENA_MIN_BLOCK_SIZE;
+}
+
+void arena_destroy(struct arena *arena)
+{
+    if (arena) {
+        struct arena_block *block = arena->blocks;
+        while (block) {
+            struct arena_block *next = block->next;
+            free(block);
+            block = next;
+        }
+        arena->blocks = NULL;
+    }
+}
+
+void *arena_alloc(struct arena *arena, size_t size)
+{
+    assert(arena);
+
+    // Keep every allocation aligned so that any type can be placed in it.
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    // Allocations come from the most recent block. When it is exhausted a new
+    // block is started, large enough for the request if it is an unusually
+    // big one. Whatever was left in the previous block is abandoned.
+    struct arena_block *block = arena->blocks;
+    if (!block || block->size - block->used < size) {
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        block = malloc(sizeof(*block) + block_size);
+        block->next = arena->blocks;
+        block->size = block_size;
+        block->used = 0;
+        arena->blocks = block;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+char *arena_strdup(struct arena *arena, const char *str)
+{
+    assert(str);
+    size_t len = strlen(str);
+    char *copy = arena_alloc(arena, len + 1);
+    memcpy(copy, str, len);
+    return copy;
+}
@@ -0,0 +1,184 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <common/host.h>
+#include <common/host-tree.h>
+
+/// One of the directories on the way from the root of the tree to the
+/// directory being scanned. Symbolic links are followed, so these are used to
+/// catch a link that leads back into a directory that contains it.
+struct host_tree_ancestor {
+    const struct host_tree_ancestor *parent;
+    dev_t device;
+    ino_t inode;
+};
+
+static int host_tree_compare(const void *a, const void *b)
+{
+    host_tree_entry_t lhs = *(host_tree_entry_t *)a;
+    host_tree_entry_t rhs = *(host_tree_entry_t *)b;
+    return strcmp(lhs->name, rhs->name);
+}
+
+static void host_tree_entry_destroy(host_tree_entry_t entry)
+{
+    while (entry) {
+        host_tree_entry_t next = entry->next;
+        host_tree_entry_destroy(entry->children);
+        free(entry->name);
+        free(entry->path);
+        free(entry);
+        entry = next;
+    }
+}
+
+static int host_tree_is_ancestor(const struct host_tree_ancestor *ancestor,
+                                 const struct stat *info)
+{
+    for (; ancestor; ancestor = ancestor->parent) {
+        if (ancestor->device == info->st_dev &&
+            ancestor->inode == info->st_ino)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int host_tree_scan_directory(host_tree_t tree,
+                                    host_tree_entry_t dir,
+                                    const struct host_tree_ancestor *parent)
+{
+    struct stat dir_info;
+    DIR *handle = NULL;
+    if (stat(dir->path, &dir_info) != 0 || !(handle = opendir(dir->path))) {
+        fprintf(stderr, "Could not read the directory %s\n", dir->path);
+        return 0;
+    }
+    struct host_tree_ancestor self = {
+        .parent = parent,
+        .device = dir_info.st_dev,
+        .inode = dir_info.st_ino,
+    };
+
+    // Gather up every regular file and directory, following symbolic links
+    // to them. Anything else, such as devices or sockets, has no meaning on
+    // the image and is skipped.
+    host_tree_entry_t *entries = NULL;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    struct dirent *dirent = NULL;
+    while ((dirent = readdir(handle))) {
+        if (strcmp(dirent->d_name, ".") == 0 ||
+            strcmp(dirent->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        char *path = host_join_path(dir->path, dirent->d_name);
+        struct stat info;
+        if (stat(path, &info) != 0 ||
+            !(S_ISREG(info.st_mode) || S_ISDIR(info.st_mode)))
+        {
+            free(path);
+            continue;
+        }
+        else if (S_ISDIR(info.st_mode) && host_tree_is_ancestor(&self, &info)) {
+            fprintf(stderr,
+                    "Skipping %s as it leads back into a directory above it\n",
+                    path);
+            free(path);
+            continue;
+        }
+
+        host_tree_entry_t entry = calloc(1, sizeof(*entry));
+        entry->name = strdup(dirent->d_name);
+        entry->path = path;
+        entry->is_directory = S_ISDIR(info.st_mode) ? 1 : 0;
+        entry->size = entry->is_directory ? 0 : (uint64_t)info.st_size;
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            entries = realloc(entries, capacity * sizeof(*entries));
+        }
+        entries[count++] = entry;
+    }
+    closedir(handle);
+
+    // Keep the entries in name order, so that the same tree always produces
+    // the same layout.
+    qsort(entries, count, sizeof(*entries), host_tree_compare);
+    for (uint32_t i = count; i > 0; --i) {
+        entries[i - 1]->next = dir->children;
+        dir->children = entries[i - 1];
+    }
+    free(entries);
+
+    int result = 1;
+    for (host_tree_entry_t entry = dir->children; entry; entry = entry->next) {
+        if (entry->is_directory) {
+            tree->directory_count++;
+            result = host_tree_scan_directory(tree, entry, &self) && result;
+        }
+        else {
+            tree->file_count++;
+            tree->total_size += entry->size;
+        }
+    }
+
+    return result;
+}
+
+host_tree_t host_tree_scan(const char *path)
+{
+    struct stat info;
+    if (stat(path, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        fprintf(stderr, "%s is not a directory\n", path);
+        return NULL;
+    }
+
+    host_tree_t tree = calloc(1, sizeof(*tree));
+    tree->root = calloc(1, sizeof(*tree->root));
+    tree->root->name = strdup("");
+    tree->root->path = strdup(path);
+    tree->root->is_directory = 1;
+
+    if (!host_tree_scan_directory(tree, tree->root, NULL)) {
+        host_tree_destroy(tree);
+        return NULL;
+    }
+
+    return tree;
+}
+
+void host_tree_destroy(host_tree_t tree)
+{
+    if (tree) {
+        host_tree_entry_destroy(tree->root);
+    }
+    free(tree);
+}
@@ -23,6 +23,7 @@
 #include <wordexp.h>
 #include <stdlib.h>
 #include <string.h>
+#include <common/host.h>
 
 const char *host_expand_path(const char *path)
 {
@@ -38,3 +39,20 @@ const char *host_expand_path(const char *path)
 
     return result;
 }
+
+char *host_join_path(const char *dir, const char *name)
+{
+    // Only add a separator where the directory does not already end in one.
+    // The same joining is used for paths on the host and on images.
+    size_t dir_len = strlen(dir);
+    size_t name_len = strlen(name);
+    size_t separator = (dir_len > 0 && dir[dir_len - 1] != '/') ? 1 : 0;
+
+    char *path = calloc(dir_len + separator + name_len + 1, sizeof(*path));
+    memcpy(path, dir, dir_len);
+    if (separator) {
+        path[dir_len] = '/';
+    }
+    memcpy(path + dir_len + separator, name, name_len);
+    return path;
+}
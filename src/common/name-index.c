@@ -0,0 +1,217 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <common/name-index.h>
+
+#define NAME_INDEX_MIN_CAPACITY 16
+
+
+#pragma mark - Name Hashing
+
+uint32_t name_hash(const uint8_t *name, uint32_t len)
+{
+    // FNV-1a. Directory names are short so this is more than adequate, and it
+    // never touches the heap.
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < len; ++i) {
+        hash ^= name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t folded_name_hash(const char *name)
+{
+    // As above, but ignoring the case of ASCII letters, which long names are
+    // compared without regard to.
+    uint32_t hash = 2166136261u;
+    for (const uint8_t *c = (const uint8_t *)name; *c; ++c) {
+        hash ^= (*c >= 'A' && *c <= 'Z') ? *c + ('a' - 'A') : *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+#pragma mark - Name Index
+
+static void name_index_allocate(struct name_index *index,
+                                uint32_t capacity)
+{
+    index->capacity = capacity;
+    index->count = 0;
+    index->slots = malloc(capacity * sizeof(*index->slots));
+    for (uint32_t i = 0; i < capacity; ++i) {
+        index->slots[i].entry = NAME_INDEX_NONE;
+    }
+}
+
+void name_index_init(struct name_index *index, uint32_t expected)
+{
+    assert(index);
+
+    // Keep the table at most half full so that probe sequences stay short.
+    uint32_t capacity = NAME_INDEX_MIN_CAPACITY;
+    while (capacity < expected * 2) {
+        capacity <<= 1;
+    }
+    name_index_allocate(index, capacity);
+}
+
+void name_index_destroy(struct name_index *index)
+{
+    if (index) {
+        free(index->slots);
+        index->slots = NULL;
+        index->capacity = 0;
+        index->count = 0;
+    }
+}
+
+static void name_index_grow(struct name_index *index)
+{
+    struct name_index_slot *old_slots = index->slots;
+    uint32_t old_capacity = index->capacity;
+
+    name_index_allocate(index, old_capacity << 1);
+    for (uint32_t i = 0; i < old_capacity; ++i) {
+        if (old_slots[i].entry != NAME_INDEX_NONE) {
+            name_index_insert(index, old_slots[i].hash, old_slots[i].entry);
+        }
+    }
+
+    free(old_slots);
+}
+
+void name_index_insert(struct name_index *index,
+                       uint32_t hash,
+                       uint32_t entry)
+{
+    assert(index);
+    assert(entry != NAME_INDEX_NONE);
+
+    if (!index->slots) {
+        name_index_init(index, 0);
+    }
+    else if ((index->count + 1) * 2 > index->capacity) {
+        name_index_grow(index);
+    }
+
+    uint32_t mask = index->capacity - 1;
+    uint32_t i = hash & mask;
+    while (index->slots[i].entry != NAME_INDEX_NONE) {
+        i = (i + 1) & mask;
+    }
+
+    index->slots[i].hash = hash;
+    index->slots[i].entry = entry;
+    index->count++;
+}
+
+void name_index_remove(struct name_index *index,
+                       uint32_t hash,
+                       uint32_t entry)
+{
+    assert(index);
+    if (!index->slots) {
+        return;
+    }
+
+    // Locate the slot holding the entry.
+    uint32_t mask = index->capacity - 1;
+    uint32_t i = hash & mask;
+    while (index->slots[i].entry != entry) {
+        if (index->slots[i].entry == NAME_INDEX_NONE) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+
+    // Close the gap by shifting back any following slots whose probe sequence
+    // passes through the one being removed. This avoids the need for
+    // tombstones, which would otherwise accumulate as files are deleted.
+    uint32_t j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        if (index->slots[j].entry == NAME_INDEX_NONE) {
+            break;
+        }
+
+        uint32_t home = index->slots[j].hash & mask;
+        int in_place = (i <= j) ? (i < home && home <= j)
+                                : (i < home || home <= j);
+        if (in_place) {
+            continue;
+        }
+
+        index->slots[i] = index->slots[j];
+        i = j;
+    }
+
+    index->slots[i].entry = NAME_INDEX_NONE;
+    index->count--;
+}
+
+uint32_t name_index_first(struct name_index *index,
+                          uint32_t hash,
+                          uint32_t *cursor)
+{
+    assert(index);
+    assert(cursor);
+
+    if (!index->slots) {
+        return NAME_INDEX_NONE;
+    }
+
+    *cursor = hash & (index->capacity - 1);
+    return name_index_next(index, hash, cursor);
+}
+
+uint32_t name_index_next(struct name_index *index,
+                         uint32_t hash,
+                         uint32_t *cursor)
+{
+    assert(index);
+    assert(cursor);
+
+    if (!index->slots) {
+        return NAME_INDEX_NONE;
+    }
+
+    // The table is never more than half full, so an empty slot is guaranteed
+    // to terminate the probe.
+    uint32_t mask = index->capacity - 1;
+    while (1) {
+        struct name_index_slot *slot = &index->slots[*cursor];
+        if (slot->entry == NAME_INDEX_NONE) {
+            return NAME_INDEX_NONE;
+        }
+
+        *cursor = (*cursor + 1) & mask;
+        if (slot->hash == hash) {
+            return slot->entry;
+        }
+    }
+}
@@ -0,0 +1,135 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/slot-map.h>
+
+void slot_map_init(struct slot_map *map, uint32_t count)
+{
+    assert(map);
+    map->count = count;
+    map->hint = 0;
+    map->bits = calloc((count + 63) / 64, sizeof(*map->bits));
+}
+
+void slot_map_destroy(struct slot_map *map)
+{
+    if (map) {
+        free(map->bits);
+        map->bits = NULL;
+        map->count = 0;
+        map->hint = 0;
+    }
+}
+
+void slot_map_resize(struct slot_map *map, uint32_t count)
+{
+    assert(map);
+    assert(count >= map->count);
+
+    // Any entries added to the map start out as used, the same as they do
+    // when the map is first created.
+    uint32_t old_words = (map->count + 63) / 64;
+    uint32_t words = (count + 63) / 64;
+    if (words > old_words) {
+        map->bits = realloc(map->bits, words * sizeof(*map->bits));
+        memset(map->bits + old_words,
+               0,
+               (words - old_words) * sizeof(*map->bits));
+    }
+    map->count = count;
+}
+
+void slot_map_set_free(struct slot_map *map, uint32_t entry)
+{
+    assert(map);
+    assert(entry < map->count);
+
+    map->bits[entry / 64] |= (1ULL << (entry % 64));
+    if (entry < map->hint) {
+        map->hint = entry;
+    }
+}
+
+void slot_map_set_used(struct slot_map *map, uint32_t entry)
+{
+    assert(map);
+    assert(entry < map->count);
+
+    map->bits[entry / 64] &= ~(1ULL << (entry % 64));
+}
+
+uint32_t slot_map_first_free(struct slot_map *map)
+{
+    assert(map);
+
+    // Nothing below the hint is free, so begin the search from the word that
+    // contains it and test 64 entries at a time.
+    uint32_t words = (map->count + 63) / 64;
+    for (uint32_t w = map->hint / 64; w < words; ++w) {
+        if (map->bits[w]) {
+            uint32_t entry = (w * 64) + (uint32_t)__builtin_ctzll(map->bits[w]);
+            map->hint = entry;
+            return entry;
+        }
+    }
+
+    map->hint = map->count;
+    return SLOT_MAP_NONE;
+}
+
+uint32_t slot_map_first_free_run(struct slot_map *map, uint32_t length)
+{
+    assert(map);
+    assert(length > 0);
+
+    // Look for the lowest numbered run of free entries that is long enough,
+    // starting from the first free entry and skipping over full words.
+    uint32_t entry = slot_map_first_free(map);
+    uint32_t start = entry;
+    uint32_t run = 0;
+    while (entry < map->count) {
+        uint64_t word = map->bits[entry / 64];
+        if (word == 0 && entry % 64 == 0) {
+            run = 0;
+            entry += 64;
+            continue;
+        }
+
+        if (word & (1ULL << (entry % 64))) {
+            if (run++ == 0) {
+                start = entry;
+            }
+            if (run == length) {
+                return start;
+            }
+        }
+        else {
+            run = 0;
+        }
+        ++entry;
+    }
+    return SLOT_MAP_NONE;
+}
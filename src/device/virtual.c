@@ -23,8 +23,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
 #include <device/virtual.h>
 
+static void device_measure(vdevice_t dev)
+{
+    // The size of the device only changes when it is initialised, so work it
+    // out once rather than on every access.
+    dev->total_sectors = 0;
+    if (dev->handle) {
+        fseek(dev->handle, 0L, SEEK_END);
+        off_t n = ftello(dev->handle);
+        fseek(dev->handle, 0L, SEEK_SET);
+        dev->total_sectors = (uint32_t)(n / dev->sector_size);
+    }
+}
+
 vdevice_t device_create(const char *restrict path, enum vmedia_type media)
 {
     vdevice_t dev = calloc(1, sizeof(*dev));
@@ -33,10 +47,16 @@ vdevice_t device_create(const char *restrict path, enum vmedia_type media)
     dev->path = calloc(len+1, sizeof(*dev->path));
     memcpy((void *)dev->path, path, len);
 
+    // Images that can not be written to, such as those of read only media,
+    // are still opened so that they can be read.
     dev->handle = fopen(dev->path, "rb+");
+    if (!dev->handle) {
+        dev->handle = fopen(dev->path, "rb");
+    }
 
     dev->sector_size = 512;
     dev->media = media;
+    device_measure(dev);
 
     return dev;
 }
@@ -58,12 +78,14 @@ void device_init(vdevice_t dev, uint16_t bps, uint32_t count)
         return;
     }
 
-    uint8_t *sector = calloc(dev->sector_size, sizeof(*sector));
-    for (uint32_t i = 0; i < count; ++i) {
-        fwrite(sector, sizeof(*sector), dev->sector_size, dev->handle);
+    // Extend the file to the requested size rather than writing out zeros.
+    // The host will read the unwritten areas back as zero, and only allocate
+    // space for them as they are written.
+    off_t size = (off_t)count * dev->sector_size;
+    if (ftruncate(fileno(dev->handle), size) != 0) {
+        fprintf(stderr, "Failed to size disk for initialisation\n");
     }
-    fflush(dev->handle);
-    free(sector);
+    device_measure(dev);
 }
 
 uint8_t device_is_inited(vdevice_t dev)
@@ -75,7 +97,9 @@ uint8_t device_is_inited(vdevice_t dev)
 void device_destroy(vdevice_t device)
 {
     if (device) {
-        fclose(device->handle);
+        if (device->handle) {
+            fclose(device->handle);
+        }
         free((void *)device->path);
     }
     free(device);
@@ -85,10 +109,7 @@ void device_destroy(vdevice_t device)
 uint32_t device_total_sectors(vdevice_t device)
 {
     assert(device);
-    fseek(device->handle, 0L, SEEK_END);
-    uint32_t n = (uint32_t)ftell(device->handle);
-    fseek(device->handle, 0L, SEEK_SET);
-    return n / device->sector_size;
+    return device->total_sectors;
 }
 
 
@@ -98,7 +119,7 @@ uint8_t *device_read_sector(vdevice_t device, uint32_t sector)
     assert(sector < device_total_sectors(device));
 
     uint8_t *data = calloc(device->sector_size, sizeof(*data));
-    fseek(device->handle, sector * device->sector_size, SEEK_SET);
+    fseeko(device->handle, (off_t)sector * device->sector_size, SEEK_SET);
     fread(data, sizeof(*data), device->sector_size, device->handle);
     return data;
 }
@@ -106,21 +127,30 @@ uint8_t *device_read_sector(vdevice_t device, uint32_t sector)
 uint8_t *device_read_sectors(vdevice_t device, uint32_t sector, uint32_t n)
 {
     assert(device);
-    assert(sector < device_total_sectors(device));
-    assert(sector + n < device_total_sectors(device));
 
     uint8_t *data = calloc(n * device->sector_size, sizeof(*data));
-    fseek(device->handle, sector * device->sector_size, SEEK_SET);
-    fread(data, sizeof(*data), n * device->sector_size, device->handle);
+    device_read_sectors_into(device, sector, n, data);
     return data;
 }
 
+void device_read_sectors_into(vdevice_t device, uint32_t sector, uint32_t n,
+                              uint8_t *data)
+{
+    assert(device);
+    assert(data);
+    assert(sector < device_total_sectors(device));
+    assert(sector + n <= device_total_sectors(device));
+
+    fseeko(device->handle, (off_t)sector * device->sector_size, SEEK_SET);
+    fread(data, sizeof(*data), n * device->sector_size, device->handle);
+}
+
 void device_write_sector(vdevice_t device, uint32_t sector, uint8_t *data)
 {
     assert(device);
     assert(sector < device_total_sectors(device));
 
-    fseek(device->handle, sector * device->sector_size, SEEK_SET);
+    fseeko(device->handle, (off_t)sector * device->sector_size, SEEK_SET);
     fwrite(data, sizeof(*data), device->sector_size, device->handle);
     fflush(device->handle);
 }
@@ -130,9 +160,9 @@ void device_write_sectors(vdevice_t device, uint32_t sector, uint32_t n,
 {
     assert(device);
     assert(sector < device_total_sectors(device));
-    assert(sector + n < device_total_sectors(device));
+    assert(sector + n <= device_total_sectors(device));
 
-    fseek(device->handle, sector * device->sector_size, SEEK_SET);
+    fseeko(device->handle, (off_t)sector * device->sector_size, SEEK_SET);
     fwrite(data, sizeof(*data), device->sector_size * n, device->handle);
     fflush(device->handle);
 }
@@ -0,0 +1,2360 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <exfat/exfat.h>
+
+#include <vfs/vfs.h>
+#include <vfs/node.h>
+#include <vfs/extent.h>
+#include <vfs/file.h>
+
+
+#ifdef MAX
+#   undef MAX
+#endif
+
+#define MAX(a,b) \
+    ({ __typeof__ (a) _a = (a); \
+       __typeof__ (b) _b = (b); \
+       _a > _b ? _a : _b; })
+
+#ifdef MIN
+#   undef MIN
+#endif
+
+#define MIN(a,b) \
+    ({ __typeof__ (a) _a = (a); \
+       __typeof__ (b) _b = (b); \
+       _a < _b ? _a : _b; })
+
+
+#pragma mark - exFAT Constants
+
+enum exfat_attribute {
+    exfat_attribute_readonly = 0x01,
+    exfat_attribute_hidden = 0x02,
+    exfat_attribute_system = 0x04,
+    exfat_attribute_directory = 0x10,
+    exfat_attribute_archive = 0x20,
+};
+
+#define EXFAT_CLUSTER_FREE  0x00000000
+#define EXFAT_CLUSTER_EOF  0xFFFFFFFF
+#define EXFAT_MAX_CLUSTERS  0xFFFFFFF5
+
+// The boot region is 12 sectors long, and is immediately followed by its
+// backup. The FAT can not start any earlier than the end of the backup.
+#define EXFAT_BOOT_REGION_SECTORS  12
+#define EXFAT_RESERVED_SECTORS  24
+#define EXFAT_BOOT_CODE_OFFSET  120
+
+// Entry sets are 32 bytes to a slot. A directory may not grow beyond 256MB.
+#define EXFAT_SLOT_SIZE  32
+#define EXFAT_MAX_DIRECTORY_BYTES  (256 * 1024 * 1024)
+
+// Room in a directory arena for a node, its entry and its name, allowing for
+// each of them to be rounded up by the arena.
+#define EXFAT_ARENA_BYTES_PER_ENTRY \
+    (sizeof(struct vfs_node) + sizeof(struct exfat_entry) + 64)
+
+#define EXFAT_UPCASE_CHARS  65536
+
+
+#pragma mark - VFS Interface (Prototypes)
+
+static const char *exfat_name();
+
+static void *exfat_mount(vfs_t fs);
+static void exfat_unmount(vfs_t fs);
+
+static void exfat_format_device(
+    vdevice_t dev,
+    const char *label,
+    uint8_t *bootcode,
+    uint8_t *reserved_data,
+    uint16_t additional_reserved_sectors
+);
+
+static vfs_node_t exfat_current_directory(vfs_t fs);
+static vfs_node_t exfat_get_directory_list(vfs_t fs);
+static vfs_node_t exfat_list_directory(vfs_t fs, vfs_node_t directory);
+static void exfat_set_directory(vfs_t fs, vfs_node_t directory);
+
+static vfs_node_t exfat_get_node(vfs_t fs, const char *name);
+static vfs_node_t exfat_lookup(vfs_t fs,
+                               vfs_node_t directory,
+                               const char *name);
+
+static void exfat_file_write(vfs_t fs,
+                             const char *name,
+                             void *data,
+                             uint32_t n);
+static uint32_t exfat_file_read(vfs_t fs, const char *name, void **data);
+static vfs_extent_list_t exfat_node_extents(vfs_t fs, vfs_node_t node);
+
+static vfs_file_t exfat_open(vfs_t fs,
+                             vfs_node_t directory,
+                             const char *name,
+                             uint8_t create);
+static uint32_t exfat_pread(vfs_t fs,
+                            vfs_file_t file,
+                            void *data,
+                            uint32_t n,
+                            uint32_t offset);
+static uint32_t exfat_pwrite(vfs_t fs,
+                             vfs_file_t file,
+                             const void *data,
+                             uint32_t n,
+                             uint32_t offset);
+static int exfat_truncate(vfs_t fs, vfs_file_t file, uint32_t size);
+static void exfat_close(vfs_t fs, vfs_file_t file);
+
+static void exfat_create_file(vfs_t, const char *, enum vfs_node_attributes);
+static vfs_node_t exfat_create_dir(vfs_t fs,
+                                   const char *name,
+                                   enum vfs_node_attributes a);
+
+static void exfat_remove_file(vfs_t fs, const char *name);
+static void exfat_rename(vfs_t fs, const char *old, const char *name);
+
+static void exfat_flush(vfs_t fs);
+static void exfat_sync(vfs_t fs);
+
+
+#pragma mark - VFS Interface Creation
+
+vfs_interface_t exfat_init()
+{
+    vfs_interface_t fs = vfs_interface_init();
+
+    fs->type_name = exfat_name;
+
+    fs->mount_filesystem = exfat_mount;
+    fs->unmount_filesystem = exfat_unmount;
+
+    // Images can not yet be built in a single pass, so only formatting is
+    // offered.
+    fs->format_device = exfat_format_device;
+
+    fs->current_directory = exfat_current_directory;
+    fs->get_directory_list = exfat_get_directory_list;
+    fs->list_directory = exfat_list_directory;
+    fs->set_directory = exfat_set_directory;
+    fs->get_node = exfat_get_node;
+    fs->lookup = exfat_lookup;
+
+    fs->write = exfat_file_write;
+    fs->read = exfat_file_read;
+    fs->extents = exfat_node_extents;
+
+    fs->open = exfat_open;
+    fs->pread = exfat_pread;
+    fs->pwrite = exfat_pwrite;
+    fs->truncate = exfat_truncate;
+    fs->close = exfat_close;
+
+    fs->create_file = exfat_create_file;
+    fs->create_dir = exfat_create_dir;
+
+    fs->remove = exfat_remove_file;
+    fs->rename = exfat_rename;
+
+    fs->flush_directory = exfat_flush;
+    fs->sync = exfat_sync;
+
+    return fs;
+}
+
+
+#pragma mark - exFAT Calculations
+
+static uint32_t exfat_bytes_per_sector(exfat_boot_sector_t boot)
+{
+    return (uint32_t)1 << boot->bytes_per_sector_shift;
+}
+
+static uint32_t exfat_sectors_per_cluster(exfat_boot_sector_t boot)
+{
+    return (uint32_t)1 << boot->sectors_per_cluster_shift;
+}
+
+static uint32_t exfat_cluster_sector(exfat_t ex, uint32_t cluster)
+{
+    uint32_t shift = ex->boot->sectors_per_cluster_shift;
+    return ex->boot->cluster_heap_offset + ((cluster - 2) << shift);
+}
+
+static int exfat_is_valid_cluster(exfat_t ex, uint32_t cluster)
+{
+    return cluster >= 2 && cluster < ex->boot->cluster_count + 2;
+}
+
+static uint32_t exfat_cluster_count_for_size(exfat_t ex, uint64_t n)
+{
+    return (uint32_t)((n + ex->bytes_per_cluster - 1) / ex->bytes_per_cluster);
+}
+
+static uint32_t exfat_entry_cluster_count(exfat_t ex,
+                                          const struct exfat_entry *entry)
+{
+    if (entry->first_cluster == 0) {
+        return 0;
+    }
+    return exfat_cluster_count_for_size(ex, entry->data_length);
+}
+
+static uint16_t exfat_translate_from_vfs_attributes(
+    enum vfs_node_attributes vfsa
+) {
+    uint16_t attr = 0;
+    attr |= vfsa & vfs_node_hidden_attribute ? exfat_attribute_hidden : 0;
+    attr |= vfsa & vfs_node_read_only_attribute ? exfat_attribute_readonly : 0;
+    attr |= vfsa & vfs_node_directory_attribute ? exfat_attribute_directory : 0;
+    attr |= vfsa & vfs_node_system_attribute ? exfat_attribute_system : 0;
+    return attr;
+}
+
+static enum vfs_node_attributes exfat_translate_to_vfs_attributes(
+    uint16_t attr
+) {
+    enum vfs_node_attributes vfsa = 0;
+    vfsa |= attr & exfat_attribute_hidden ? vfs_node_hidden_attribute : 0;
+    vfsa |= attr & exfat_attribute_readonly ? vfs_node_read_only_attribute : 0;
+    vfsa |= attr & exfat_attribute_directory ? vfs_node_directory_attribute : 0;
+    vfsa |= attr & exfat_attribute_system ? vfs_node_system_attribute : 0;
+    return vfsa;
+}
+
+
+#pragma mark - exFAT Date Calculations
+
+// Timestamps pack a FAT date into the high half and a FAT time into the low
+// half, with the seconds counted in twos.
+static uint32_t exfat_timestamp_from_posix(time_t posix)
+{
+    struct tm ts = *localtime(&posix);
+
+    uint32_t year = MAX(1900 + ts.tm_year, 1980) - 1980;
+    uint32_t date = ((year << 9) & 0xFE00)
+                  | (((ts.tm_mon + 1) << 5) & 0x01E0)
+                  | (ts.tm_mday & 0x001F);
+    uint32_t time = ((ts.tm_hour << 11) & 0xF800)
+                  | ((ts.tm_min << 5) & 0x07E0)
+                  | ((ts.tm_sec / 2) & 0x001F);
+
+    return (date << 16) | time;
+}
+
+static time_t exfat_timestamp_to_posix(uint32_t timestamp)
+{
+    uint32_t month = (timestamp >> 21) & 0x0F;
+    if (month == 0) {
+        return 0;
+    }
+
+    struct tm ts;
+    memset(&ts, 0, sizeof(ts));
+    ts.tm_year = (((timestamp >> 25) & 0x7F) + 1980) - 1900;
+    ts.tm_mon = month - 1;
+    ts.tm_mday = (timestamp >> 16) & 0x1F;
+    ts.tm_hour = (timestamp >> 11) & 0x1F;
+    ts.tm_min = (timestamp >> 5) & 0x3F;
+    ts.tm_sec = (timestamp & 0x1F) * 2;
+    ts.tm_isdst = -1;
+
+    return mktime(&ts);
+}
+
+
+#pragma mark - Checksums and Names
+
+static uint32_t exfat_boot_checksum(const uint8_t *region, uint32_t bps)
+{
+    // The volume flags and the percentage in use change as the volume is
+    // used, and so are left out of the checksum.
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < bps * (EXFAT_BOOT_REGION_SECTORS - 1); ++i) {
+        if (i == 106 || i == 107 || i == 112) {
+            continue;
+        }
+        sum = ((sum & 1) ? 0x80000000 : 0) + (sum >> 1) + region[i];
+    }
+    return sum;
+}
+
+static uint16_t exfat_entry_set_checksum(const union exfat_dir_entry *set,
+                                         uint32_t count)
+{
+    // The checksum covers every entry of the set, apart from itself.
+    const uint8_t *bytes = set->raw;
+    uint16_t sum = 0;
+    for (uint32_t i = 0; i < count * EXFAT_SLOT_SIZE; ++i) {
+        if (i == 2 || i == 3) {
+            continue;
+        }
+        sum = (uint16_t)(((sum & 1) ? 0x8000 : 0) + (sum >> 1) + bytes[i]);
+    }
+    return sum;
+}
+
+static uint32_t exfat_table_checksum(const uint8_t *data, uint64_t n)
+{
+    uint32_t sum = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        sum = ((sum & 1) ? 0x80000000 : 0) + (sum >> 1) + data[i];
+    }
+    return sum;
+}
+
+static uint16_t exfat_name_hash(exfat_t ex,
+                                const uint16_t *chars,
+                                uint32_t len)
+{
+    // Names are hashed in their up-cased form, so that a lookup only has to
+    // compare the names that differ in nothing more than case.
+    uint16_t hash = 0;
+    for (uint32_t i = 0; i < len; ++i) {
+        uint16_t ch = ex->upcase[chars[i]];
+        uint8_t bytes[2] = { (uint8_t)(ch & 0xFF), (uint8_t)(ch >> 8) };
+        for (uint32_t b = 0; b < 2; ++b) {
+            hash = (uint16_t)(((hash & 1) ? 0x8000 : 0)
+                              + (hash >> 1)
+                              + bytes[b]);
+        }
+    }
+    return hash;
+}
+
+static uint32_t exfat_name_to_utf16(const char *name, uint16_t *chars)
+{
+    // Decode the UTF-8 name, returning its length in characters. Names that
+    // are too long, badly formed, or reach beyond the basic multilingual
+    // plane, can not be stored and have a length of 0.
+    const uint8_t *c = (const uint8_t *)name;
+    uint32_t len = 0;
+    while (*c) {
+        uint32_t ch = *c++;
+        uint32_t extra = 0;
+        if (ch >= 0xf0 || (ch >= 0x80 && ch < 0xc0)) {
+            return 0;
+        }
+        else if (ch >= 0xe0) {
+            ch &= 0x0f;
+            extra = 2;
+        }
+        else if (ch >= 0xc0) {
+            ch &= 0x1f;
+            extra = 1;
+        }
+
+        while (extra--) {
+            if ((*c & 0xc0) != 0x80) {
+                return 0;
+            }
+            ch = (ch << 6) | (*c++ & 0x3f);
+        }
+
+        if (len == EXFAT_NAME_MAX_LENGTH) {
+            return 0;
+        }
+        chars[len++] = (uint16_t)ch;
+    }
+    return len;
+}
+
+static char *exfat_name_from_utf16(const uint16_t *chars, uint32_t len)
+{
+    // Encode the name as UTF-8. Every character takes at most 3 bytes.
+    char *name = calloc((len * 3) + 1, sizeof(*name));
+    uint8_t *c = (uint8_t *)name;
+    for (uint32_t i = 0; i < len; ++i) {
+        uint16_t ch = chars[i];
+        if (ch < 0x80) {
+            *c++ = (uint8_t)ch;
+        }
+        else if (ch < 0x800) {
+            *c++ = 0xc0 | (ch >> 6);
+            *c++ = 0x80 | (ch & 0x3f);
+        }
+        else {
+            *c++ = 0xe0 | (ch >> 12);
+            *c++ = 0x80 | ((ch >> 6) & 0x3f);
+            *c++ = 0x80 | (ch & 0x3f);
+        }
+    }
+    return name;
+}
+
+static int exfat_is_valid_name(const char *name)
+{
+    // Besides being representable, a name must not contain any control
+    // characters or any of the characters reserved by exFAT.
+    for (const char *c = name; *c; ++c) {
+        if ((uint8_t)*c < 0x20 || strchr("\"*/:<>?\\|", *c)) {
+            return 0;
+        }
+    }
+
+    uint16_t chars[EXFAT_NAME_MAX_LENGTH];
+    return exfat_name_to_utf16(name, chars) > 0;
+}
+
+static uint32_t exfat_slot_count_for_name(uint32_t len)
+{
+    // A file entry and a stream entry, followed by the name entries.
+    return 2 + ((len + EXFAT_NAME_CHARS_PER_ENTRY - 1)
+                / EXFAT_NAME_CHARS_PER_ENTRY);
+}
+
+
+#pragma mark - Up-case Table
+
+static uint32_t exfat_default_upcase(uint16_t *data)
+{
+    // The table written by format covers ASCII and Latin-1, and leaves every
+    // other character as it is. Runs of characters that map to themselves
+    // are compressed to 0xFFFF followed by the length of the run.
+    uint32_t n = 0;
+    data[n++] = 0xFFFF;
+    data[n++] = 'a';
+    for (uint16_t ch = 'a'; ch <= 'z'; ++ch) {
+        data[n++] = ch - 0x20;
+    }
+    data[n++] = 0xFFFF;
+    data[n++] = 0xE0 - ('z' + 1);
+    for (uint16_t ch = 0xE0; ch <= 0xFF; ++ch) {
+        if (ch == 0xF7) {
+            data[n++] = ch;
+        }
+        else if (ch == 0xFF) {
+            data[n++] = 0x0178;
+        }
+        else {
+            data[n++] = ch - 0x20;
+        }
+    }
+    return n;
+}
+
+static uint16_t *exfat_expand_upcase(const uint16_t *data, uint32_t n)
+{
+    // Every character that the table does not reach maps to itself.
+    uint16_t *table = calloc(EXFAT_UPCASE_CHARS, sizeof(*table));
+    for (uint32_t i = 0; i < EXFAT_UPCASE_CHARS; ++i) {
+        table[i] = (uint16_t)i;
+    }
+
+    uint32_t ch = 0;
+    for (uint32_t i = 0; i < n && ch < EXFAT_UPCASE_CHARS; ++i) {
+        if (data[i] == 0xFFFF && i + 1 < n) {
+            ch += data[++i];
+        }
+        else {
+            table[ch++] = data[i];
+        }
+    }
+    return table;
+}
+
+
+#pragma mark - File Allocation Table
+
+// Only chains that can not be described as a single run appear in the FAT,
+// so a single sector of it is kept at a time.
+
+static uint32_t exfat_fat_start(exfat_t ex)
+{
+    // The second FAT is only ever in use on TexFAT volumes.
+    uint32_t start = ex->boot->fat_offset;
+    if (ex->boot->fat_count > 1 && (ex->boot->volume_flags & 0x01)) {
+        start += ex->boot->fat_length;
+    }
+    return start;
+}
+
+static void exfat_flush_fat(vfs_t fs)
+{
+    exfat_t ex = fs->assoc_info;
+    if (ex->fat_dirty) {
+        device_write_sector(fs->device,
+                            exfat_fat_start(ex) + ex->fat_sector_index,
+                            ex->fat_sector);
+        ex->fat_dirty = 0;
+    }
+}
+
+static uint32_t *exfat_fat_entry(vfs_t fs, uint32_t cluster)
+{
+    exfat_t ex = fs->assoc_info;
+    uint32_t per_sector = exfat_bytes_per_sector(ex->boot) / sizeof(uint32_t);
+    uint32_t index = cluster / per_sector;
+
+    if (index != ex->fat_sector_index) {
+        exfat_flush_fat(fs);
+        device_read_sectors_into(fs->device,
+                                 exfat_fat_start(ex) + index,
+                                 1,
+                                 ex->fat_sector);
+        ex->fat_sector_index = index;
+    }
+
+    return (uint32_t *)ex->fat_sector + (cluster % per_sector);
+}
+
+static uint32_t exfat_next_cluster(vfs_t fs, uint32_t cluster)
+{
+    exfat_t ex = fs->assoc_info;
+    if (!exfat_is_valid_cluster(ex, cluster)) {
+        return EXFAT_CLUSTER_EOF;
+    }
+    return *exfat_fat_entry(fs, cluster);
+}
+
+static void exfat_set_next_cluster(vfs_t fs, uint32_t cluster, uint32_t next)
+{
+    exfat_t ex = fs->assoc_info;
+    assert(exfat_is_valid_cluster(ex, cluster));
+    *exfat_fat_entry(fs, cluster) = next;
+    ex->fat_dirty = 1;
+}
+
+static void exfat_link_run(vfs_t fs, uint32_t first, uint32_t count)
+{
+    // Describe a run of clusters as a chain, ending it at the last cluster.
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t next = i + 1 < count ? first + i + 1 : EXFAT_CLUSTER_EOF;
+        exfat_set_next_cluster(fs, first + i, next);
+    }
+}
+
+
+#pragma mark - Allocation Bitmap
+
+// The bitmap is held in memory for as long as the volume is mounted, along
+// with a count of the free clusters, so that a request for more space than is
+// available is turned away without searching for it.
+
+static int exfat_bitmap_test(exfat_t ex, uint32_t cluster)
+{
+    uint32_t bit = cluster - 2;
+    return (ex->bitmap[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static void exfat_bitmap_mark(exfat_t ex,
+                              uint32_t first,
+                              uint32_t count,
+                              uint8_t used)
+{
+    if (count == 0) {
+        return;
+    }
+
+    for (uint32_t cluster = first; cluster < first + count; ++cluster) {
+        uint32_t bit = cluster - 2;
+        uint8_t mask = (uint8_t)(1 << (bit & 7));
+        if (used && !(ex->bitmap[bit >> 3] & mask)) {
+            ex->bitmap[bit >> 3] |= mask;
+            ex->free_count--;
+        }
+        else if (!used && (ex->bitmap[bit >> 3] & mask)) {
+            ex->bitmap[bit >> 3] &= ~mask;
+            ex->free_count++;
+        }
+    }
+
+    // Keep track of the range of bytes that need writing back.
+    uint32_t first_byte = (first - 2) >> 3;
+    uint32_t last_byte = (first + count - 3) >> 3;
+    if (!ex->bitmap_dirty) {
+        ex->bitmap_dirty_first = first_byte;
+        ex->bitmap_dirty_last = last_byte;
+    }
+    else {
+        ex->bitmap_dirty_first = MIN(ex->bitmap_dirty_first, first_byte);
+        ex->bitmap_dirty_last = MAX(ex->bitmap_dirty_last, last_byte);
+    }
+    ex->bitmap_dirty = 1;
+}
+
+static int exfat_bitmap_range_free(exfat_t ex, uint32_t first, uint32_t count)
+{
+    if (first < 2 || first + count > ex->boot->cluster_count + 2) {
+        return 0;
+    }
+    for (uint32_t cluster = first; cluster < first + count; ++cluster) {
+        if (exfat_bitmap_test(ex, cluster)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t exfat_bitmap_find_run(exfat_t ex,
+                                      uint32_t start,
+                                      uint32_t end,
+                                      uint32_t count)
+{
+    // Look for the first run of free clusters of the requested length. Whole
+    // words of clusters that are in use are stepped over in one go.
+    uint32_t run = 0;
+    uint32_t cluster = start;
+    while (cluster < end) {
+        uint32_t bit = cluster - 2;
+        if ((bit & 63) == 0 && cluster + 64 <= end) {
+            uint64_t word;
+            memcpy(&word, ex->bitmap + (bit >> 3), sizeof(word));
+            if (word == UINT64_MAX) {
+                run = 0;
+                cluster += 64;
+                continue;
+            }
+        }
+
+        if (exfat_bitmap_test(ex, cluster)) {
+            run = 0;
+        }
+        else if (++run == count) {
+            return cluster - count + 1;
+        }
+        cluster++;
+    }
+    return 0;
+}
+
+static uint32_t exfat_bitmap_claim_run(exfat_t ex, uint32_t count)
+{
+    if (count == 0 || count > ex->free_count) {
+        return 0;
+    }
+
+    // Search onwards from the last allocation, and then from the start of
+    // the heap.
+    uint32_t end = ex->boot->cluster_count + 2;
+    uint32_t cluster = exfat_bitmap_find_run(ex,
+                                             ex->next_free_cluster,
+                                             end,
+                                             count);
+    if (!cluster && ex->next_free_cluster > 2) {
+        cluster = exfat_bitmap_find_run(ex, 2, end, count);
+    }
+    if (!cluster) {
+        return 0;
+    }
+
+    exfat_bitmap_mark(ex, cluster, count, 1);
+    ex->next_free_cluster = cluster + count < end ? cluster + count : 2;
+    return cluster;
+}
+
+static void exfat_flush_bitmap(vfs_t fs)
+{
+    exfat_t ex = fs->assoc_info;
+    if (!ex->bitmap_dirty) {
+        return;
+    }
+
+    uint32_t bps = exfat_bytes_per_sector(ex->boot);
+    uint32_t first = ex->bitmap_dirty_first / bps;
+    uint32_t last = ex->bitmap_dirty_last / bps;
+    for (uint32_t n = first; n <= last; ++n) {
+        uint32_t sector = vfs_extent_list_sector(ex->bitmap_extents, n);
+        if (sector != UINT32_MAX) {
+            device_write_sector(fs->device, sector, ex->bitmap + (n * bps));
+        }
+    }
+    ex->bitmap_dirty = 0;
+}
+
+
+#pragma mark - Cluster Allocation
+
+static uint32_t exfat_entry_last_cluster(vfs_t fs,
+                                         const struct exfat_entry *entry,
+                                         uint32_t count)
+{
+    if (entry->is_contiguous) {
+        return entry->first_cluster + count - 1;
+    }
+
+    uint32_t cluster = entry->first_cluster;
+    for (uint32_t i = 1; i < count; ++i) {
+        cluster = exfat_next_cluster(fs, cluster);
+    }
+    return cluster;
+}
+
+static void exfat_release_chain(vfs_t fs, uint32_t cluster, uint32_t count)
+{
+    exfat_t ex = fs->assoc_info;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!exfat_is_valid_cluster(ex, cluster)) {
+            break;
+        }
+        uint32_t next = exfat_next_cluster(fs, cluster);
+        exfat_set_next_cluster(fs, cluster, EXFAT_CLUSTER_FREE);
+        exfat_bitmap_mark(ex, cluster, 1, 0);
+        cluster = next;
+    }
+}
+
+static int exfat_resize_allocation(vfs_t fs,
+                                   struct exfat_entry *entry,
+                                   uint32_t clusters)
+{
+    exfat_t ex = fs->assoc_info;
+    uint32_t current = exfat_entry_cluster_count(ex, entry);
+
+    if (clusters < current) {
+        // Contiguous files have nothing in the FAT, and simply give up the
+        // end of their run. Chains are cut short.
+        if (entry->is_contiguous) {
+            exfat_bitmap_mark(ex,
+                              entry->first_cluster + clusters,
+                              current - clusters,
+                              0);
+        }
+        else if (clusters == 0) {
+            exfat_release_chain(fs, entry->first_cluster, current);
+        }
+        else {
+            uint32_t last = exfat_entry_last_cluster(fs, entry, clusters);
+            exfat_release_chain(fs,
+                                exfat_next_cluster(fs, last),
+                                current - clusters);
+            exfat_set_next_cluster(fs, last, EXFAT_CLUSTER_EOF);
+        }
+
+        if (clusters == 0) {
+            entry->first_cluster = 0;
+            entry->is_contiguous = 0;
+        }
+        return 1;
+    }
+    else if (clusters == current) {
+        return 1;
+    }
+
+    // The free count is exact, so a request that can not be met is turned
+    // down before anything is touched.
+    uint32_t extra = clusters - current;
+    if (extra > ex->free_count) {
+        return 0;
+    }
+
+    uint32_t last = 0;
+    if (current == 0) {
+        uint32_t first = exfat_bitmap_claim_run(ex, extra);
+        if (first) {
+            entry->first_cluster = first;
+            entry->is_contiguous = !entry->needs_chain;
+            if (entry->needs_chain) {
+                exfat_link_run(fs, first, extra);
+            }
+            return 1;
+        }
+    }
+    else {
+        // Growing in place keeps a contiguous file contiguous.
+        last = exfat_entry_last_cluster(fs, entry, current);
+        if (exfat_bitmap_range_free(ex, last + 1, extra)) {
+            exfat_bitmap_mark(ex, last + 1, extra, 1);
+            if (!entry->is_contiguous) {
+                exfat_link_run(fs, last + 1, extra);
+                exfat_set_next_cluster(fs, last, last + 1);
+            }
+            return 1;
+        }
+
+        // Otherwise the file has to be described by a chain from now on.
+        if (entry->is_contiguous) {
+            exfat_link_run(fs, entry->first_cluster, current);
+            entry->is_contiguous = 0;
+        }
+
+        uint32_t first = exfat_bitmap_claim_run(ex, extra);
+        if (first) {
+            exfat_link_run(fs, first, extra);
+            exfat_set_next_cluster(fs, last, first);
+            return 1;
+        }
+    }
+
+    // There is no single run large enough, so the space is gathered up a
+    // cluster at a time.
+    entry->is_contiguous = 0;
+    for (uint32_t i = 0; i < extra; ++i) {
+        uint32_t cluster = exfat_bitmap_claim_run(ex, 1);
+        exfat_set_next_cluster(fs, cluster, EXFAT_CLUSTER_EOF);
+        if (last) {
+            exfat_set_next_cluster(fs, last, cluster);
+        }
+        else {
+            entry->first_cluster = cluster;
+        }
+        last = cluster;
+    }
+    return 1;
+}
+
+
+#pragma mark - Extents
+
+static vfs_extent_list_t exfat_entry_extents(vfs_t fs,
+                                             const struct exfat_entry *entry)
+{
+    exfat_t ex = fs->assoc_info;
+    uint32_t spc = exfat_sectors_per_cluster(ex->boot);
+    uint32_t clusters = exfat_entry_cluster_count(ex, entry);
+    vfs_extent_list_t extents = vfs_extent_list_init();
+
+    // A contiguous file is a single run, and needs nothing from the FAT.
+    if (entry->is_contiguous) {
+        if (exfat_is_valid_cluster(ex, entry->first_cluster)) {
+            uint32_t limit = ex->boot->cluster_count + 2;
+            clusters = MIN(clusters, limit - entry->first_cluster);
+            vfs_extent_list_append(extents,
+                                   exfat_cluster_sector(ex,
+                                                        entry->first_cluster),
+                                   clusters * spc);
+        }
+        return extents;
+    }
+
+    // Chains are followed cluster by cluster, with adjacent clusters being
+    // merged into runs as they are appended.
+    uint32_t cluster = entry->first_cluster;
+    for (uint32_t i = 0; i < clusters; ++i) {
+        if (!exfat_is_valid_cluster(ex, cluster)) {
+            break;
+        }
+        vfs_extent_list_append(extents,
+                               exfat_cluster_sector(ex, cluster),
+                               spc);
+        cluster = exfat_next_cluster(fs, cluster);
+    }
+    return extents;
+}
+
+static vfs_extent_list_t exfat_metadata_extents(vfs_t fs,
+                                                uint32_t first_cluster,
+                                                uint64_t length)
+{
+    // The bitmap and up-case table are normally chained in the FAT, but are
+    // taken to be contiguous where the chain is missing.
+    exfat_t ex = fs->assoc_info;
+    struct exfat_entry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.first_cluster = first_cluster;
+    entry.data_length = length;
+
+    vfs_extent_list_t extents = exfat_entry_extents(fs, &entry);
+    uint64_t bytes = (uint64_t)extents->sector_count
+                   * exfat_bytes_per_sector(ex->boot);
+    if (bytes < length) {
+        vfs_extent_list_destroy(extents);
+        entry.is_contiguous = 1;
+        extents = exfat_entry_extents(fs, &entry);
+    }
+    return extents;
+}
+
+static uint8_t *exfat_read_extents(vfs_t fs, vfs_extent_list_t extents)
+{
+    exfat_t ex = fs->assoc_info;
+    uint32_t bps = exfat_bytes_per_sector(ex->boot);
+    uint8_t *data = calloc((size_t)extents->sector_count * bps + 8, 1);
+
+    struct vfs_extent_iterator it;
+    const struct vfs_extent *extent;
+    vfs_extent_iterator_init(&it, extents);
+    while ((extent = vfs_extent_iterator_next(&it))) {
+        device_read_sectors_into(fs->device,
+                                 extent->start,
+                                 extent->length,
+                                 data + ((size_t)extent->offset * bps));
+    }
+    return data;
+}
+
+static vfs_extent_list_t exfat_node_extents(vfs_t fs, vfs_node_t node)
+{
+    assert(fs);
+    assert(node);
+
+    if (!node->extents) {
+        node->extents = exfat_entry_extents(fs, node->assoc_info);
+    }
+    return node->extents;
+}
+
+static void exfat_discard_node_extents(vfs_node_t node)
+{
+    vfs_extent_list_destroy(node->extents);
+    node->extents = NULL;
+}
+
+
+#pragma mark - Directories
+
+static vfs_node_t exfat_construct_node(vfs_t fs,
+                                       struct arena *arena,
+                                       struct exfat_entry *entry,
+                                       const char *name)
+{
+    enum vfs_node_attributes attributes =
+        exfat_translate_to_vfs_attributes(entry->attributes);
+    vfs_node_t node = vfs_node_init_in_arena(arena,
+                                             fs,
+                                             name,
+                                             attributes,
+                                             vfs_node_used,
+                                             entry);
+
+    // Directories do not report a size, as with FAT.
+    if (!(attributes & vfs_node_directory_attribute)) {
+        node->size = (uint32_t)entry->data_length;
+    }
+    node->creation_time = exfat_timestamp_to_posix(entry->create_time);
+    node->modification_time = exfat_timestamp_to_posix(entry->modify_time);
+    node->access_time = exfat_timestamp_to_posix(entry->access_time);
+    return node;
+}
+
+static int exfat_directory_parse_set(vfs_t fs,
+                                     struct exfat_directory *dir,
+                                     uint32_t index,
+                                     uint32_t count)
+{
+    // A set is only accepted when its stream entry and name entries are all
+    // present, and its checksum matches.
+    union exfat_dir_entry *set =
+        (union exfat_dir_entry *)(dir->data + (index * EXFAT_SLOT_SIZE));
+    if (count < 3
+        || index + count > dir->slot_count
+        || set[1].raw[0] != exfat_entry_stream
+        || exfat_entry_set_checksum(set, count) != set[0].file.checksum) {
+        return 0;
+    }
+
+    struct exfat_stream_entry *stream = &set[1].stream;
+    uint32_t len = stream->name_length;
+    if (len == 0 || exfat_slot_count_for_name(len) > count) {
+        return 0;
+    }
+
+    uint16_t chars[EXFAT_NAME_MAX_LENGTH];
+    for (uint32_t i = 0; i < len; ++i) {
+        uint32_t n = 2 + (i / EXFAT_NAME_CHARS_PER_ENTRY);
+        union exfat_dir_entry *slot = &set[n];
+        if (slot->raw[0] != exfat_entry_name) {
+            return 0;
+        }
+        chars[i] = slot->name.name[i % EXFAT_NAME_CHARS_PER_ENTRY];
+    }
+
+    struct exfat_entry *entry = arena_alloc(&dir->arena, sizeof(*entry));
+    entry->parent = dir;
+    entry->index = index;
+    entry->slot_count = count;
+    entry->attributes = set[0].file.attributes;
+    entry->name_hash = stream->name_hash;
+    entry->create_time = set[0].file.create_time;
+    entry->modify_time = set[0].file.modify_time;
+    entry->access_time = set[0].file.access_time;
+    entry->first_cluster = stream->first_cluster;
+    entry->data_length = stream->data_length;
+    entry->valid_data_length = MIN(stream->valid_data_length,
+                                   stream->data_length);
+    entry->is_contiguous = (stream->flags & EXFAT_FLAG_NO_FAT_CHAIN) != 0
+                        && stream->first_cluster != 0;
+
+    char *name = exfat_name_from_utf16(chars, len);
+    dir->nodes[index] = exfat_construct_node(fs, &dir->arena, entry, name);
+    free(name);
+
+    name_index_insert(&dir->names, entry->name_hash, index);
+    return 1;
+}
+
+static struct exfat_directory *exfat_load_directory(vfs_t fs,
+                                                    struct exfat_entry *entry)
+{
+    exfat_t ex = fs->assoc_info;
+    uint32_t bps = exfat_bytes_per_sector(ex->boot);
+
+    // The directory is read in whole, and stays resident until the volume is
+    // unmounted.
+    struct exfat_directory *dir = calloc(1, sizeof(*dir));
+    dir->entry = entry;
+    dir->extents = exfat_entry_extents(fs, entry);
+    dir->data = exfat_read_extents(fs, dir->extents);
+    dir->slot_count = (dir->extents->sector_count * bps) / EXFAT_SLOT_SIZE;
+    dir->nodes = calloc(dir->slot_count + 1, sizeof(*dir->nodes));
+
+    uint32_t expected = (dir->slot_count / 3) + 1;
+    arena_init(&dir->arena, expected * EXFAT_ARENA_BYTES_PER_ENTRY);
+    name_index_init(&dir->names, expected);
+    slot_map_init(&dir->free_slots, dir->slot_count);
+
+    // Every slot starts out as used in the map, so only the free ones need
+    // recording. Everything from the end of directory marker onwards is free,
+    // and is cleared in case the marker later moves along.
+    uint32_t i = 0;
+    while (i < dir->slot_count) {
+        uint8_t type = dir->data[i * EXFAT_SLOT_SIZE];
+        if (type == exfat_entry_end) {
+            memset(dir->data + (i * EXFAT_SLOT_SIZE),
+                   0,
+                   (dir->slot_count - i) * EXFAT_SLOT_SIZE);
+            for (; i < dir->slot_count; ++i) {
+                slot_map_set_free(&dir->free_slots, i);
+            }
+            break;
+        }
+        else if (!(type & exfat_entry_in_use)) {
+            slot_map_set_free(&dir->free_slots, i);
+            i++;
+        }
+        else if (type == exfat_entry_file) {
+            union exfat_dir_entry *slot =
+                (union exfat_dir_entry *)(dir->data + (i * EXFAT_SLOT_SIZE));
+            uint32_t count = slot->file.secondary_count + 1;
+            if (exfat_directory_parse_set(fs, dir, i, count)) {
+                i += count;
+            }
+            else {
+                fprintf(stderr,
+                        "Skipping a damaged entry set in a directory.\n");
+                i++;
+            }
+        }
+        else {
+            // Volume metadata, and anything else we do not understand, is
+            // left alone.
+            i++;
+        }
+    }
+
+    dir->end = vfs_node_init_in_arena(&dir->arena,
+                                      fs,
+                                      "",
+                                      0,
+                                      vfs_node_unused,
+                                      NULL);
+
+    dir->next = ex->directories;
+    ex->directories = dir;
+    return dir;
+}
+
+static void exfat_destroy_directory(struct exfat_directory *dir)
+{
+    // Nodes are released one at a time, as they may still be linked in the
+    // order they were last listed.
+    for (uint32_t i = 0; i < dir->slot_count; ++i) {
+        vfs_node_t node = dir->nodes[i];
+        if (node) {
+            node->next_sibling = NULL;
+            vfs_node_destroy(node);
+        }
+    }
+    vfs_extent_list_destroy(dir->extents);
+    name_index_destroy(&dir->names);
+    slot_map_destroy(&dir->free_slots);
+    arena_destroy(&dir->arena);
+    free(dir->nodes);
+    free(dir->data);
+    free(dir);
+}
+
+static void exfat_drop_directory(vfs_t fs, struct exfat_directory *dir)
+{
+    exfat_t ex = fs->assoc_info;
+    struct exfat_directory **link = &ex->directories;
+    while (*link && *link != dir) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = dir->next;
+    }
+    if (ex->current_dir == dir) {
+        ex->current_dir = ex->root;
+    }
+    exfat_destroy_directory(dir);
+}
+
+static struct exfat_directory *exfat_directory_for(vfs_t fs,
+                                                   vfs_node_t directory)
+{
+    // Directories are identified by their entry, which stays put for as long
+    // as the volume is mounted. A NULL directory is the root directory.
+    exfat_t ex = fs->assoc_info;
+    if (!directory) {
+        return ex->root;
+    }
+
+    struct exfat_entry *entry = directory->assoc_info;
+    struct exfat_directory *dir = ex->directories;
+    while (dir && dir->entry != entry) {
+        dir = dir->next;
+    }
+    return dir ? dir : exfat_load_directory(fs, entry);
+}
+
+static void exfat_directory_store(struct exfat_directory *dir,
+                                  struct exfat_entry *entry)
+{
+    // Bring the entry up to date with any changes made through its node, and
+    // then rebuild the set in its on disk form.
+    vfs_node_t node = dir->nodes[entry->index];
+    uint16_t preserved = entry->attributes & exfat_attribute_archive;
+    entry->attributes = preserved
+                      | exfat_translate_from_vfs_attributes(node->attributes);
+    entry->create_time = exfat_timestamp_from_posix(node->creation_time);
+    entry->modify_time = exfat_timestamp_from_posix(node->modification_time);
+    entry->access_time = exfat_timestamp_from_posix(node->access_time);
+    node->is_dirty = 0;
+
+    uint16_t chars[EXFAT_NAME_MAX_LENGTH];
+    uint32_t len = exfat_name_to_utf16(node->name, chars);
+
+    union exfat_dir_entry *set =
+        (union exfat_dir_entry *)(dir->data + (entry->index * EXFAT_SLOT_SIZE));
+    memset(set, 0, entry->slot_count * EXFAT_SLOT_SIZE);
+
+    set[0].file.type = exfat_entry_file;
+    set[0].file.secondary_count = (uint8_t)(entry->slot_count - 1);
+    set[0].file.attributes = entry->attributes;
+    set[0].file.create_time = entry->create_time;
+    set[0].file.modify_time = entry->modify_time;
+    set[0].file.access_time = entry->access_time;
+
+    set[1].stream.type = exfat_entry_stream;
+    set[1].stream.flags = EXFAT_FLAG_ALLOCATION_POSSIBLE;
+    if (entry->is_contiguous) {
+        set[1].stream.flags |= EXFAT_FLAG_NO_FAT_CHAIN;
+    }
+    set[1].stream.name_length = (uint8_t)len;
+    set[1].stream.name_hash = entry->name_hash;
+    set[1].stream.valid_data_length = entry->valid_data_length;
+    set[1].stream.first_cluster = entry->first_cluster;
+    set[1].stream.data_length = entry->data_length;
+
+    for (uint32_t i = 0; i < len; ++i) {
+        uint32_t n = 2 + (i / EXFAT_NAME_CHARS_PER_ENTRY);
+        union exfat_dir_entry *slot = &set[n];
+        slot->name.type = exfat_entry_name;
+        slot->name.name[i % EXFAT_NAME_CHARS_PER_ENTRY] = chars[i];
+    }
+    for (uint32_t i = 2; i < entry->slot_count; ++i) {
+        set[i].name.type = exfat_entry_name;
+    }
+
+    set[0].file.checksum = exfat_entry_set_checksum(set, entry->slot_count);
+    dir->is_dirty = 1;
+}
+
+static void exfat_directory_release(struct exfat_directory *dir,
+                                    uint32_t index,
+                                    uint32_t count)
+{
+    // Clearing the in use bit of each entry of a set marks it as deleted.
+    for (uint32_t i = index; i < index + count; ++i) {
+        dir->data[i * EXFAT_SLOT_SIZE] &= ~exfat_entry_in_use;
+        slot_map_set_free(&dir->free_slots, i);
+    }
+    dir->is_dirty = 1;
+}
+
+static vfs_node_t exfat_directory_list(struct exfat_directory *dir)
+{
+    // Link together the nodes in the order their sets appear, finishing with
+    // the end of directory marker.
+    vfs_node_t head = dir->end;
+    vfs_node_t prev = NULL;
+    for (uint32_t i = 0; i < dir->slot_count; ++i) {
+        vfs_node_t node = dir->nodes[i];
+        if (!node) {
+            continue;
+        }
+        node->prev_sibling = prev;
+        if (prev) {
+            prev->next_sibling = node;
+        }
+        else {
+            head = node;
+        }
+        prev = node;
+    }
+
+    dir->end->prev_sibling = prev;
+    dir->end->next_sibling = NULL;
+    if (prev) {
+        prev->next_sibling = dir->end;
+    }
+    return head;
+}
+
+static uint32_t exfat_directory_lookup(vfs_t fs,
+                                       struct exfat_directory *dir,
+                                       const char *name)
+{
+    exfat_t ex = fs->assoc_info;
+    uint16_t chars[EXFAT_NAME_MAX_LENGTH];
+    uint32_t len = exfat_name_to_utf16(name, chars);
+    if (len == 0) {
+        return NAME_INDEX_NONE;
+    }
+
+    // The index only tells us which sets share a hash with the name, so each
+    // candidate needs to be confirmed against the up-cased name.
+    uint16_t hash = exfat_name_hash(ex, chars, len);
+    uint32_t cursor = 0;
+    uint32_t index = name_index_first(&dir->names, hash, &cursor);
+    while (index != NAME_INDEX_NONE) {
+        uint16_t other[EXFAT_NAME_MAX_LENGTH];
+        uint32_t other_len = exfat_name_to_utf16(dir->nodes[index]->name,
+                                                 other);
+        uint32_t i = 0;
+        while (other_len == len
+               && i < len
+               && ex->upcase[chars[i]] == ex->upcase[other[i]]) {
+            ++i;
+        }
+        if (other_len == len && i == len) {
+            return index;
+        }
+        index = name_index_next(&dir->names, hash, &cursor);
+    }
+    return NAME_INDEX_NONE;
+}
+
+static int exfat_grow_directory(vfs_t fs, struct exfat_directory *dir)
+{
+    exfat_t ex = fs->assoc_info;
+    struct exfat_entry *entry = dir->entry;
+    uint32_t clusters = exfat_entry_cluster_count(ex, entry);
+    uint64_t bytes = (uint64_t)(clusters + 1) * ex->bytes_per_cluster;
+    if (bytes > EXFAT_MAX_DIRECTORY_BYTES
+        || !exfat_resize_allocation(fs, entry, clusters + 1)) {
+        return 0;
+    }
+
+    entry->data_length = bytes;
+    entry->valid_data_length = bytes;
+    vfs_extent_list_destroy(dir->extents);
+    dir->extents = exfat_entry_extents(fs, entry);
+
+    // The new cluster contributes a run of never used entries. They are
+    // written out along with the rest of the directory when it is flushed.
+    uint32_t first = dir->slot_count;
+    uint32_t added = ex->bytes_per_cluster / EXFAT_SLOT_SIZE;
+    uint32_t slot_count = first + added;
+    dir->data = realloc(dir->data, (size_t)slot_count * EXFAT_SLOT_SIZE);
+    memset(dir->data + ((size_t)first * EXFAT_SLOT_SIZE),
+           0,
+           (size_t)added * EXFAT_SLOT_SIZE);
+    dir->nodes = realloc(dir->nodes, (slot_count + 1) * sizeof(*dir->nodes));
+    memset(dir->nodes + first, 0, (added + 1) * sizeof(*dir->nodes));
+    dir->slot_count = slot_count;
+
+    slot_map_resize(&dir->free_slots, slot_count);
+    for (uint32_t i = first; i < slot_count; ++i) {
+        slot_map_set_free(&dir->free_slots, i);
+    }
+    dir->is_dirty = 1;
+
+    // The new size of the directory is recorded in its own entry set.
+    if (entry->parent) {
+        exfat_discard_node_extents(entry->parent->nodes[entry->index]);
+        exfat_directory_store(entry->parent, entry);
+    }
+    return 1;
+}
+
+static uint32_t exfat_directory_reserve(vfs_t fs,
+                                        struct exfat_directory *dir,
+                                        uint32_t count)
+{
+    // Sets always take the lowest numbered run of free slots that can hold
+    // them, so that none ever ends up beyond the end of directory marker.
+    uint32_t index = slot_map_first_free_run(&dir->free_slots, count);
+    while (index == SLOT_MAP_NONE && exfat_grow_directory(fs, dir)) {
+        index = slot_map_first_free_run(&dir->free_slots, count);
+    }
+
+    if (index != SLOT_MAP_NONE) {
+        for (uint32_t i = index; i < index + count; ++i) {
+            slot_map_set_used(&dir->free_slots, i);
+        }
+    }
+    return index;
+}
+
+static void exfat_flush_directory(vfs_t fs, struct exfat_directory *dir)
+{
+    exfat_t ex = fs->assoc_info;
+    uint32_t bps = exfat_bytes_per_sector(ex->boot);
+
+    // Sets whose nodes have changed since they were last stored are rebuilt
+    // before the directory is written out, one run of clusters at a time.
+    for (uint32_t i = 0; i < dir->slot_count; ++i) {
+        vfs_node_t node = dir->nodes[i];
+        if (node && node->is_dirty) {
+            exfat_directory_store(dir, node->assoc_info);
+        }
+    }
+
+    struct vfs_extent_iterator it;
+    const struct vfs_extent *extent;
+    vfs_extent_iterator_init(&it, dir->extents);
+    while ((extent = vfs_extent_iterator_next(&it))) {
+        device_write_sectors(fs->device,
+                             extent->start,
+                             extent->length,
+                             dir->data + ((size_t)extent->offset * bps));
+    }
+    dir->is_dirty = 0;
+}
+
+
+#pragma mark - exFAT Formatting
+
+static uint32_t exfat_log2(uint32_t n)
+{
+    uint32_t shift = 0;
+    while (((uint32_t)1 << (shift + 1)) <= n) {
+        ++shift;
+    }
+    return shift;
+}
+
+static uint32_t exfat_cluster_size_for_volume(uint64_t bytes)
+{
+    // Small volumes use small clusters to keep waste down, and large ones use
+    // large clusters to keep the FAT and bitmap small.
+    if (bytes <= (uint64_t)256 * 1024 * 1024) {
+        return 4 * 1024;
+    }
+    else if (bytes <= (uint64_t)32 * 1024 * 1024 * 1024) {
+        return 32 * 1024;
+    }
+    return 128 * 1024;
+}
+
+static void exfat_write_zeros(vdevice_t dev, uint32_t sector, uint32_t count)
+{
+    uint32_t chunk = 128;
+    uint8_t *zeros = calloc(chunk, dev->sector_size);
+    while (count > 0) {
+        uint32_t n = MIN(chunk, count);
+        device_write_sectors(dev, sector, n, zeros);
+        sector += n;
+        count -= n;
+    }
+    free(zeros);
+}
+
+static void exfat_write_boot_region(vdevice_t dev,
+                                    exfat_boot_sector_t boot,
+                                    uint8_t *bootcode)
+{
+    uint32_t bps = dev->sector_size;
+    uint8_t *region = calloc(EXFAT_BOOT_REGION_SECTORS, bps);
+
+    // The boot code takes up the rest of the main boot sector. Without any,
+    // the machine is simply halted.
+    memcpy(region, boot, sizeof(*boot));
+    exfat_boot_sector_t main = (exfat_boot_sector_t)region;
+    if (bootcode) {
+        memcpy(main->boot_code,
+               bootcode + EXFAT_BOOT_CODE_OFFSET,
+               sizeof(main->boot_code));
+    }
+    else {
+        memset(main->boot_code, 0xF4, sizeof(main->boot_code));
+    }
+
+    // Each of the extended boot sectors ends with its signature. The OEM
+    // parameters and reserved sector are left empty.
+    for (uint32_t i = 1; i <= 8; ++i) {
+        uint32_t signature = EXFAT_EXTENDED_BOOT_SIGNATURE;
+        memcpy(region + (i * bps) + bps - 4, &signature, sizeof(signature));
+    }
+
+    // The final sector is filled with the checksum of everything before it.
+    uint32_t checksum = exfat_boot_checksum(region, bps);
+    uint32_t *sums = (uint32_t *)(region + ((EXFAT_BOOT_REGION_SECTORS - 1)
+                                            * bps));
+    for (uint32_t i = 0; i < bps / sizeof(uint32_t); ++i) {
+        sums[i] = checksum;
+    }
+
+    device_write_sectors(dev, 0, EXFAT_BOOT_REGION_SECTORS, region);
+    device_write_sectors(dev,
+                         EXFAT_BOOT_REGION_SECTORS,
+                         EXFAT_BOOT_REGION_SECTORS,
+                         region);
+    free(region);
+}
+
+static void exfat_format_device(
+    vdevice_t dev,
+    const char *label,
+    uint8_t *bootcode,
+    uint8_t *reserved_data,
+    uint16_t additional_reserved_sectors
+) {
+    uint32_t bps = dev->sector_size;
+    uint32_t total = device_total_sectors(dev);
+    if (bps < 512 || bps > 4096 || (bps & (bps - 1)) != 0) {
+        fprintf(stderr, "exFAT does not support %u byte sectors.\n", bps);
+        return;
+    }
+
+    // Work out the geometry of the volume. The table and the heap are carved
+    // out of the same space, so keep shrinking the number of clusters until
+    // the table that describes them leaves room for them. The heap starts on
+    // a cluster boundary.
+    uint32_t bpc = MAX(exfat_cluster_size_for_volume((uint64_t)total * bps),
+                       bps);
+    uint32_t spc = bpc / bps;
+    uint32_t fat_offset = EXFAT_RESERVED_SECTORS + additional_reserved_sectors;
+    uint32_t clusters = total > fat_offset ? (total - fat_offset) / spc : 0;
+    clusters = MIN(clusters, (uint32_t)EXFAT_MAX_CLUSTERS);
+    uint32_t fat_length = 0;
+    uint32_t heap = 0;
+    for (;;) {
+        fat_length = (uint32_t)((((uint64_t)clusters + 2) * 4 + bps - 1) / bps);
+        heap = ((fat_offset + fat_length + spc - 1) / spc) * spc;
+        uint32_t fit = heap < total ? (total - heap) / spc : 0;
+        if (fit >= clusters) {
+            break;
+        }
+        clusters = fit;
+    }
+
+    // The bitmap, the up-case table and the root directory take up the
+    // first clusters of the heap, in that order.
+    uint16_t upcase[128];
+    uint32_t upcase_bytes = exfat_default_upcase(upcase) * sizeof(uint16_t);
+    uint32_t bitmap_bytes = (clusters + 7) / 8;
+    uint32_t bitmap_clusters = (bitmap_bytes + bpc - 1) / bpc;
+    uint32_t upcase_clusters = (upcase_bytes + bpc - 1) / bpc;
+    uint32_t used = bitmap_clusters + upcase_clusters + 1;
+    if (clusters == 0 || used >= clusters) {
+        fprintf(stderr,
+                "The device is too small to hold an exFAT file system.\n");
+        return;
+    }
+    uint32_t bitmap_cluster = 2;
+    uint32_t upcase_cluster = bitmap_cluster + bitmap_clusters;
+    uint32_t root_cluster = upcase_cluster + upcase_clusters;
+
+    struct exfat_boot_sector boot;
+    memset(&boot, 0, sizeof(boot));
+    uint8_t jmp[3] = {0xEB, EXFAT_BOOT_CODE_OFFSET - 2, 0x90};
+    memcpy(boot.jmp, jmp, sizeof(jmp));
+    memcpy(boot.fs_name, EXFAT_FS_NAME, sizeof(boot.fs_name));
+    boot.volume_length = total;
+    boot.fat_offset = fat_offset;
+    boot.fat_length = fat_length;
+    boot.cluster_heap_offset = heap;
+    boot.cluster_count = clusters;
+    boot.root_cluster = root_cluster;
+    boot.volume_serial = (uint32_t)time(NULL);
+    boot.revision = EXFAT_REVISION;
+    boot.bytes_per_sector_shift = (uint8_t)exfat_log2(bps);
+    boot.sectors_per_cluster_shift = (uint8_t)exfat_log2(spc);
+    boot.fat_count = 1;
+    boot.drive_select = 0x80;
+    boot.percent_in_use = (uint8_t)(((uint64_t)used * 100) / clusters);
+    boot.boot_signature = EXFAT_BOOT_SIGNATURE;
+    exfat_write_boot_region(dev, &boot, bootcode);
+
+    // If there are reserved sectors, then write those sectors.
+    if (additional_reserved_sectors > 0) {
+        device_write_sectors(dev,
+                             EXFAT_RESERVED_SECTORS,
+                             additional_reserved_sectors,
+                             reserved_data);
+    }
+
+    // Chain the metadata together in the FAT, and clear the rest of it.
+    uint32_t head_sectors = (((used + 2) * 4) + bps - 1) / bps;
+    uint32_t *fat = calloc(head_sectors, bps);
+    fat[0] = 0xFFFFFFF8;
+    fat[1] = EXFAT_CLUSTER_EOF;
+    uint32_t runs[3][2] = {
+        { bitmap_cluster, bitmap_clusters },
+        { upcase_cluster, upcase_clusters },
+        { root_cluster, 1 },
+    };
+    for (uint32_t r = 0; r < 3; ++r) {
+        for (uint32_t i = 0; i < runs[r][1]; ++i) {
+            uint32_t cluster = runs[r][0] + i;
+            fat[cluster] = i + 1 < runs[r][1] ? cluster + 1 : EXFAT_CLUSTER_EOF;
+        }
+    }
+    device_write_sectors(dev, fat_offset, head_sectors, (uint8_t *)fat);
+    exfat_write_zeros(dev,
+                      fat_offset + head_sectors,
+                      fat_length - head_sectors);
+    free(fat);
+
+    // The bitmap records the metadata clusters as being in use.
+    uint8_t *bitmap = calloc(bitmap_clusters, bpc);
+    for (uint32_t i = 0; i < used; ++i) {
+        bitmap[i >> 3] |= (uint8_t)(1 << (i & 7));
+    }
+    device_write_sectors(dev,
+                         heap,
+                         bitmap_clusters * spc,
+                         bitmap);
+    free(bitmap);
+
+    uint8_t *table = calloc(upcase_clusters, bpc);
+    memcpy(table, upcase, upcase_bytes);
+    device_write_sectors(dev,
+                         heap + ((upcase_cluster - 2) * spc),
+                         upcase_clusters * spc,
+                         table);
+    uint32_t upcase_checksum = exfat_table_checksum(table, upcase_bytes);
+    free(table);
+
+    // Finally the root directory, which holds the label and describes where
+    // the bitmap and up-case table can be found.
+    union exfat_dir_entry *root = calloc(bpc, 1);
+    union exfat_dir_entry *slot = root;
+    uint16_t chars[EXFAT_NAME_MAX_LENGTH];
+    uint32_t label_len = label ? exfat_name_to_utf16(label, chars) : 0;
+    if (label_len > 0) {
+        slot->label.type = exfat_entry_label;
+        slot->label.length = (uint8_t)MIN(label_len, (uint32_t)11);
+        memcpy(slot->label.label, chars, slot->label.length * sizeof(*chars));
+        slot++;
+    }
+
+    slot->bitmap.type = exfat_entry_bitmap;
+    slot->bitmap.first_cluster = bitmap_cluster;
+    slot->bitmap.data_length = bitmap_bytes;
+    slot++;
+
+    slot->upcase.type = exfat_entry_upcase;
+    slot->upcase.checksum = upcase_checksum;
+    slot->upcase.first_cluster = upcase_cluster;
+    slot->upcase.data_length = upcase_bytes;
+
+    device_write_sectors(dev,
+                         heap + ((root_cluster - 2) * spc),
+                         spc,
+                         (uint8_t *)root);
+    free(root);
+}
+
+
+#pragma mark - exFAT File System
+
+static const char *exfat_name()
+{
+    return "exFAT";
+}
+
+uint8_t exfat_test(vdevice_t dev, struct exfat_boot_sector **boot_out)
+{
+    if (!dev || dev->sector_size < sizeof(struct exfat_boot_sector)) {
+        return 0;
+    }
+
+    // Check that the boot sector describes a volume that fits on the device,
+    // and that the boot region is intact.
+    exfat_boot_sector_t boot = (exfat_boot_sector_t)device_read_sector(dev, 0);
+    uint32_t bps_shift = boot->bytes_per_sector_shift;
+    uint32_t spc_shift = boot->sectors_per_cluster_shift;
+    uint64_t heap_end = (uint64_t)boot->cluster_heap_offset
+                      + ((uint64_t)boot->cluster_count << MIN(spc_shift, 32u));
+    uint64_t fats_end = (uint64_t)boot->fat_offset
+                      + ((uint64_t)boot->fat_length * boot->fat_count);
+    int valid = memcmp(boot->fs_name, EXFAT_FS_NAME, 8) == 0
+             && boot->boot_signature == EXFAT_BOOT_SIGNATURE
+             && bps_shift >= 9 && bps_shift <= 12
+             && ((uint32_t)1 << bps_shift) == dev->sector_size
+             && bps_shift + spc_shift <= 25
+             && (boot->fat_count == 1 || boot->fat_count == 2)
+             && boot->fat_offset >= EXFAT_RESERVED_SECTORS
+             && (uint64_t)boot->fat_length * (dev->sector_size / 4)
+                >= (uint64_t)boot->cluster_count + 2
+             && boot->cluster_heap_offset >= fats_end
+             && boot->cluster_count > 0
+             && boot->cluster_count <= EXFAT_MAX_CLUSTERS
+             && boot->root_cluster >= 2
+             && boot->root_cluster < boot->cluster_count + 2
+             && heap_end <= device_total_sectors(dev);
+
+    if (valid) {
+        uint8_t *region = device_read_sectors(dev,
+                                              0,
+                                              EXFAT_BOOT_REGION_SECTORS);
+        uint32_t checksum = exfat_boot_checksum(region, dev->sector_size);
+        uint32_t *sums = (uint32_t *)(region + ((EXFAT_BOOT_REGION_SECTORS - 1)
+                                                * dev->sector_size));
+        valid = sums[0] == checksum;
+        free(region);
+    }
+
+    if (!valid) {
+        free(boot);
+        return 0;
+    }
+
+    if (boot_out) {
+        *boot_out = boot;
+    }
+    else {
+        free(boot);
+    }
+    return 1;
+}
+
+static int exfat_load_metadata(vfs_t fs)
+{
+    exfat_t ex = fs->assoc_info;
+    uint32_t bps = exfat_bytes_per_sector(ex->boot);
+
+    // The bitmap and up-case table are described by entries in the root
+    // directory. Only the first bitmap is used, as there is one FAT.
+    struct exfat_bitmap_entry *bitmap = NULL;
+    struct exfat_upcase_entry *upcase = NULL;
+    for (uint32_t i = 0; i < ex->root->slot_count; ++i) {
+        union exfat_dir_entry *slot =
+            (union exfat_dir_entry *)(ex->root->data + (i * EXFAT_SLOT_SIZE));
+        if (slot->raw[0] == exfat_entry_bitmap && !bitmap) {
+            bitmap = &slot->bitmap;
+        }
+        else if (slot->raw[0] == exfat_entry_upcase && !upcase) {
+            upcase = &slot->upcase;
+        }
+    }
+
+    uint32_t clusters = ex->boot->cluster_count;
+    if (!bitmap || bitmap->data_length < (clusters + 7) / 8) {
+        fprintf(stderr, "The exFAT volume has no usable allocation bitmap.\n");
+        return 0;
+    }
+    if (!upcase) {
+        fprintf(stderr, "The exFAT volume has no up-case table.\n");
+        return 0;
+    }
+
+    // Count up the free clusters once, and keep the count up to date from
+    // then on.
+    ex->bitmap_extents = exfat_metadata_extents(fs,
+                                                bitmap->first_cluster,
+                                                bitmap->data_length);
+    if ((uint64_t)ex->bitmap_extents->sector_count * bps < (clusters + 7) / 8) {
+        fprintf(stderr, "The exFAT allocation bitmap is damaged.\n");
+        return 0;
+    }
+    ex->bitmap = exfat_read_extents(fs, ex->bitmap_extents);
+    ex->free_count = 0;
+    for (uint32_t cluster = 2; cluster < clusters + 2; ++cluster) {
+        ex->free_count += !exfat_bitmap_test(ex, cluster);
+    }
+    ex->next_free_cluster = 2;
+
+    // A damaged up-case table is replaced by the default one, so that names
+    // can at least be compared.
+    uint64_t length = MIN(upcase->data_length,
+                          (uint64_t)EXFAT_UPCASE_CHARS * sizeof(uint16_t));
+    vfs_extent_list_t extents = exfat_metadata_extents(fs,
+                                                       upcase->first_cluster,
+                                                       length);
+    uint8_t *data = exfat_read_extents(fs, extents);
+    uint64_t available = (uint64_t)extents->sector_count * bps;
+    if (available >= length
+        && exfat_table_checksum(data, length) == upcase->checksum) {
+        ex->upcase = exfat_expand_upcase((uint16_t *)data,
+                                         (uint32_t)(length / 2));
+    }
+    else {
+        fprintf(stderr, "The exFAT up-case table is damaged.\n");
+        uint16_t table[128];
+        ex->upcase = exfat_expand_upcase(table, exfat_default_upcase(table));
+    }
+    vfs_extent_list_destroy(extents);
+    free(data);
+    return 1;
+}
+
+static void *exfat_mount(vfs_t fs)
+{
+    exfat_boot_sector_t boot = NULL;
+    if (!exfat_test(fs->device, &boot)) {
+        return NULL;
+    }
+
+    // The volume needs to be reachable through the file system while it is
+    // being mounted.
+    exfat_t ex = calloc(1, sizeof(*ex));
+    ex->boot = boot;
+    ex->bytes_per_cluster = exfat_bytes_per_sector(boot)
+                          * exfat_sectors_per_cluster(boot);
+    ex->fat_sector = malloc(exfat_bytes_per_sector(boot));
+    ex->fat_sector_index = UINT32_MAX;
+    fs->assoc_info = ex;
+
+    // The root directory has no entry set of its own, and is measured by
+    // following its chain.
+    struct exfat_entry *root = &ex->root_entry;
+    root->first_cluster = boot->root_cluster;
+    root->needs_chain = 1;
+    uint32_t cluster = boot->root_cluster;
+    uint32_t count = 0;
+    while (exfat_is_valid_cluster(ex, cluster) && count < boot->cluster_count) {
+        count++;
+        cluster = exfat_next_cluster(fs, cluster);
+    }
+    root->data_length = (uint64_t)count * ex->bytes_per_cluster;
+    root->valid_data_length = root->data_length;
+
+    ex->root = exfat_load_directory(fs, root);
+    ex->current_dir = ex->root;
+    if (!exfat_load_metadata(fs)) {
+        exfat_unmount(fs);
+        return NULL;
+    }
+    return ex;
+}
+
+static void exfat_unmount(vfs_t fs)
+{
+    if (fs) {
+        exfat_t ex = fs->assoc_info;
+        if (ex) {
+            // Write back everything that is still pending before tearing
+            // down the in memory structures. A volume that failed to mount
+            // has nothing to write.
+            if (ex->bitmap && ex->upcase) {
+                exfat_sync(fs);
+            }
+
+            while (ex->directories) {
+                struct exfat_directory *dir = ex->directories;
+                ex->directories = dir->next;
+                exfat_destroy_directory(dir);
+            }
+            vfs_extent_list_destroy(ex->bitmap_extents);
+            free(ex->bitmap);
+            free(ex->upcase);
+            free(ex->fat_sector);
+            free(ex->boot);
+        }
+        free(fs->assoc_info);
+        fs->assoc_info = NULL;
+    }
+}
+
+
+#pragma mark - Working Directory
+
+static vfs_node_t exfat_current_directory(vfs_t fs)
+{
+    assert(fs);
+    exfat_t ex = fs->assoc_info;
+    if (ex->current_dir == ex->root) {
+        return NULL;
+    }
+
+    struct exfat_entry *entry = ex->current_dir->entry;
+    vfs_node_t node = entry->parent->nodes[entry->index];
+    return vfs_node_init(fs,
+                         node->name,
+                         node->attributes,
+                         vfs_node_used,
+                         entry);
+}
+
+static vfs_node_t exfat_get_directory_list(vfs_t fs)
+{
+    assert(fs);
+    exfat_t ex = fs->assoc_info;
+    return exfat_directory_list(ex->current_dir);
+}
+
+static vfs_node_t exfat_list_directory(vfs_t fs, vfs_node_t directory)
+{
+    assert(fs);
+    return exfat_directory_list(exfat_directory_for(fs, directory));
+}
+
+static void exfat_set_directory(vfs_t fs, vfs_node_t directory)
+{
+    assert(fs);
+    exfat_t ex = fs->assoc_info;
+    if (ex) {
+        ex->current_dir = exfat_directory_for(fs, directory);
+    }
+}
+
+
+#pragma mark - High Level File Support
+
+static vfs_node_t exfat_create_node(vfs_t fs,
+                                    struct exfat_directory *dir,
+                                    const char *name,
+                                    enum vfs_node_attributes attributes)
+{
+    exfat_t ex = fs->assoc_info;
+    if (!exfat_is_valid_name(name)) {
+        fprintf(stderr, "Could not create %s. It is not a valid name.\n", name);
+        return NULL;
+    }
+
+    uint16_t chars[EXFAT_NAME_MAX_LENGTH];
+    uint32_t len = exfat_name_to_utf16(name, chars);
+    uint32_t count = exfat_slot_count_for_name(len);
+    uint32_t index = exfat_directory_reserve(fs, dir, count);
+    if (index == SLOT_MAP_NONE) {
+        fprintf(stderr, "Could not create %s. The directory is full.\n", name);
+        return NULL;
+    }
+
+    struct exfat_entry *entry = arena_alloc(&dir->arena, sizeof(*entry));
+    entry->parent = dir;
+    entry->index = index;
+    entry->slot_count = count;
+    entry->attributes = exfat_translate_from_vfs_attributes(attributes);
+    entry->name_hash = exfat_name_hash(ex, chars, len);
+    entry->create_time = exfat_timestamp_from_posix(time(NULL));
+    entry->modify_time = entry->create_time;
+    entry->access_time = entry->create_time;
+
+    // A new directory gets a cluster of never used entries straight away.
+    if (attributes & vfs_node_directory_attribute) {
+        if (!exfat_resize_allocation(fs, entry, 1)) {
+            fprintf(stderr, "Could not create %s. The device is full.\n", name);
+            exfat_directory_release(dir, index, count);
+            return NULL;
+        }
+        entry->data_length = ex->bytes_per_cluster;
+        entry->valid_data_length = entry->data_length;
+        exfat_write_zeros(fs->device,
+                          exfat_cluster_sector(ex, entry->first_cluster),
+                          exfat_sectors_per_cluster(ex->boot));
+    }
+    else {
+        entry->attributes |= exfat_attribute_archive;
+    }
+
+    vfs_node_t node = exfat_construct_node(fs, &dir->arena, entry, name);
+    dir->nodes[index] = node;
+    name_index_insert(&dir->names, entry->name_hash, index);
+    exfat_directory_store(dir, entry);
+    return node;
+}
+
+static vfs_node_t exfat_get_file(vfs_t fs,
+                                 struct exfat_directory *dir,
+                                 const char *name,
+                                 uint8_t create_missing,
+                                 enum vfs_node_attributes attributes)
+{
+    uint32_t index = exfat_directory_lookup(fs, dir, name);
+    if (index != NAME_INDEX_NONE) {
+        return dir->nodes[index];
+    }
+    else if (!create_missing) {
+        return NULL;
+    }
+    return exfat_create_node(fs, dir, name, attributes);
+}
+
+static vfs_node_t exfat_get_node(vfs_t fs, const char *name)
+{
+    exfat_t ex = fs->assoc_info;
+    return exfat_get_file(fs, ex->current_dir, name, 0, 0);
+}
+
+static vfs_node_t exfat_lookup(vfs_t fs,
+                               vfs_node_t directory,
+                               const char *name)
+{
+    assert(fs);
+    assert(name);
+    return exfat_get_file(fs, exfat_directory_for(fs, directory), name, 0, 0);
+}
+
+static void exfat_create_file(vfs_t fs,
+                              const char *name,
+                              enum vfs_node_attributes a)
+{
+    exfat_t ex = fs->assoc_info;
+    exfat_get_file(fs, ex->current_dir, name, 1, a);
+}
+
+static vfs_node_t exfat_create_dir(vfs_t fs,
+                                   const char *name,
+                                   enum vfs_node_attributes a)
+{
+    exfat_t ex = fs->assoc_info;
+    return exfat_get_file(fs,
+                          ex->current_dir,
+                          name,
+                          1,
+                          a | vfs_node_directory_attribute);
+}
+
+static void exfat_remove_file(vfs_t fs, const char *name)
+{
+    exfat_t ex = fs->assoc_info;
+    struct exfat_directory *dir = ex->current_dir;
+
+    uint32_t index = exfat_directory_lookup(fs, dir, name);
+    if (index == NAME_INDEX_NONE) {
+        return;
+    }
+
+    // Directories have to be emptied before they can be removed, and must
+    // not linger in memory once they have been.
+    vfs_node_t node = dir->nodes[index];
+    struct exfat_entry *entry = node->assoc_info;
+    if (node->attributes & vfs_node_directory_attribute) {
+        struct exfat_directory *sub = exfat_directory_for(fs, node);
+        for (uint32_t i = 0; i < sub->slot_count; ++i) {
+            if (sub->nodes[i]) {
+                fprintf(stderr,
+                        "Could not remove %s. The directory is not empty.\n",
+                        name);
+                return;
+            }
+        }
+        exfat_drop_directory(fs, sub);
+    }
+
+    exfat_resize_allocation(fs, entry, 0);
+    exfat_directory_release(dir, index, entry->slot_count);
+    name_index_remove(&dir->names, entry->name_hash, index);
+    dir->nodes[index] = NULL;
+    node->next_sibling = NULL;
+    vfs_node_destroy(node);
+}
+
+static void exfat_rename(vfs_t fs, const char *old, const char *name)
+{
+    exfat_t ex = fs->assoc_info;
+    struct exfat_directory *dir = ex->current_dir;
+
+    // Find the entry being renamed, and make sure the new name is not
+    // already taken by another entry. Only the case of the name may change.
+    uint32_t index = exfat_directory_lookup(fs, dir, old);
+    if (index == NAME_INDEX_NONE) {
+        fprintf(stderr, "Could not find %s to rename.\n", old);
+        return;
+    }
+
+    uint32_t existing = exfat_directory_lookup(fs, dir, name);
+    if (existing != NAME_INDEX_NONE && existing != index) {
+        fprintf(stderr, "Could not rename %s. %s already exists.\n", old, name);
+        return;
+    }
+
+    if (!exfat_is_valid_name(name)) {
+        fprintf(stderr, "Could not rename %s. %s is not a valid name.\n",
+                old, name);
+        return;
+    }
+
+    // A set that needs a different number of name entries moves to a new
+    // run of slots, which is claimed before the old one is given up.
+    uint16_t chars[EXFAT_NAME_MAX_LENGTH];
+    uint32_t len = exfat_name_to_utf16(name, chars);
+    uint32_t count = exfat_slot_count_for_name(len);
+    vfs_node_t node = dir->nodes[index];
+    struct exfat_entry *entry = node->assoc_info;
+    uint32_t new_index = index;
+    if (count != entry->slot_count) {
+        new_index = exfat_directory_reserve(fs, dir, count);
+        if (new_index == SLOT_MAP_NONE) {
+            fprintf(stderr, "Could not rename %s. The directory is full.\n",
+                    old);
+            return;
+        }
+        exfat_directory_release(dir, index, entry->slot_count);
+        dir->nodes[index] = NULL;
+        dir->nodes[new_index] = node;
+    }
+
+    name_index_remove(&dir->names, entry->name_hash, index);
+    entry->index = new_index;
+    entry->slot_count = count;
+    entry->name_hash = exfat_name_hash(ex, chars, len);
+    name_index_insert(&dir->names, entry->name_hash, new_index);
+
+    vfs_node_set_name(node, name);
+    exfat_directory_store(dir, entry);
+}
+
+
+#pragma mark - File Data
+
+static uint32_t exfat_file_transfer(vfs_t fs,
+                                    vfs_node_t node,
+                                    uint8_t *data,
+                                    uint32_t n,
+                                    uint32_t offset,
+                                    uint8_t write)
+{
+    exfat_t ex = fs->assoc_info;
+    uint32_t bps = exfat_bytes_per_sector(ex->boot);
+    uint8_t *sector_buffer = NULL;
+
+    // Each extent is a contiguous run of sectors, so whole sectors of data
+    // are transferred directly. Partial sectors go through a buffer.
+    uint32_t done = 0;
+    struct vfs_extent_iterator it;
+    const struct vfs_extent *extent;
+    vfs_extent_iterator_init(&it, exfat_node_extents(fs, node));
+    while (done < n && (extent = vfs_extent_iterator_next(&it))) {
+        uint64_t extent_start = (uint64_t)extent->offset * bps;
+        uint64_t extent_end = extent_start + ((uint64_t)extent->length * bps);
+        uint64_t position = (uint64_t)offset + done;
+
+        while (done < n && position < extent_end) {
+            if (position < extent_start) {
+                break;
+            }
+
+            uint32_t within = (uint32_t)(position - extent_start);
+            uint32_t sector = extent->start + (within / bps);
+            uint32_t sector_offset = within % bps;
+            uint32_t remaining = (uint32_t)MIN((uint64_t)(n - done),
+                                               extent_end - position);
+
+            if (sector_offset == 0 && remaining >= bps) {
+                uint32_t count = remaining / bps;
+                if (write) {
+                    device_write_sectors(fs->device,
+                                         sector,
+                                         count,
+                                         data + done);
+                }
+                else {
+                    device_read_sectors_into(fs->device,
+                                             sector,
+                                             count,
+                                             data + done);
+                }
+                done += count * bps;
+            }
+            else {
+                uint32_t len = MIN(bps - sector_offset, remaining);
+                if (!sector_buffer) {
+                    sector_buffer = malloc(bps);
+                }
+
+                device_read_sectors_into(fs->device, sector, 1, sector_buffer);
+                if (write) {
+                    memcpy(sector_buffer + sector_offset, data + done, len);
+                    device_write_sectors(fs->device, sector, 1, sector_buffer);
+                }
+                else {
+                    memcpy(data + done, sector_buffer + sector_offset, len);
+                }
+                done += len;
+            }
+            position = (uint64_t)offset + done;
+        }
+    }
+
+    free(sector_buffer);
+    return done;
+}
+
+static int exfat_file_resize(vfs_t fs, vfs_node_t node, uint32_t size)
+{
+    exfat_t ex = fs->assoc_info;
+    struct exfat_entry *entry = node->assoc_info;
+
+    if (!exfat_resize_allocation(fs,
+                                 entry,
+                                 exfat_cluster_count_for_size(ex, size))) {
+        fprintf(stderr,
+                "Could not resize %s. There is not enough free space.\n",
+                node->name);
+        return 0;
+    }
+
+    // Growing the file leaves the valid data length where it is, so the
+    // new space reads back as zeros without anything being written to it.
+    entry->data_length = size;
+    entry->valid_data_length = MIN(entry->valid_data_length, (uint64_t)size);
+    exfat_discard_node_extents(node);
+    node->size = size;
+    node->is_dirty = 1;
+    entry->parent->is_dirty = 1;
+    vfs_node_update_modification_time(node);
+    return 1;
+}
+
+static void exfat_file_extend_valid_data(vfs_t fs,
+                                         vfs_node_t node,
+                                         uint32_t offset)
+{
+    // The clusters beyond the valid data length may hold anything, so before
+    // data is written past it the gap is filled in with zeros.
+    exfat_t ex = fs->assoc_info;
+    struct exfat_entry *entry = node->assoc_info;
+    if (offset <= entry->valid_data_length) {
+        return;
+    }
+
+    uint8_t *zeros = calloc(ex->bytes_per_cluster, sizeof(*zeros));
+    uint32_t position = (uint32_t)entry->valid_data_length;
+    while (position < offset) {
+        uint32_t len = MIN(ex->bytes_per_cluster, offset - position);
+        exfat_file_transfer(fs, node, zeros, len, position, 1);
+        position += len;
+    }
+    free(zeros);
+    entry->valid_data_length = offset;
+}
+
+static uint32_t exfat_file_read_valid_data(vfs_t fs,
+                                           vfs_node_t node,
+                                           uint8_t *data,
+                                           uint32_t n,
+                                           uint32_t offset)
+{
+    // Only the valid data is read from the device. Whatever follows it reads
+    // back as zeros, regardless of what the clusters hold.
+    struct exfat_entry *entry = node->assoc_info;
+    uint32_t valid = 0;
+    if (entry->valid_data_length > offset) {
+        valid = (uint32_t)MIN((uint64_t)n, entry->valid_data_length - offset);
+    }
+
+    uint32_t done = exfat_file_transfer(fs, node, data, valid, offset, 0);
+    if (done < valid) {
+        return done;
+    }
+    memset(data + valid, 0, n - valid);
+    return n;
+}
+
+static void exfat_file_write(vfs_t fs,
+                             const char *name,
+                             void *data,
+                             uint32_t n)
+{
+    assert(fs);
+
+    exfat_t ex = fs->assoc_info;
+    vfs_node_t node = exfat_get_file(fs, ex->current_dir, name, 1, 0);
+    if (!node) {
+        fprintf(stderr, "Could not write file. File could not be created!\n");
+        return;
+    }
+    else if (node->attributes & vfs_node_directory_attribute) {
+        fprintf(stderr, "Could not write %s. It is a directory.\n", name);
+        return;
+    }
+
+    // The whole of the file is replaced, so nothing needs zeroing.
+    if (exfat_file_resize(fs, node, n)) {
+        struct exfat_entry *entry = node->assoc_info;
+        vfs_node_update_access_time(node);
+        entry->valid_data_length = exfat_file_transfer(fs, node, data, n, 0, 1);
+    }
+}
+
+static uint32_t exfat_file_read(vfs_t fs, const char *name, void **data)
+{
+    assert(fs);
+    assert(data);
+
+    // Get the file in question. If we can't find it then ensure data out is
+    // NULL and return 0.
+    exfat_t ex = fs->assoc_info;
+    vfs_node_t node = exfat_get_file(fs, ex->current_dir, name, 0, 0);
+    if (!node) {
+        *data = NULL;
+        return 0;
+    }
+
+    *data = calloc(node->size, sizeof(uint8_t));
+    return exfat_file_read_valid_data(fs, node, *data, node->size, 0);
+}
+
+
+#pragma mark - Streaming File Access
+
+static vfs_file_t exfat_open(vfs_t fs,
+                             vfs_node_t directory,
+                             const char *name,
+                             uint8_t create)
+{
+    assert(fs);
+    assert(name);
+
+    // Find the file, creating it if requested. Directories can not be opened.
+    struct exfat_directory *dir = exfat_directory_for(fs, directory);
+    vfs_node_t node = exfat_get_file(fs, dir, name, create, 0);
+    if (!node || (node->attributes & vfs_node_directory_attribute)) {
+        return NULL;
+    }
+
+    // Directories stay resident while the volume is mounted, so the node
+    // remains valid for as long as the file is open.
+    struct exfat_file *info = calloc(1, sizeof(*info));
+    info->dir = dir;
+    return vfs_file_init(fs, node, info);
+}
+
+static uint32_t exfat_pread(vfs_t fs,
+                            vfs_file_t file,
+                            void *data,
+                            uint32_t n,
+                            uint32_t offset)
+{
+    assert(fs);
+    assert(file);
+
+    vfs_node_t node = file->node;
+    if (offset >= node->size) {
+        return 0;
+    }
+
+    n = MIN(n, node->size - offset);
+    return exfat_file_read_valid_data(fs, node, data, n, offset);
+}
+
+static uint32_t exfat_pwrite(vfs_t fs,
+                             vfs_file_t file,
+                             const void *data,
+                             uint32_t n,
+                             uint32_t offset)
+{
+    assert(fs);
+    assert(file);
+
+    vfs_node_t node = file->node;
+    struct exfat_file *info = file->assoc_info;
+    if (n == 0) {
+        return 0;
+    }
+
+    // Make sure the file is large enough to hold the data before writing.
+    uint32_t end = offset + n;
+    if (end < offset) {
+        fprintf(stderr, "Could not write beyond the maximum size of a file.\n");
+        return 0;
+    }
+    else if (end > node->size) {
+        if (!exfat_file_resize(fs, node, end)) {
+            return 0;
+        }
+    }
+    else {
+        node->is_dirty = 1;
+        info->dir->is_dirty = 1;
+        vfs_node_update_modification_time(node);
+    }
+
+    // The valid data length only moves forward once data has actually been
+    // written beyond it.
+    struct exfat_entry *entry = node->assoc_info;
+    exfat_file_extend_valid_data(fs, node, offset);
+    uint32_t done = exfat_file_transfer(fs,
+                                        node,
+                                        (uint8_t *)data,
+                                        n,
+                                        offset,
+                                        1);
+    entry->valid_data_length = MAX(entry->valid_data_length,
+                                   (uint64_t)offset + done);
+    return done;
+}
+
+static int exfat_truncate(vfs_t fs, vfs_file_t file, uint32_t size)
+{
+    assert(fs);
+    assert(file);
+    return exfat_file_resize(fs, file->node, size);
+}
+
+static void exfat_close(vfs_t fs, vfs_file_t file)
+{
+    assert(fs);
+    assert(file);
+
+    // Metadata changes made through the file are written back along with
+    // everything else when the filesystem is next synced.
+    free(file->assoc_info);
+    file->assoc_info = NULL;
+}
+
+
+#pragma mark - Metadata Flushing
+
+static void exfat_flush(vfs_t fs)
+{
+    exfat_t ex = fs->assoc_info;
+    exfat_flush_fat(fs);
+    exfat_flush_bitmap(fs);
+    exfat_flush_directory(fs, ex->current_dir);
+}
+
+static void exfat_sync(vfs_t fs)
+{
+    assert(fs);
+    exfat_t ex = fs->assoc_info;
+
+    // Only write back the structures that have actually been modified since
+    // they were last written to the device. The FAT and bitmap go first, so
+    // that no entry set ever refers to clusters that are not yet allocated.
+    exfat_flush_fat(fs);
+    exfat_flush_bitmap(fs);
+
+    struct exfat_directory *dir = ex->directories;
+    while (dir) {
+        if (dir->is_dirty) {
+            exfat_flush_directory(fs, dir);
+        }
+        dir = dir->next;
+    }
+
+    // The percentage in use is left out of the boot checksum, so it can be
+    // brought up to date in place.
+    uint32_t clusters = ex->boot->cluster_count;
+    uint8_t percent = (uint8_t)(((uint64_t)(clusters - ex->free_count) * 100)
+                                / clusters);
+    if (percent != ex->boot->percent_in_use) {
+        ex->boot->percent_in_use = percent;
+        device_write_sector(fs->device, 0, (uint8_t *)ex->boot);
+    }
+}
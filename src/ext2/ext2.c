@@ -0,0 +1,2883 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ext2/ext2.h>
+
+#include <vfs/vfs.h>
+#include <vfs/node.h>
+#include <vfs/extent.h>
+#include <vfs/file.h>
+
+
+#ifdef MAX
+#   undef MAX
+#endif
+
+#define MAX(a,b) \
+    ({ __typeof__ (a) _a = (a); \
+       __typeof__ (b) _b = (b); \
+       _a > _b ? _a : _b; })
+
+#ifdef MIN
+#   undef MIN
+#endif
+
+#define MIN(a,b) \
+    ({ __typeof__ (a) _a = (a); \
+       __typeof__ (b) _b = (b); \
+       _a < _b ? _a : _b; })
+
+
+#pragma mark - ext2 Constants
+
+// Block sizes beyond 32K can not be described by the record length of a
+// directory entry, and are not supported.
+#define EXT2_MIN_BLOCK_SIZE  1024
+#define EXT2_MAX_BLOCK_SIZE  (32 * 1024)
+
+// Volumes up to 512MB are formatted with 1K blocks and an inode for every
+// 4K, and larger ones with 4K blocks and an inode for every 16K.
+#define EXT2_SMALL_VOLUME_BYTES  ((uint64_t)512 * 1024 * 1024)
+#define EXT2_SMALL_INODE_RATIO  4096
+#define EXT2_INODE_RATIO  16384
+
+// A trailing block group is dropped from a new volume when it would not
+// have room for at least this many blocks of data.
+#define EXT2_MIN_GROUP_DATA_BLOCKS  50
+#define EXT2_RESERVED_PERCENT  5
+
+// The inode of the lost+found directory created by formatting.
+#define EXT2_LOST_AND_FOUND_INO  11
+
+// Room in a directory arena for a node, its entry and its name, allowing for
+// each of them to be rounded up by the arena.
+#define EXT2_ARENA_BYTES_PER_ENTRY \
+    (sizeof(struct vfs_node) + sizeof(struct ext2_entry) + 64)
+
+#define EXT2_MIN_INODE_CAPACITY  256
+
+
+#pragma mark - VFS Interface (Prototypes)
+
+static const char *ext2_name();
+
+static void *ext2_mount(vfs_t fs);
+static void ext2_unmount(vfs_t fs);
+
+static void ext2_format_device(
+    vdevice_t dev,
+    const char *label,
+    uint8_t *bootcode,
+    uint8_t *reserved_data,
+    uint16_t additional_reserved_sectors
+);
+
+static vfs_node_t ext2_current_directory(vfs_t fs);
+static vfs_node_t ext2_get_directory_list(vfs_t fs);
+static vfs_node_t ext2_list_directory(vfs_t fs, vfs_node_t directory);
+static void ext2_set_directory(vfs_t fs, vfs_node_t directory);
+
+static vfs_node_t ext2_get_node(vfs_t fs, const char *name);
+static vfs_node_t ext2_lookup(vfs_t fs,
+                              vfs_node_t directory,
+                              const char *name);
+
+static void ext2_file_write(vfs_t fs,
+                            const char *name,
+                            void *data,
+                            uint32_t n);
+static uint32_t ext2_file_read(vfs_t fs, const char *name, void **data);
+static vfs_extent_list_t ext2_node_extents(vfs_t fs, vfs_node_t node);
+
+static vfs_file_t ext2_open(vfs_t fs,
+                            vfs_node_t directory,
+                            const char *name,
+                            uint8_t create);
+static uint32_t ext2_pread(vfs_t fs,
+                           vfs_file_t file,
+                           void *data,
+                           uint32_t n,
+                           uint32_t offset);
+static uint32_t ext2_pwrite(vfs_t fs,
+                            vfs_file_t file,
+                            const void *data,
+                            uint32_t n,
+                            uint32_t offset);
+static int ext2_truncate(vfs_t fs, vfs_file_t file, uint32_t size);
+static void ext2_close(vfs_t fs, vfs_file_t file);
+
+static void ext2_create_file(vfs_t, const char *, enum vfs_node_attributes);
+static vfs_node_t ext2_create_dir(vfs_t fs,
+                                  const char *name,
+                                  enum vfs_node_attributes a);
+
+static void ext2_remove_file(vfs_t fs, const char *name);
+static void ext2_rename(vfs_t fs, const char *old, const char *name);
+
+static void ext2_flush(vfs_t fs);
+static void ext2_sync(vfs_t fs);
+
+
+#pragma mark - VFS Interface Creation
+
+vfs_interface_t ext2_init()
+{
+    vfs_interface_t fs = vfs_interface_init();
+
+    fs->type_name = ext2_name;
+
+    fs->mount_filesystem = ext2_mount;
+    fs->unmount_filesystem = ext2_unmount;
+
+    // Images can not yet be built in a single pass, so only formatting is
+    // offered.
+    fs->format_device = ext2_format_device;
+
+    fs->current_directory = ext2_current_directory;
+    fs->get_directory_list = ext2_get_directory_list;
+    fs->list_directory = ext2_list_directory;
+    fs->set_directory = ext2_set_directory;
+    fs->get_node = ext2_get_node;
+    fs->lookup = ext2_lookup;
+
+    fs->write = ext2_file_write;
+    fs->read = ext2_file_read;
+    fs->extents = ext2_node_extents;
+
+    fs->open = ext2_open;
+    fs->pread = ext2_pread;
+    fs->pwrite = ext2_pwrite;
+    fs->truncate = ext2_truncate;
+    fs->close = ext2_close;
+
+    fs->create_file = ext2_create_file;
+    fs->create_dir = ext2_create_dir;
+
+    fs->remove = ext2_remove_file;
+    fs->rename = ext2_rename;
+
+    fs->flush_directory = ext2_flush;
+    fs->sync = ext2_sync;
+
+    return fs;
+}
+
+
+#pragma mark - ext2 Calculations
+
+static uint32_t ext2_block_sector(ext2_t e, uint32_t block)
+{
+    return block * e->sectors_per_block;
+}
+
+static uint32_t ext2_pointers_per_block(ext2_t e)
+{
+    return e->block_size / sizeof(uint32_t);
+}
+
+static uint32_t ext2_group_of_block(ext2_t e, uint32_t block)
+{
+    return (block - e->superblock->first_data_block)
+         / e->superblock->blocks_per_group;
+}
+
+static uint32_t ext2_group_first_block(ext2_t e, uint32_t group)
+{
+    return e->superblock->first_data_block
+         + (group * e->superblock->blocks_per_group);
+}
+
+static uint32_t ext2_blocks_in_group(ext2_t e, uint32_t group)
+{
+    // Only the last group can be short.
+    uint32_t first = ext2_group_first_block(e, group);
+    return MIN(e->superblock->blocks_per_group,
+               e->superblock->blocks_count - first);
+}
+
+static uint32_t ext2_group_of_inode(ext2_t e, uint32_t number)
+{
+    return (number - 1) / e->superblock->inodes_per_group;
+}
+
+static uint32_t ext2_blocks_for_size(ext2_t e, uint32_t size)
+{
+    return (uint32_t)(((uint64_t)size + e->block_size - 1) / e->block_size);
+}
+
+static uint32_t ext2_sectors_per_block_count(ext2_t e)
+{
+    // The block count of an inode is kept in 512 byte units, whatever the
+    // sector size of the device.
+    return e->block_size / 512;
+}
+
+static int ext2_is_valid_block(ext2_t e, uint32_t block)
+{
+    return block >= e->superblock->first_data_block
+        && block < e->superblock->blocks_count;
+}
+
+static int ext2_is_valid_inode(ext2_t e, uint32_t number)
+{
+    return number >= 1 && number <= e->superblock->inodes_count;
+}
+
+static int ext2_is_power_of(uint32_t n, uint32_t base)
+{
+    while (n > 1 && n % base == 0) {
+        n /= base;
+    }
+    return n == 1;
+}
+
+static int ext2_group_has_superblock(const struct ext2_superblock *sb,
+                                     uint32_t group)
+{
+    // With sparse superblocks, copies are only kept in groups 0 and 1, and
+    // those that are a power of 3, 5 or 7.
+    if (!(sb->feature_ro_compat & EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER)) {
+        return 1;
+    }
+    return group <= 1
+        || ext2_is_power_of(group, 3)
+        || ext2_is_power_of(group, 5)
+        || ext2_is_power_of(group, 7);
+}
+
+static uint32_t ext2_rec_size(uint32_t name_len)
+{
+    return (EXT2_DIR_ENTRY_HEADER + name_len + 3) & ~(uint32_t)3;
+}
+
+static int ext2_is_directory(const struct ext2_inode *inode)
+{
+    return (inode->mode & ext2_mode_type_mask) == ext2_mode_directory;
+}
+
+static int ext2_is_regular(const struct ext2_inode *inode)
+{
+    return (inode->mode & ext2_mode_type_mask) == ext2_mode_regular;
+}
+
+static int ext2_is_inline_symlink(ext2_t e, const struct ext2_inode *inode)
+{
+    // Short symbolic links keep their target in the block map itself.
+    uint32_t acl_blocks = inode->file_acl ? ext2_sectors_per_block_count(e) : 0;
+    return (inode->mode & ext2_mode_type_mask) == ext2_mode_symlink
+        && inode->size < sizeof(inode->block)
+        && inode->blocks == acl_blocks;
+}
+
+static uint8_t ext2_file_type_for_mode(uint16_t mode)
+{
+    switch (mode & ext2_mode_type_mask) {
+        case ext2_mode_regular: return ext2_file_type_regular;
+        case ext2_mode_directory: return ext2_file_type_directory;
+        case ext2_mode_char_device: return ext2_file_type_char_device;
+        case ext2_mode_block_device: return ext2_file_type_block_device;
+        case ext2_mode_fifo: return ext2_file_type_fifo;
+        case ext2_mode_socket: return ext2_file_type_socket;
+        case ext2_mode_symlink: return ext2_file_type_symlink;
+        default: return ext2_file_type_unknown;
+    }
+}
+
+static uint16_t ext2_mode_from_vfs_attributes(enum vfs_node_attributes a)
+{
+    // New files belong to root, and can be read by anyone.
+    if (a & vfs_node_directory_attribute) {
+        return ext2_mode_directory
+             | ((a & vfs_node_read_only_attribute) ? 0555 : 0755);
+    }
+    return ext2_mode_regular
+         | ((a & vfs_node_read_only_attribute) ? 0444 : 0644);
+}
+
+static enum vfs_node_attributes ext2_translate_to_vfs_attributes(
+    const struct ext2_inode *inode,
+    const char *name
+) {
+    enum vfs_node_attributes a = 0;
+    if (ext2_is_directory(inode)) {
+        a |= vfs_node_directory_attribute;
+    }
+    else if (!ext2_is_regular(inode)) {
+        a |= vfs_node_system_attribute;
+    }
+    if (!(inode->mode & ext2_mode_write_bits)) {
+        a |= vfs_node_read_only_attribute;
+    }
+    if (name[0] == '.') {
+        a |= vfs_node_hidden_attribute;
+    }
+    return a;
+}
+
+
+#pragma mark - Device Access
+
+static void ext2_read_bytes(vdevice_t dev,
+                            uint64_t offset,
+                            uint32_t n,
+                            void *data)
+{
+    // Reads that are not aligned to sectors go through a buffer covering all
+    // of the sectors involved.
+    uint32_t bps = dev->sector_size;
+    uint32_t first = (uint32_t)(offset / bps);
+    uint32_t count = (uint32_t)(((offset % bps) + n + bps - 1) / bps);
+    uint8_t *buffer = malloc((size_t)count * bps);
+    device_read_sectors_into(dev, first, count, buffer);
+    memcpy(data, buffer + (offset % bps), n);
+    free(buffer);
+}
+
+static void ext2_write_bytes(vdevice_t dev,
+                             uint64_t offset,
+                             uint32_t n,
+                             const void *data)
+{
+    uint32_t bps = dev->sector_size;
+    uint32_t first = (uint32_t)(offset / bps);
+    uint32_t count = (uint32_t)(((offset % bps) + n + bps - 1) / bps);
+    uint8_t *buffer = malloc((size_t)count * bps);
+    device_read_sectors_into(dev, first, count, buffer);
+    memcpy(buffer + (offset % bps), data, n);
+    device_write_sectors(dev, first, count, buffer);
+    free(buffer);
+}
+
+static void ext2_write_zeros(vdevice_t dev, uint32_t sector, uint32_t count)
+{
+    uint32_t chunk = 128;
+    uint8_t *zeros = calloc(chunk, dev->sector_size);
+    while (count > 0) {
+        uint32_t n = MIN(chunk, count);
+        device_write_sectors(dev, sector, n, zeros);
+        sector += n;
+        count -= n;
+    }
+    free(zeros);
+}
+
+static void ext2_read_block(vfs_t fs, uint32_t block, uint8_t *data)
+{
+    ext2_t e = fs->assoc_info;
+    device_read_sectors_into(fs->device,
+                             ext2_block_sector(e, block),
+                             e->sectors_per_block,
+                             data);
+}
+
+static void ext2_write_block(vfs_t fs, uint32_t block, uint8_t *data)
+{
+    ext2_t e = fs->assoc_info;
+    device_write_sectors(fs->device,
+                         ext2_block_sector(e, block),
+                         e->sectors_per_block,
+                         data);
+}
+
+
+#pragma mark - Metadata Block Cache
+
+// Inode tables and indirect blocks are accessed through a handful of cached
+// blocks, which are replaced in turn. A cached block is only valid until the
+// next block is fetched through the cache.
+
+static void ext2_cache_write_back(vfs_t fs, struct ext2_cached_block *cached)
+{
+    if (cached->data && cached->is_dirty) {
+        ext2_write_block(fs, cached->number, cached->data);
+        cached->is_dirty = 0;
+    }
+}
+
+static struct ext2_cached_block *ext2_cache_get(vfs_t fs,
+                                                uint32_t block,
+                                                uint8_t read)
+{
+    ext2_t e = fs->assoc_info;
+    for (uint32_t i = 0; i < EXT2_CACHED_BLOCKS; ++i) {
+        struct ext2_cached_block *cached = &e->cache[i];
+        if (cached->data && cached->number == block) {
+            if (!read) {
+                memset(cached->data, 0, e->block_size);
+            }
+            return cached;
+        }
+    }
+
+    struct ext2_cached_block *cached = &e->cache[e->cache_victim];
+    e->cache_victim = (e->cache_victim + 1) % EXT2_CACHED_BLOCKS;
+    ext2_cache_write_back(fs, cached);
+    if (!cached->data) {
+        cached->data = malloc(e->block_size);
+    }
+
+    cached->number = block;
+    if (read) {
+        ext2_read_block(fs, block, cached->data);
+    }
+    else {
+        memset(cached->data, 0, e->block_size);
+    }
+    return cached;
+}
+
+static void ext2_cache_forget(vfs_t fs, uint32_t block)
+{
+    // A block that has been released must not be written back over whatever
+    // it is reused for.
+    ext2_t e = fs->assoc_info;
+    for (uint32_t i = 0; i < EXT2_CACHED_BLOCKS; ++i) {
+        struct ext2_cached_block *cached = &e->cache[i];
+        if (cached->data && cached->number == block) {
+            free(cached->data);
+            cached->data = NULL;
+            cached->is_dirty = 0;
+        }
+    }
+}
+
+static void ext2_cache_flush(vfs_t fs)
+{
+    ext2_t e = fs->assoc_info;
+    for (uint32_t i = 0; i < EXT2_CACHED_BLOCKS; ++i) {
+        ext2_cache_write_back(fs, &e->cache[i]);
+    }
+}
+
+
+#pragma mark - Inodes
+
+static uint32_t ext2_inode_bucket(ext2_t e, uint32_t number)
+{
+    return (number * 2654435761u) & (e->inode_capacity - 1);
+}
+
+static void ext2_inode_locate(ext2_t e,
+                              uint32_t number,
+                              uint32_t *block,
+                              uint32_t *offset)
+{
+    uint32_t group = ext2_group_of_inode(e, number);
+    uint32_t index = (number - 1) % e->superblock->inodes_per_group;
+    uint64_t byte = (uint64_t)index * e->inode_size;
+    *block = e->descriptors[group].inode_table
+           + (uint32_t)(byte / e->block_size);
+    *offset = (uint32_t)(byte % e->block_size);
+}
+
+static struct ext2_inode_info *ext2_inode_find(ext2_t e, uint32_t number)
+{
+    struct ext2_inode_info *info = e->inodes[ext2_inode_bucket(e, number)];
+    while (info && info->number != number) {
+        info = info->next;
+    }
+    return info;
+}
+
+static void ext2_inode_insert(ext2_t e, struct ext2_inode_info *info)
+{
+    // The table is kept at no more than two inodes to a bucket.
+    if (e->inode_count >= e->inode_capacity * 2) {
+        uint32_t old_capacity = e->inode_capacity;
+        struct ext2_inode_info **old = e->inodes;
+        e->inode_capacity *= 2;
+        e->inodes = calloc(e->inode_capacity, sizeof(*e->inodes));
+        for (uint32_t i = 0; i < old_capacity; ++i) {
+            struct ext2_inode_info *chain = old[i];
+            while (chain) {
+                struct ext2_inode_info *next = chain->next;
+                uint32_t bucket = ext2_inode_bucket(e, chain->number);
+                chain->next = e->inodes[bucket];
+                e->inodes[bucket] = chain;
+                chain = next;
+            }
+        }
+        free(old);
+    }
+
+    uint32_t bucket = ext2_inode_bucket(e, info->number);
+    info->next = e->inodes[bucket];
+    e->inodes[bucket] = info;
+    e->inode_count++;
+}
+
+static struct ext2_inode_info *ext2_inode_get(vfs_t fs, uint32_t number)
+{
+    ext2_t e = fs->assoc_info;
+    struct ext2_inode_info *info = ext2_inode_find(e, number);
+    if (info) {
+        return info;
+    }
+
+    uint32_t block = 0;
+    uint32_t offset = 0;
+    ext2_inode_locate(e, number, &block, &offset);
+    struct ext2_cached_block *cached = ext2_cache_get(fs, block, 1);
+
+    info = arena_alloc(&e->inode_arena, sizeof(*info));
+    memset(info, 0, sizeof(*info));
+    info->number = number;
+    memcpy(&info->disk, cached->data + offset, sizeof(info->disk));
+    ext2_inode_insert(e, info);
+    return info;
+}
+
+static struct ext2_inode_info *ext2_inode_new(vfs_t fs, uint32_t number)
+{
+    // An inode number that is being reused may still have the inode that
+    // previously had it in memory.
+    ext2_t e = fs->assoc_info;
+    struct ext2_inode_info *info = ext2_inode_find(e, number);
+    if (!info) {
+        info = arena_alloc(&e->inode_arena, sizeof(*info));
+        memset(info, 0, sizeof(*info));
+        info->number = number;
+        ext2_inode_insert(e, info);
+    }
+
+    memset(&info->disk, 0, sizeof(info->disk));
+    info->is_new = 1;
+    info->is_dirty = 1;
+    return info;
+}
+
+static void ext2_inode_store(vfs_t fs, struct ext2_inode_info *info)
+{
+    ext2_t e = fs->assoc_info;
+    uint32_t block = 0;
+    uint32_t offset = 0;
+    ext2_inode_locate(e, info->number, &block, &offset);
+
+    // Inode tables are not initialised when the volume is formatted, so a
+    // new inode is written out in full, including any space beyond the part
+    // the driver knows about.
+    struct ext2_cached_block *cached = ext2_cache_get(fs, block, 1);
+    if (info->is_new) {
+        memset(cached->data + offset, 0, e->inode_size);
+    }
+    memcpy(cached->data + offset, &info->disk, sizeof(info->disk));
+    cached->is_dirty = 1;
+    info->is_dirty = 0;
+    info->is_new = 0;
+}
+
+static void ext2_flush_inodes(vfs_t fs)
+{
+    ext2_t e = fs->assoc_info;
+    for (uint32_t i = 0; i < e->inode_capacity; ++i) {
+        struct ext2_inode_info *info = e->inodes[i];
+        while (info) {
+            if (info->is_dirty) {
+                ext2_inode_store(fs, info);
+            }
+            info = info->next;
+        }
+    }
+    ext2_cache_flush(fs);
+}
+
+
+#pragma mark - Bitmaps
+
+static int ext2_bit_test(const uint8_t *bitmap, uint32_t bit)
+{
+    return (bitmap[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static void ext2_bit_set(uint8_t *bitmap, uint32_t bit)
+{
+    bitmap[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+}
+
+static void ext2_bit_clear(uint8_t *bitmap, uint32_t bit)
+{
+    bitmap[bit >> 3] &= (uint8_t)~(1 << (bit & 7));
+}
+
+static uint32_t ext2_bit_find_clear(const uint8_t *bitmap,
+                                    uint32_t from,
+                                    uint32_t limit)
+{
+    // Whole bytes that are full are skipped over without looking at their
+    // bits.
+    uint32_t bit = from;
+    while (bit < limit) {
+        if ((bit & 7) == 0 && bitmap[bit >> 3] == 0xFF) {
+            bit += 8;
+            continue;
+        }
+        if (!ext2_bit_test(bitmap, bit)) {
+            return bit;
+        }
+        bit++;
+    }
+    return UINT32_MAX;
+}
+
+static uint8_t *ext2_block_bitmap(vfs_t fs, uint32_t group)
+{
+    ext2_t e = fs->assoc_info;
+    struct ext2_group *g = &e->groups[group];
+    if (!g->block_bitmap) {
+        g->block_bitmap = malloc(e->block_size);
+        ext2_read_block(fs,
+                        e->descriptors[group].block_bitmap,
+                        g->block_bitmap);
+    }
+    return g->block_bitmap;
+}
+
+static uint8_t *ext2_inode_bitmap(vfs_t fs, uint32_t group)
+{
+    ext2_t e = fs->assoc_info;
+    struct ext2_group *g = &e->groups[group];
+    if (!g->inode_bitmap) {
+        g->inode_bitmap = malloc(e->block_size);
+        ext2_read_block(fs,
+                        e->descriptors[group].inode_bitmap,
+                        g->inode_bitmap);
+    }
+    return g->inode_bitmap;
+}
+
+static void ext2_flush_bitmaps(vfs_t fs)
+{
+    ext2_t e = fs->assoc_info;
+    for (uint32_t i = 0; i < e->group_count; ++i) {
+        struct ext2_group *g = &e->groups[i];
+        if (g->block_bitmap_dirty) {
+            ext2_write_block(fs,
+                             e->descriptors[i].block_bitmap,
+                             g->block_bitmap);
+            g->block_bitmap_dirty = 0;
+        }
+        if (g->inode_bitmap_dirty) {
+            ext2_write_block(fs,
+                             e->descriptors[i].inode_bitmap,
+                             g->inode_bitmap);
+            g->inode_bitmap_dirty = 0;
+        }
+    }
+}
+
+
+#pragma mark - Block and Inode Allocation
+
+static uint32_t ext2_claim_blocks(vfs_t fs,
+                                  uint32_t group,
+                                  uint32_t from,
+                                  uint32_t want,
+                                  uint32_t *count)
+{
+    // Take the first free block of the group at or after the given one, and
+    // as many of the blocks following it as are free, up to the number
+    // wanted.
+    ext2_t e = fs->assoc_info;
+    uint8_t *bitmap = ext2_block_bitmap(fs, group);
+    uint32_t limit = ext2_blocks_in_group(e, group);
+    uint32_t bit = ext2_bit_find_clear(bitmap, from, limit);
+    if (bit == UINT32_MAX) {
+        return 0;
+    }
+
+    uint32_t n = 0;
+    while (n < want && bit + n < limit && !ext2_bit_test(bitmap, bit + n)) {
+        ext2_bit_set(bitmap, bit + n);
+        n++;
+    }
+
+    e->groups[group].block_bitmap_dirty = 1;
+    e->descriptors[group].free_blocks_count -= n;
+    e->superblock->free_blocks_count -= n;
+    e->descriptors_dirty = 1;
+    e->superblock_dirty = 1;
+    *count = n;
+    return ext2_group_first_block(e, group) + bit;
+}
+
+static uint32_t ext2_allocate_blocks(vfs_t fs,
+                                     uint32_t goal,
+                                     uint32_t want,
+                                     uint32_t *count)
+{
+    // Blocks are taken as close after the goal as possible, starting with
+    // its own group and then moving on through the following groups. Groups
+    // without any free blocks are passed over without reading their bitmaps.
+    ext2_t e = fs->assoc_info;
+    if (e->superblock->free_blocks_count == 0 || want == 0) {
+        return 0;
+    }
+    if (!ext2_is_valid_block(e, goal)) {
+        goal = e->superblock->first_data_block;
+    }
+
+    uint32_t first_group = ext2_group_of_block(e, goal);
+    for (uint32_t i = 0; i <= e->group_count; ++i) {
+        uint32_t group = (first_group + i) % e->group_count;
+        if (e->descriptors[group].free_blocks_count == 0) {
+            continue;
+        }
+
+        uint32_t from = 0;
+        if (i == 0) {
+            from = goal - ext2_group_first_block(e, group);
+        }
+        uint32_t block = ext2_claim_blocks(fs, group, from, want, count);
+        if (block) {
+            return block;
+        }
+    }
+    return 0;
+}
+
+static void ext2_release_block(vfs_t fs, uint32_t block)
+{
+    ext2_t e = fs->assoc_info;
+    if (!ext2_is_valid_block(e, block)) {
+        return;
+    }
+
+    uint32_t group = ext2_group_of_block(e, block);
+    uint32_t bit = block - ext2_group_first_block(e, group);
+    uint8_t *bitmap = ext2_block_bitmap(fs, group);
+    if (!ext2_bit_test(bitmap, bit)) {
+        return;
+    }
+
+    ext2_cache_forget(fs, block);
+    ext2_bit_clear(bitmap, bit);
+    e->groups[group].block_bitmap_dirty = 1;
+    e->descriptors[group].free_blocks_count++;
+    e->superblock->free_blocks_count++;
+    e->descriptors_dirty = 1;
+    e->superblock_dirty = 1;
+}
+
+static uint32_t ext2_directory_group(vfs_t fs)
+{
+    // New directories are spread out across the volume, going to the group
+    // with the most free blocks among those with at least an average share of
+    // the free inodes.
+    ext2_t e = fs->assoc_info;
+    uint32_t average = e->superblock->free_inodes_count / e->group_count;
+    uint32_t best = UINT32_MAX;
+    for (uint32_t group = 0; group < e->group_count; ++group) {
+        struct ext2_group_descriptor *d = &e->descriptors[group];
+        if (d->free_inodes_count == 0 || d->free_inodes_count < average) {
+            continue;
+        }
+        if (best == UINT32_MAX
+            || d->free_blocks_count > e->descriptors[best].free_blocks_count) {
+            best = group;
+        }
+    }
+    return best == UINT32_MAX ? 0 : best;
+}
+
+static uint32_t ext2_allocate_inode(vfs_t fs,
+                                    uint32_t parent_group,
+                                    uint8_t is_directory)
+{
+    // Files are kept in the same group as their directory where possible, so
+    // that they end up close to each other and to their data.
+    ext2_t e = fs->assoc_info;
+    if (e->superblock->free_inodes_count == 0) {
+        return 0;
+    }
+
+    uint32_t first_group = is_directory ? ext2_directory_group(fs)
+                                        : parent_group;
+    uint32_t limit = e->superblock->inodes_per_group;
+    for (uint32_t i = 0; i < e->group_count; ++i) {
+        uint32_t group = (first_group + i) % e->group_count;
+        struct ext2_group_descriptor *d = &e->descriptors[group];
+        if (d->free_inodes_count == 0) {
+            continue;
+        }
+
+        uint8_t *bitmap = ext2_inode_bitmap(fs, group);
+        uint32_t bit = ext2_bit_find_clear(bitmap, 0, limit);
+        uint32_t number = (group * limit) + bit + 1;
+        if (bit == UINT32_MAX || number < e->superblock->first_ino) {
+            continue;
+        }
+
+        ext2_bit_set(bitmap, bit);
+        e->groups[group].inode_bitmap_dirty = 1;
+        d->free_inodes_count--;
+        e->superblock->free_inodes_count--;
+        if (is_directory) {
+            d->used_dirs_count++;
+        }
+        e->descriptors_dirty = 1;
+        e->superblock_dirty = 1;
+        return number;
+    }
+    return 0;
+}
+
+static void ext2_release_inode(vfs_t fs,
+                               uint32_t number,
+                               uint8_t is_directory)
+{
+    ext2_t e = fs->assoc_info;
+    uint32_t group = ext2_group_of_inode(e, number);
+    uint32_t bit = (number - 1) % e->superblock->inodes_per_group;
+    uint8_t *bitmap = ext2_inode_bitmap(fs, group);
+    if (!ext2_bit_test(bitmap, bit)) {
+        return;
+    }
+
+    ext2_bit_clear(bitmap, bit);
+    e->groups[group].inode_bitmap_dirty = 1;
+    e->descriptors[group].free_inodes_count++;
+    e->superblock->free_inodes_count++;
+    if (is_directory && e->descriptors[group].used_dirs_count > 0) {
+        e->descriptors[group].used_dirs_count--;
+    }
+    e->descriptors_dirty = 1;
+    e->superblock_dirty = 1;
+}
+
+
+#pragma mark - Block Mapping
+
+static uint32_t ext2_block_path(ext2_t e, uint32_t logical, uint32_t *path)
+{
+    // Work out the chain of pointers that leads to a block of a file, as an
+    // index into the inode followed by an index into each indirect block.
+    // Returns the length of the chain, or 0 if the block can not be mapped.
+    uint64_t per = ext2_pointers_per_block(e);
+    uint64_t n = logical;
+    if (n < EXT2_NDIR_BLOCKS) {
+        path[0] = (uint32_t)n;
+        return 1;
+    }
+
+    n -= EXT2_NDIR_BLOCKS;
+    if (n < per) {
+        path[0] = EXT2_IND_BLOCK;
+        path[1] = (uint32_t)n;
+        return 2;
+    }
+
+    n -= per;
+    if (n < per * per) {
+        path[0] = EXT2_DIND_BLOCK;
+        path[1] = (uint32_t)(n / per);
+        path[2] = (uint32_t)(n % per);
+        return 3;
+    }
+
+    n -= per * per;
+    if (n < per * per * per) {
+        path[0] = EXT2_TIND_BLOCK;
+        path[1] = (uint32_t)(n / (per * per));
+        path[2] = (uint32_t)((n / per) % per);
+        path[3] = (uint32_t)(n % per);
+        return 4;
+    }
+    return 0;
+}
+
+static uint32_t ext2_map_block(vfs_t fs,
+                               struct ext2_inode_info *info,
+                               uint32_t logical,
+                               uint32_t limit,
+                               uint32_t *run)
+{
+    // Find the block holding the given block of a file, along with how many
+    // of the blocks after it follow on contiguously, up to the limit. A block
+    // of zero is a hole, and the run is then the length of the hole.
+    ext2_t e = fs->assoc_info;
+    uint32_t path[4];
+    uint32_t depth = ext2_block_path(e, logical, path);
+    *run = 1;
+    if (depth == 0) {
+        return 0;
+    }
+
+    const uint32_t *pointers = info->disk.block;
+    uint32_t count = EXT2_NDIR_BLOCKS;
+    uint32_t block = pointers[path[0]];
+    for (uint32_t level = 1; level < depth; ++level) {
+        if (!ext2_is_valid_block(e, block)) {
+            return 0;
+        }
+        pointers = (const uint32_t *)ext2_cache_get(fs, block, 1)->data;
+        count = ext2_pointers_per_block(e);
+        block = pointers[path[level]];
+    }
+    if (block && !ext2_is_valid_block(e, block)) {
+        return 0;
+    }
+
+    // Runs never extend beyond the pointers of a single block.
+    uint32_t index = path[depth - 1];
+    uint32_t n = 1;
+    while (n < limit && index + n < count) {
+        uint32_t next = pointers[index + n];
+        if ((block && next != block + n) || (!block && next)) {
+            break;
+        }
+        n++;
+    }
+    *run = n;
+    return block;
+}
+
+static int ext2_map_set(vfs_t fs,
+                        struct ext2_inode_info *info,
+                        uint32_t logical,
+                        uint32_t block)
+{
+    // Record the block holding the given block of a file, allocating any
+    // indirect blocks needed to reach it next to the block itself.
+    ext2_t e = fs->assoc_info;
+    uint32_t path[4];
+    uint32_t depth = ext2_block_path(e, logical, path);
+    if (depth == 0) {
+        return 0;
+    }
+
+    uint32_t *pointers = info->disk.block;
+    struct ext2_cached_block *cached = NULL;
+    info->is_dirty = 1;
+    for (uint32_t level = 0; level < depth - 1; ++level) {
+        uint32_t next = pointers[path[level]];
+        uint8_t is_new = 0;
+        if (!next) {
+            uint32_t count = 0;
+            next = ext2_allocate_blocks(fs, block, 1, &count);
+            if (!next) {
+                return 0;
+            }
+            info->disk.blocks += ext2_sectors_per_block_count(e);
+            pointers[path[level]] = next;
+            is_new = 1;
+        }
+        if (cached) {
+            cached->is_dirty = 1;
+        }
+
+        // The pointers of the previous level are not touched again once the
+        // next block has been fetched, as it may have taken their place in
+        // the cache.
+        cached = ext2_cache_get(fs, next, !is_new);
+        cached->is_dirty |= is_new;
+        pointers = (uint32_t *)cached->data;
+    }
+
+    pointers[path[depth - 1]] = block;
+    if (cached) {
+        cached->is_dirty = 1;
+    }
+    return 1;
+}
+
+static int ext2_release_tree(vfs_t fs,
+                             struct ext2_inode_info *info,
+                             uint32_t block,
+                             uint32_t level,
+                             uint64_t base,
+                             uint64_t keep)
+{
+    // Release every block of a file from the keep'th onwards that lies
+    // beneath the given block, which maps the blocks of the file from the
+    // base onwards through the given number of levels of indirection.
+    // Returns whether the block itself was released.
+    ext2_t e = fs->assoc_info;
+    uint64_t per = ext2_pointers_per_block(e);
+    uint64_t span = 1;
+    for (uint32_t i = 0; i < level; ++i) {
+        span *= per;
+    }
+    if (!block || keep >= base + span) {
+        return 0;
+    }
+
+    if (level > 0 && ext2_is_valid_block(e, block)) {
+        // The pointers are worked on in a copy, as releasing the blocks
+        // beneath them goes through the cache.
+        uint32_t *pointers = malloc(e->block_size);
+        memcpy(pointers, ext2_cache_get(fs, block, 1)->data, e->block_size);
+
+        uint64_t child_span = span / per;
+        uint8_t changed = 0;
+        for (uint32_t i = 0; i < per; ++i) {
+            if (ext2_release_tree(fs,
+                                  info,
+                                  pointers[i],
+                                  level - 1,
+                                  base + (i * child_span),
+                                  keep)) {
+                pointers[i] = 0;
+                changed = 1;
+            }
+        }
+
+        if (keep > base && changed) {
+            struct ext2_cached_block *cached = ext2_cache_get(fs, block, 1);
+            memcpy(cached->data, pointers, e->block_size);
+            cached->is_dirty = 1;
+        }
+        free(pointers);
+        if (keep > base) {
+            return 0;
+        }
+    }
+
+    ext2_release_block(fs, block);
+    uint32_t sectors = ext2_sectors_per_block_count(e);
+    info->disk.blocks -= MIN(info->disk.blocks, sectors);
+    return 1;
+}
+
+static void ext2_release_blocks(vfs_t fs,
+                                struct ext2_inode_info *info,
+                                uint32_t keep)
+{
+    // Release the blocks of a file from the keep'th onwards, along with any
+    // indirect blocks that no longer map anything.
+    ext2_t e = fs->assoc_info;
+    uint64_t per = ext2_pointers_per_block(e);
+    uint64_t base = EXT2_NDIR_BLOCKS;
+    uint32_t *block = info->disk.block;
+
+    for (uint32_t i = keep; i < EXT2_NDIR_BLOCKS; ++i) {
+        if (ext2_release_tree(fs, info, block[i], 0, i, keep)) {
+            block[i] = 0;
+        }
+    }
+    if (ext2_release_tree(fs, info, block[EXT2_IND_BLOCK], 1, base, keep)) {
+        block[EXT2_IND_BLOCK] = 0;
+    }
+    base += per;
+    if (ext2_release_tree(fs, info, block[EXT2_DIND_BLOCK], 2, base, keep)) {
+        block[EXT2_DIND_BLOCK] = 0;
+    }
+    base += per * per;
+    if (ext2_release_tree(fs, info, block[EXT2_TIND_BLOCK], 3, base, keep)) {
+        block[EXT2_TIND_BLOCK] = 0;
+    }
+    info->is_dirty = 1;
+}
+
+static uint32_t ext2_allocation_goal(vfs_t fs,
+                                     struct ext2_inode_info *info,
+                                     uint32_t logical)
+{
+    // Data goes straight after the block before it in the file, or at the
+    // start of the group holding the inode if that is unknown.
+    ext2_t e = fs->assoc_info;
+    if (logical > 0) {
+        uint32_t run = 0;
+        uint32_t previous = ext2_map_block(fs, info, logical - 1, 1, &run);
+        if (previous) {
+            return previous + 1;
+        }
+    }
+    return ext2_group_first_block(e, ext2_group_of_inode(e, info->number));
+}
+
+static int ext2_resize_blocks(vfs_t fs,
+                              struct ext2_inode_info *info,
+                              uint32_t old_count,
+                              uint32_t new_count)
+{
+    // Shrinking only ever releases blocks. Growing allocates runs of blocks
+    // after the current end of the file, and puts everything back the way it
+    // was if the volume fills up part way through.
+    ext2_t e = fs->assoc_info;
+    if (new_count <= old_count) {
+        ext2_release_blocks(fs, info, new_count);
+        return 1;
+    }
+
+    uint32_t goal = ext2_allocation_goal(fs, info, old_count);
+    uint32_t logical = old_count;
+    while (logical < new_count) {
+        uint32_t count = 0;
+        uint32_t first = ext2_allocate_blocks(fs,
+                                              goal,
+                                              new_count - logical,
+                                              &count);
+        if (!first) {
+            ext2_release_blocks(fs, info, old_count);
+            return 0;
+        }
+
+        for (uint32_t i = 0; i < count; ++i) {
+            if (!ext2_map_set(fs, info, logical + i, first + i)) {
+                for (uint32_t j = i; j < count; ++j) {
+                    ext2_release_block(fs, first + j);
+                }
+                ext2_release_blocks(fs, info, old_count);
+                return 0;
+            }
+            info->disk.blocks += ext2_sectors_per_block_count(e);
+        }
+        logical += count;
+        goal = first + count;
+    }
+    info->is_dirty = 1;
+    return 1;
+}
+
+
+#pragma mark - Extents
+
+static vfs_extent_list_t ext2_inode_extents(vfs_t fs,
+                                            struct ext2_inode_info *info)
+{
+    // Runs of blocks are found through the block map and merged as they are
+    // appended. A file with holes in it is only described up to its first
+    // hole, as the extents of a file have no gaps.
+    ext2_t e = fs->assoc_info;
+    vfs_extent_list_t extents = vfs_extent_list_init();
+    if (ext2_is_inline_symlink(e, &info->disk)) {
+        return extents;
+    }
+
+    uint32_t count = ext2_blocks_for_size(e, info->disk.size);
+    uint32_t logical = 0;
+    while (logical < count) {
+        uint32_t run = 0;
+        uint32_t block = ext2_map_block(fs,
+                                        info,
+                                        logical,
+                                        count - logical,
+                                        &run);
+        if (!block) {
+            break;
+        }
+        vfs_extent_list_append(extents,
+                               ext2_block_sector(e, block),
+                               run * e->sectors_per_block);
+        logical += run;
+    }
+    return extents;
+}
+
+static uint8_t *ext2_read_extents(vfs_t fs, vfs_extent_list_t extents)
+{
+    uint32_t bps = fs->device->sector_size;
+    uint8_t *data = calloc((size_t)extents->sector_count * bps + 8, 1);
+
+    struct vfs_extent_iterator it;
+    const struct vfs_extent *extent;
+    vfs_extent_iterator_init(&it, extents);
+    while ((extent = vfs_extent_iterator_next(&it))) {
+        device_read_sectors_into(fs->device,
+                                 extent->start,
+                                 extent->length,
+                                 data + ((size_t)extent->offset * bps));
+    }
+    return data;
+}
+
+static vfs_extent_list_t ext2_node_extents(vfs_t fs, vfs_node_t node)
+{
+    assert(fs);
+    assert(node);
+
+    if (!node->extents) {
+        struct ext2_entry *entry = node->assoc_info;
+        node->extents = ext2_inode_extents(fs, entry->inode);
+    }
+    return node->extents;
+}
+
+static void ext2_discard_node_extents(vfs_node_t node)
+{
+    vfs_extent_list_destroy(node->extents);
+    node->extents = NULL;
+}
+
+
+#pragma mark - Directories
+
+static struct ext2_dir_entry *ext2_record_at(struct ext2_directory *dir,
+                                             uint32_t offset)
+{
+    return (struct ext2_dir_entry *)(dir->data + offset);
+}
+
+static uint32_t ext2_record_name_length(ext2_t e,
+                                        const struct ext2_dir_entry *record)
+{
+    // Without file types in the directory, the type byte is the high byte of
+    // the length of the name.
+    if (e->has_filetype) {
+        return record->name_len;
+    }
+    return record->name_len | ((uint32_t)record->file_type << 8);
+}
+
+static int ext2_record_is_valid(ext2_t e,
+                                const struct ext2_dir_entry *record,
+                                uint32_t offset_in_block)
+{
+    uint32_t rec_len = record->rec_len;
+    return rec_len >= EXT2_DIR_ENTRY_HEADER
+        && (rec_len & 3) == 0
+        && offset_in_block + rec_len <= e->block_size
+        && ext2_record_name_length(e, record) + EXT2_DIR_ENTRY_HEADER
+           <= rec_len;
+}
+
+static uint32_t ext2_record_used(ext2_t e, const struct ext2_dir_entry *record)
+{
+    if (!record->inode) {
+        return 0;
+    }
+    return ext2_rec_size(ext2_record_name_length(e, record));
+}
+
+static void ext2_measure_block_slack(ext2_t e,
+                                     struct ext2_directory *dir,
+                                     uint32_t block)
+{
+    // Record the most room left over after any one record of the block,
+    // which is the longest name that could be added to it.
+    uint32_t start = block * e->block_size;
+    uint32_t offset = 0;
+    uint32_t slack = 0;
+    while (offset < e->block_size) {
+        struct ext2_dir_entry *record = ext2_record_at(dir, start + offset);
+        if (!ext2_record_is_valid(e, record, offset)) {
+            slack = 0;
+            break;
+        }
+        slack = MAX(slack, record->rec_len - ext2_record_used(e, record));
+        offset += record->rec_len;
+    }
+    dir->slack[block] = slack;
+}
+
+static vfs_node_t ext2_construct_node(vfs_t fs,
+                                      struct ext2_directory *dir,
+                                      uint32_t offset)
+{
+    ext2_t e = fs->assoc_info;
+    struct ext2_dir_entry *record = ext2_record_at(dir, offset);
+    uint32_t len = ext2_record_name_length(e, record);
+    char name[EXT2_NAME_MAX_LENGTH + 1];
+    memcpy(name, record->name, len);
+    name[len] = '\0';
+
+    struct ext2_entry *entry = arena_alloc(&dir->arena, sizeof(*entry));
+    entry->parent = dir;
+    entry->offset = offset;
+    entry->inode = ext2_inode_get(fs, record->inode);
+
+    struct ext2_inode *inode = &entry->inode->disk;
+    vfs_node_t node = vfs_node_init_in_arena(
+        &dir->arena,
+        fs,
+        name,
+        ext2_translate_to_vfs_attributes(inode, name),
+        vfs_node_used,
+        entry
+    );
+
+    // Directories do not report a size, as with FAT. There is no creation
+    // time, so the time of the last change to the inode stands in for it.
+    if (!ext2_is_directory(inode)) {
+        node->size = inode->size;
+    }
+    node->creation_time = inode->ctime;
+    node->modification_time = inode->mtime;
+    node->access_time = inode->atime;
+
+    dir->nodes[offset / 4] = node;
+    name_index_insert(&dir->names,
+                      name_hash((const uint8_t *)name, len),
+                      offset);
+    return node;
+}
+
+static struct ext2_directory *ext2_load_directory(vfs_t fs,
+                                                  struct ext2_inode_info *info)
+{
+    ext2_t e = fs->assoc_info;
+    uint32_t bps = fs->device->sector_size;
+
+    // The directory is read in whole, and stays resident until the volume is
+    // unmounted.
+    struct ext2_directory *dir = calloc(1, sizeof(*dir));
+    dir->inode = info;
+    dir->self.inode = info;
+    dir->extents = ext2_inode_extents(fs, info);
+    dir->data = ext2_read_extents(fs, dir->extents);
+    dir->size = (uint32_t)MIN((uint64_t)dir->extents->sector_count * bps,
+                              (uint64_t)info->disk.size);
+    dir->size -= dir->size % e->block_size;
+    dir->block_count = dir->size / e->block_size;
+    dir->slack = calloc(dir->block_count + 1, sizeof(*dir->slack));
+    dir->nodes = calloc((dir->size / 4) + 1, sizeof(*dir->nodes));
+
+    uint32_t expected = (dir->size / 32) + 1;
+    arena_init(&dir->arena, expected * EXT2_ARENA_BYTES_PER_ENTRY);
+    name_index_init(&dir->names, expected);
+
+    for (uint32_t block = 0; block < dir->block_count; ++block) {
+        uint32_t start = block * e->block_size;
+        uint32_t offset = 0;
+        while (offset < e->block_size) {
+            struct ext2_dir_entry *record = ext2_record_at(dir, start + offset);
+            if (!ext2_record_is_valid(e, record, offset)) {
+                fprintf(stderr, "Skipping a damaged block in a directory.\n");
+                break;
+            }
+            if (record->inode
+                && ext2_is_valid_inode(e, record->inode)
+                && ext2_record_name_length(e, record) > 0) {
+                ext2_construct_node(fs, dir, start + offset);
+            }
+            offset += record->rec_len;
+        }
+        ext2_measure_block_slack(e, dir, block);
+    }
+
+    dir->end = vfs_node_init_in_arena(&dir->arena,
+                                      fs,
+                                      "",
+                                      0,
+                                      vfs_node_unused,
+                                      NULL);
+
+    dir->next = e->directories;
+    e->directories = dir;
+    return dir;
+}
+
+static void ext2_destroy_directory(struct ext2_directory *dir)
+{
+    // Nodes are released one at a time, as they may still be linked in the
+    // order they were last listed.
+    for (uint32_t i = 0; i < dir->size / 4; ++i) {
+        vfs_node_t node = dir->nodes[i];
+        if (node) {
+            node->next_sibling = NULL;
+            vfs_node_destroy(node);
+        }
+    }
+    vfs_extent_list_destroy(dir->extents);
+    name_index_destroy(&dir->names);
+    arena_destroy(&dir->arena);
+    free(dir->nodes);
+    free(dir->slack);
+    free(dir->data);
+    free(dir);
+}
+
+static void ext2_drop_directory(vfs_t fs, struct ext2_directory *dir)
+{
+    ext2_t e = fs->assoc_info;
+    struct ext2_directory **link = &e->directories;
+    while (*link && *link != dir) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = dir->next;
+    }
+    if (e->current_dir == dir) {
+        e->current_dir = e->root;
+    }
+    ext2_destroy_directory(dir);
+}
+
+static struct ext2_directory *ext2_directory_for(vfs_t fs,
+                                                 vfs_node_t directory)
+{
+    // Directories are identified by their inode, so that a directory reached
+    // through "." or ".." is the same as when it is reached by name. A NULL
+    // directory is the root directory.
+    ext2_t e = fs->assoc_info;
+    if (!directory) {
+        return e->root;
+    }
+
+    struct ext2_entry *entry = directory->assoc_info;
+    struct ext2_directory *dir = e->directories;
+    while (dir && dir->inode != entry->inode) {
+        dir = dir->next;
+    }
+    return dir ? dir : ext2_load_directory(fs, entry->inode);
+}
+
+static vfs_node_t ext2_directory_list(struct ext2_directory *dir)
+{
+    // Link together the nodes in the order their records appear, finishing
+    // with the end of directory marker.
+    vfs_node_t head = dir->end;
+    vfs_node_t prev = NULL;
+    for (uint32_t i = 0; i < dir->size / 4; ++i) {
+        vfs_node_t node = dir->nodes[i];
+        if (!node) {
+            continue;
+        }
+        node->prev_sibling = prev;
+        if (prev) {
+            prev->next_sibling = node;
+        }
+        else {
+            head = node;
+        }
+        prev = node;
+    }
+
+    dir->end->prev_sibling = prev;
+    dir->end->next_sibling = NULL;
+    if (prev) {
+        prev->next_sibling = dir->end;
+    }
+    return head;
+}
+
+static uint32_t ext2_directory_lookup(struct ext2_directory *dir,
+                                      const char *name)
+{
+    // Names are compared exactly, so the index only needs confirming against
+    // the name of each candidate.
+    uint32_t len = (uint32_t)strlen(name);
+    uint32_t hash = name_hash((const uint8_t *)name, len);
+    uint32_t cursor = 0;
+    uint32_t offset = name_index_first(&dir->names, hash, &cursor);
+    while (offset != NAME_INDEX_NONE) {
+        if (strcmp(dir->nodes[offset / 4]->name, name) == 0) {
+            return offset;
+        }
+        offset = name_index_next(&dir->names, hash, &cursor);
+    }
+    return NAME_INDEX_NONE;
+}
+
+static void ext2_directory_modified(struct ext2_directory *dir)
+{
+    // Any hashed index the directory had no longer matches its entries, and
+    // is dropped so that it is rebuilt by whatever next checks the volume.
+    dir->is_dirty = 1;
+    if (dir->inode->disk.flags & EXT2_INDEX_FL) {
+        dir->inode->disk.flags &= ~EXT2_INDEX_FL;
+        dir->inode->is_dirty = 1;
+    }
+}
+
+static int ext2_grow_directory(vfs_t fs, struct ext2_directory *dir)
+{
+    ext2_t e = fs->assoc_info;
+    struct ext2_inode_info *info = dir->inode;
+    if (!ext2_resize_blocks(fs, info, dir->block_count, dir->block_count + 1)) {
+        return 0;
+    }
+
+    // The new block holds a single unused record that spans all of it.
+    uint32_t block = dir->block_count;
+    uint32_t size = dir->size + e->block_size;
+    info->disk.size = size;
+    info->is_dirty = 1;
+    vfs_extent_list_destroy(dir->extents);
+    dir->extents = ext2_inode_extents(fs, info);
+
+    dir->data = realloc(dir->data, size + 8);
+    memset(dir->data + dir->size, 0, e->block_size);
+    struct ext2_dir_entry *record = ext2_record_at(dir, dir->size);
+    record->rec_len = (uint16_t)e->block_size;
+
+    dir->nodes = realloc(dir->nodes, ((size / 4) + 1) * sizeof(*dir->nodes));
+    memset(dir->nodes + (dir->size / 4),
+           0,
+           ((e->block_size / 4) + 1) * sizeof(*dir->nodes));
+    dir->slack = realloc(dir->slack, (block + 2) * sizeof(*dir->slack));
+    dir->slack[block] = e->block_size;
+
+    dir->size = size;
+    dir->block_count++;
+    ext2_directory_modified(dir);
+    return 1;
+}
+
+static uint32_t ext2_directory_insert(vfs_t fs,
+                                      struct ext2_directory *dir,
+                                      const char *name,
+                                      uint32_t number,
+                                      uint8_t file_type)
+{
+    // A new record goes in the first block with room enough after one of its
+    // records, taking over the space left at the end of that record.
+    ext2_t e = fs->assoc_info;
+    uint32_t len = (uint32_t)strlen(name);
+    uint32_t needed = ext2_rec_size(len);
+    uint32_t block = 0;
+    while (block < dir->block_count && dir->slack[block] < needed) {
+        block++;
+    }
+    if (block == dir->block_count && !ext2_grow_directory(fs, dir)) {
+        return NAME_INDEX_NONE;
+    }
+
+    uint32_t start = block * e->block_size;
+    uint32_t offset = 0;
+    while (offset < e->block_size) {
+        struct ext2_dir_entry *record = ext2_record_at(dir, start + offset);
+        uint32_t used = ext2_record_used(e, record);
+        if (record->rec_len - used >= needed) {
+            struct ext2_dir_entry *added = record;
+            if (used > 0) {
+                added = ext2_record_at(dir, start + offset + used);
+                added->rec_len = (uint16_t)(record->rec_len - used);
+                record->rec_len = (uint16_t)used;
+                offset += used;
+            }
+            added->inode = number;
+            added->name_len = (uint8_t)len;
+            added->file_type = e->has_filetype ? file_type : 0;
+            memcpy(added->name, name, len);
+            memset(added->name + len, 0, needed - EXT2_DIR_ENTRY_HEADER - len);
+            break;
+        }
+        offset += record->rec_len;
+    }
+
+    ext2_measure_block_slack(e, dir, block);
+    ext2_directory_modified(dir);
+    return start + offset;
+}
+
+static void ext2_directory_remove(vfs_t fs,
+                                  struct ext2_directory *dir,
+                                  uint32_t offset)
+{
+    // The record is merged into the one before it in the block. The first
+    // record of a block has nothing before it, and is marked unused instead.
+    ext2_t e = fs->assoc_info;
+    uint32_t block = offset / e->block_size;
+    uint32_t start = block * e->block_size;
+    struct ext2_dir_entry *record = ext2_record_at(dir, offset);
+
+    uint32_t previous = start;
+    while (previous < offset) {
+        struct ext2_dir_entry *p = ext2_record_at(dir, previous);
+        if (previous + p->rec_len == offset) {
+            p->rec_len = (uint16_t)(p->rec_len + record->rec_len);
+            break;
+        }
+        previous += p->rec_len;
+    }
+    if (previous >= offset) {
+        record->inode = 0;
+    }
+
+    ext2_measure_block_slack(e, dir, block);
+    ext2_directory_modified(dir);
+}
+
+static void ext2_entry_store(vfs_node_t node)
+{
+    // Bring the inode up to date with any changes made through its node.
+    struct ext2_entry *entry = node->assoc_info;
+    struct ext2_inode *inode = &entry->inode->disk;
+    if (node->attributes & vfs_node_read_only_attribute) {
+        inode->mode &= ~ext2_mode_write_bits;
+    }
+    else if (!(inode->mode & ext2_mode_write_bits)) {
+        inode->mode |= 0200;
+    }
+    inode->mtime = (uint32_t)node->modification_time;
+    inode->atime = (uint32_t)node->access_time;
+    inode->ctime = (uint32_t)time(NULL);
+    entry->inode->is_dirty = 1;
+    node->is_dirty = 0;
+}
+
+static void ext2_flush_directory(vfs_t fs, struct ext2_directory *dir)
+{
+    uint32_t bps = fs->device->sector_size;
+    for (uint32_t i = 0; i < dir->size / 4; ++i) {
+        vfs_node_t node = dir->nodes[i];
+        if (node && node->is_dirty) {
+            ext2_entry_store(node);
+        }
+    }
+
+    if (dir->is_dirty) {
+        struct vfs_extent_iterator it;
+        const struct vfs_extent *extent;
+        vfs_extent_iterator_init(&it, dir->extents);
+        while ((extent = vfs_extent_iterator_next(&it))) {
+            device_write_sectors(fs->device,
+                                 extent->start,
+                                 extent->length,
+                                 dir->data + ((size_t)extent->offset * bps));
+        }
+        dir->is_dirty = 0;
+    }
+}
+
+
+#pragma mark - ext2 Formatting
+
+static uint32_t ext2_log2(uint32_t n)
+{
+    uint32_t shift = 0;
+    while (((uint32_t)1 << (shift + 1)) <= n) {
+        ++shift;
+    }
+    return shift;
+}
+
+static uint32_t ext2_group_overhead(const struct ext2_superblock *sb,
+                                    uint32_t group,
+                                    uint32_t descriptor_blocks,
+                                    uint32_t inode_table_blocks)
+{
+    // Groups with a copy of the superblock also carry a copy of the group
+    // descriptors, and every group has its two bitmaps and inode table.
+    uint32_t overhead = 2 + inode_table_blocks;
+    if (ext2_group_has_superblock(sb, group)) {
+        overhead += 1 + descriptor_blocks;
+    }
+    return overhead;
+}
+
+static void ext2_write_directory_block(vdevice_t dev,
+                                       uint32_t sector,
+                                       uint32_t block_size,
+                                       uint32_t self,
+                                       uint32_t parent,
+                                       const char *child,
+                                       uint32_t child_inode)
+{
+    // A new directory block holds "." and "..", and optionally one other
+    // directory, with the last record taking up the rest of the block.
+    uint8_t *data = calloc(block_size, 1);
+    struct ext2_dir_entry *dot = (struct ext2_dir_entry *)data;
+    dot->inode = self;
+    dot->rec_len = (uint16_t)ext2_rec_size(1);
+    dot->name_len = 1;
+    dot->file_type = ext2_file_type_directory;
+    dot->name[0] = '.';
+
+    struct ext2_dir_entry *dotdot =
+        (struct ext2_dir_entry *)(data + dot->rec_len);
+    dotdot->inode = parent;
+    dotdot->rec_len = (uint16_t)(block_size - dot->rec_len);
+    dotdot->name_len = 2;
+    dotdot->file_type = ext2_file_type_directory;
+    memcpy(dotdot->name, "..", 2);
+
+    if (child) {
+        uint32_t len = (uint32_t)strlen(child);
+        dotdot->rec_len = (uint16_t)ext2_rec_size(2);
+        uint32_t offset = dot->rec_len + dotdot->rec_len;
+        struct ext2_dir_entry *record =
+            (struct ext2_dir_entry *)(data + offset);
+        record->inode = child_inode;
+        record->rec_len = (uint16_t)(block_size - offset);
+        record->name_len = (uint8_t)len;
+        record->file_type = ext2_file_type_directory;
+        memcpy(record->name, child, len);
+    }
+
+    device_write_sectors(dev, sector, block_size / dev->sector_size, data);
+    free(data);
+}
+
+static void ext2_format_device(
+    vdevice_t dev,
+    const char *label,
+    uint8_t *bootcode,
+    uint8_t *reserved_data,
+    uint16_t additional_reserved_sectors
+) {
+    uint32_t bps = dev->sector_size;
+    uint64_t bytes = (uint64_t)device_total_sectors(dev) * bps;
+    if (bps < 512 || bps > 4096 || (bps & (bps - 1)) != 0) {
+        fprintf(stderr, "ext2 does not support %u byte sectors.\n", bps);
+        return;
+    }
+
+    // The boot code and any reserved data have to fit in the 1K boot block
+    // in front of the superblock.
+    uint32_t boot_bytes = 0;
+    if (bootcode) {
+        boot_bytes = MIN(bps, (uint32_t)EXT2_SUPERBLOCK_OFFSET);
+    }
+    uint32_t reserved_bytes = additional_reserved_sectors * 512;
+    if (reserved_data && boot_bytes + reserved_bytes > EXT2_SUPERBLOCK_OFFSET) {
+        fprintf(stderr,
+                "ext2 only has room for %u bytes of boot code.\n",
+                EXT2_SUPERBLOCK_OFFSET);
+        return;
+    }
+
+    // Work out the geometry of the volume. Each group covers as many blocks
+    // as one block of bitmap can describe, and gets an equal share of the
+    // inodes, rounded up to fill whole blocks of the inode table.
+    uint32_t block_size = bytes <= EXT2_SMALL_VOLUME_BYTES ? 1024 : 4096;
+    block_size = MAX(block_size, bps);
+    uint32_t ratio = bytes <= EXT2_SMALL_VOLUME_BYTES ? EXT2_SMALL_INODE_RATIO
+                                                      : EXT2_INODE_RATIO;
+    uint32_t spb = block_size / bps;
+    uint32_t first_data_block = block_size == 1024 ? 1 : 0;
+    uint32_t blocks_per_group = block_size * 8;
+    uint64_t blocks = MIN(bytes / block_size, (uint64_t)UINT32_MAX);
+    uint32_t blocks_count = (uint32_t)blocks;
+    if (blocks_count <= first_data_block) {
+        fprintf(stderr, "The device is too small for an ext2 volume.\n");
+        return;
+    }
+
+    struct ext2_superblock *sb = calloc(1, sizeof(*sb));
+    sb->feature_ro_compat = EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER
+                          | EXT2_FEATURE_RO_COMPAT_LARGE_FILE;
+
+    uint32_t inodes_per_block = block_size / EXT2_GOOD_OLD_INODE_SIZE;
+    uint32_t group_count = 0;
+    uint32_t inodes_per_group = 0;
+    uint32_t inode_table_blocks = 0;
+    uint32_t descriptor_blocks = 0;
+    for (;;) {
+        group_count = (blocks_count - first_data_block + blocks_per_group - 1)
+                    / blocks_per_group;
+        uint64_t inodes = bytes / ratio;
+        inodes_per_group = (uint32_t)((inodes + group_count - 1) / group_count);
+        inodes_per_group = MAX(inodes_per_group, (uint32_t)16);
+        inodes_per_group = ((inodes_per_group + inodes_per_block - 1)
+                            / inodes_per_block) * inodes_per_block;
+        inodes_per_group = MIN(inodes_per_group, block_size * 8);
+        inode_table_blocks = inodes_per_group / inodes_per_block;
+        descriptor_blocks = ((group_count
+                              * sizeof(struct ext2_group_descriptor))
+                             + block_size - 1) / block_size;
+
+        // A trailing group too small to be worth having is left off the end
+        // of the volume.
+        uint32_t last = group_count - 1;
+        uint32_t last_blocks = blocks_count - first_data_block
+                             - (last * blocks_per_group);
+        uint32_t overhead = ext2_group_overhead(sb,
+                                                last,
+                                                descriptor_blocks,
+                                                inode_table_blocks);
+        if (last_blocks >= overhead + EXT2_MIN_GROUP_DATA_BLOCKS) {
+            break;
+        }
+        if (last == 0) {
+            fprintf(stderr, "The device is too small for an ext2 volume.\n");
+            free(sb);
+            return;
+        }
+        blocks_count -= last_blocks;
+    }
+
+    uint32_t now = (uint32_t)time(NULL);
+    sb->inodes_count = inodes_per_group * group_count;
+    sb->blocks_count = blocks_count;
+    sb->r_blocks_count = (uint32_t)(((uint64_t)blocks_count
+                                     * EXT2_RESERVED_PERCENT) / 100);
+    sb->first_data_block = first_data_block;
+    sb->log_block_size = ext2_log2(block_size) - 10;
+    sb->log_frag_size = sb->log_block_size;
+    sb->blocks_per_group = blocks_per_group;
+    sb->frags_per_group = blocks_per_group;
+    sb->inodes_per_group = inodes_per_group;
+    sb->wtime = now;
+    sb->max_mnt_count = UINT16_MAX;
+    sb->magic = EXT2_SUPER_MAGIC;
+    sb->state = EXT2_VALID_FS;
+    sb->errors = EXT2_ERRORS_CONTINUE;
+    sb->lastcheck = now;
+    sb->rev_level = EXT2_DYNAMIC_REV;
+    sb->first_ino = EXT2_GOOD_OLD_FIRST_INO;
+    sb->inode_size = EXT2_GOOD_OLD_INODE_SIZE;
+    sb->feature_incompat = EXT2_FEATURE_INCOMPAT_FILETYPE;
+    srand(now ^ blocks_count);
+    for (uint32_t i = 0; i < sizeof(sb->uuid); ++i) {
+        sb->uuid[i] = (uint8_t)rand();
+    }
+    sb->uuid[6] = (sb->uuid[6] & 0x0F) | 0x40;
+    sb->uuid[8] = (sb->uuid[8] & 0x3F) | 0x80;
+    if (label) {
+        strlcpy(sb->volume_name, label, sizeof(sb->volume_name));
+    }
+
+    // Lay out each group, and build the bitmaps that describe it. Group 0
+    // also holds the blocks of the root and lost+found directories, and the
+    // reserved inodes.
+    struct ext2_group_descriptor *descriptors =
+        calloc(descriptor_blocks, block_size);
+    uint8_t *bitmap = malloc(block_size);
+    uint32_t root_block = 0;
+    for (uint32_t group = 0; group < group_count; ++group) {
+        struct ext2_group_descriptor *d = &descriptors[group];
+        uint32_t first = first_data_block + (group * blocks_per_group);
+        uint32_t count = MIN(blocks_per_group, blocks_count - first);
+        uint32_t overhead = ext2_group_overhead(sb,
+                                                group,
+                                                descriptor_blocks,
+                                                inode_table_blocks);
+        uint32_t used = overhead;
+        d->block_bitmap = first + (overhead - 2 - inode_table_blocks);
+        d->inode_bitmap = d->block_bitmap + 1;
+        d->inode_table = d->inode_bitmap + 1;
+        d->free_inodes_count = (uint16_t)inodes_per_group;
+        if (group == 0) {
+            root_block = first + overhead;
+            used += 2;
+            d->free_inodes_count -= EXT2_LOST_AND_FOUND_INO;
+            d->used_dirs_count = 2;
+        }
+        d->free_blocks_count = (uint16_t)(count - used);
+        sb->free_blocks_count += count - used;
+        sb->free_inodes_count += d->free_inodes_count;
+
+        // Bits past the end of a short last group are set, so that they are
+        // never allocated.
+        memset(bitmap, 0, block_size);
+        for (uint32_t bit = 0; bit < used; ++bit) {
+            ext2_bit_set(bitmap, bit);
+        }
+        for (uint32_t bit = count; bit < blocks_per_group; ++bit) {
+            ext2_bit_set(bitmap, bit);
+        }
+        device_write_sectors(dev, d->block_bitmap * spb, spb, bitmap);
+
+        memset(bitmap, 0, block_size);
+        if (group == 0) {
+            for (uint32_t bit = 0; bit < EXT2_LOST_AND_FOUND_INO; ++bit) {
+                ext2_bit_set(bitmap, bit);
+            }
+        }
+        for (uint32_t bit = inodes_per_group; bit < block_size * 8; ++bit) {
+            ext2_bit_set(bitmap, bit);
+        }
+        device_write_sectors(dev, d->inode_bitmap * spb, spb, bitmap);
+    }
+    free(bitmap);
+
+    // The superblock and descriptors are copied into every group that has
+    // room for them, with each copy of the superblock recording its group.
+    for (uint32_t group = 0; group < group_count; ++group) {
+        if (!ext2_group_has_superblock(sb, group)) {
+            continue;
+        }
+        uint32_t first = first_data_block + (group * blocks_per_group);
+        uint64_t offset = (uint64_t)first * block_size;
+        if (group == 0) {
+            offset = EXT2_SUPERBLOCK_OFFSET;
+        }
+        sb->block_group_nr = (uint16_t)group;
+        ext2_write_bytes(dev, offset, sizeof(*sb), sb);
+        device_write_sectors(dev,
+                             (first + 1) * spb,
+                             descriptor_blocks * spb,
+                             (uint8_t *)descriptors);
+    }
+
+    // Every inode table is cleared, as whatever the device held before would
+    // otherwise be taken for live inodes. The reserved inodes are then
+    // written over the start of the first table.
+    for (uint32_t group = 0; group < group_count; ++group) {
+        ext2_write_zeros(dev,
+                         descriptors[group].inode_table * spb,
+                         inode_table_blocks * spb);
+    }
+
+    uint32_t table_bytes = EXT2_LOST_AND_FOUND_INO * EXT2_GOOD_OLD_INODE_SIZE;
+    uint32_t table_blocks = (table_bytes + block_size - 1) / block_size;
+    uint8_t *table = calloc(table_blocks, block_size);
+    struct ext2_inode *inodes = (struct ext2_inode *)table;
+
+    struct ext2_inode *root = &inodes[EXT2_ROOT_INO - 1];
+    root->mode = ext2_mode_directory | 0755;
+    root->size = block_size;
+    root->atime = root->ctime = root->mtime = now;
+    root->links_count = 3;
+    root->blocks = block_size / 512;
+    root->block[0] = root_block;
+
+    struct ext2_inode *lost = &inodes[EXT2_LOST_AND_FOUND_INO - 1];
+    lost->mode = ext2_mode_directory | 0700;
+    lost->size = block_size;
+    lost->atime = lost->ctime = lost->mtime = now;
+    lost->links_count = 2;
+    lost->blocks = block_size / 512;
+    lost->block[0] = root_block + 1;
+
+    device_write_sectors(dev,
+                         descriptors[0].inode_table * spb,
+                         table_blocks * spb,
+                         table);
+    free(table);
+
+    ext2_write_directory_block(dev,
+                               root_block * spb,
+                               block_size,
+                               EXT2_ROOT_INO,
+                               EXT2_ROOT_INO,
+                               "lost+found",
+                               EXT2_LOST_AND_FOUND_INO);
+    ext2_write_directory_block(dev,
+                               (root_block + 1) * spb,
+                               block_size,
+                               EXT2_LOST_AND_FOUND_INO,
+                               EXT2_ROOT_INO,
+                               NULL,
+                               0);
+
+    // The boot block comes last, as on devices with large sectors it shares
+    // a sector with the superblock.
+    if (bootcode || reserved_data) {
+        uint8_t *boot = calloc(EXT2_SUPERBLOCK_OFFSET, 1);
+        if (bootcode) {
+            memcpy(boot, bootcode, boot_bytes);
+        }
+        if (reserved_data) {
+            memcpy(boot + boot_bytes, reserved_data, reserved_bytes);
+        }
+        ext2_write_bytes(dev, 0, EXT2_SUPERBLOCK_OFFSET, boot);
+        free(boot);
+    }
+
+    free(descriptors);
+    free(sb);
+}
+
+
+#pragma mark - ext2 File System
+
+static const char *ext2_name()
+{
+    return "ext2";
+}
+
+uint8_t ext2_test(vdevice_t dev, struct ext2_superblock **superblock_out)
+{
+    if (!dev || (uint64_t)device_total_sectors(dev) * dev->sector_size
+                < EXT2_SUPERBLOCK_OFFSET + EXT2_SUPERBLOCK_SIZE) {
+        return 0;
+    }
+
+    // Check that the superblock describes a volume that fits on the device,
+    // and that its groups account for all of its blocks and inodes.
+    ext2_superblock_t sb = calloc(1, sizeof(*sb));
+    ext2_read_bytes(dev, EXT2_SUPERBLOCK_OFFSET, sizeof(*sb), sb);
+
+    uint32_t log = sb->log_block_size;
+    uint32_t block_size = log <= 5 ? (uint32_t)EXT2_MIN_BLOCK_SIZE << log : 0;
+    uint32_t inode_size = sb->rev_level == EXT2_GOOD_OLD_REV
+                        ? EXT2_GOOD_OLD_INODE_SIZE
+                        : sb->inode_size;
+    int valid = sb->magic == EXT2_SUPER_MAGIC
+             && sb->rev_level <= EXT2_DYNAMIC_REV
+             && block_size >= dev->sector_size
+             && block_size <= EXT2_MAX_BLOCK_SIZE
+             && sb->first_data_block == (block_size == 1024 ? 1u : 0u)
+             && sb->blocks_per_group >= 8
+             && sb->blocks_per_group <= block_size * 8
+             && sb->inodes_per_group > 0
+             && sb->inodes_per_group <= block_size * 8
+             && inode_size >= EXT2_GOOD_OLD_INODE_SIZE
+             && inode_size <= block_size
+             && (inode_size & (inode_size - 1)) == 0
+             && sb->blocks_count > sb->first_data_block
+             && (uint64_t)sb->blocks_count * block_size
+                <= (uint64_t)device_total_sectors(dev) * dev->sector_size;
+
+    if (valid) {
+        uint32_t groups = (sb->blocks_count - sb->first_data_block
+                           + sb->blocks_per_group - 1) / sb->blocks_per_group;
+        valid = (uint64_t)groups * sb->inodes_per_group == sb->inodes_count;
+    }
+
+    if (!valid) {
+        free(sb);
+        return 0;
+    }
+
+    if (superblock_out) {
+        *superblock_out = sb;
+    }
+    else {
+        free(sb);
+    }
+    return 1;
+}
+
+static int ext2_load_descriptors(vfs_t fs)
+{
+    ext2_t e = fs->assoc_info;
+    uint32_t first = e->superblock->first_data_block + 1;
+    e->descriptor_blocks = ((e->group_count
+                             * sizeof(struct ext2_group_descriptor))
+                            + e->block_size - 1) / e->block_size;
+    e->descriptors = calloc(e->descriptor_blocks, e->block_size);
+    device_read_sectors_into(fs->device,
+                             ext2_block_sector(e, first),
+                             e->descriptor_blocks * e->sectors_per_block,
+                             (uint8_t *)e->descriptors);
+
+    // Everything a group refers to has to be within the volume, including
+    // the whole of its inode table.
+    uint32_t table_blocks = (uint32_t)(((uint64_t)e->inode_size
+                                        * e->superblock->inodes_per_group
+                                        + e->block_size - 1) / e->block_size);
+    for (uint32_t group = 0; group < e->group_count; ++group) {
+        struct ext2_group_descriptor *d = &e->descriptors[group];
+        if (!ext2_is_valid_block(e, d->block_bitmap)
+            || !ext2_is_valid_block(e, d->inode_bitmap)
+            || !ext2_is_valid_block(e, d->inode_table)
+            || !ext2_is_valid_block(e, d->inode_table + table_blocks - 1)) {
+            fprintf(stderr, "The ext2 group descriptors are damaged.\n");
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void *ext2_mount(vfs_t fs)
+{
+    ext2_superblock_t sb = NULL;
+    if (!ext2_test(fs->device, &sb)) {
+        return NULL;
+    }
+
+    // Anything that changes how the volume is laid out, or that would need
+    // maintaining as it is written, can not be handled.
+    uint32_t incompat = EXT2_FEATURE_INCOMPAT_FILETYPE;
+    uint32_t ro_compat = EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER
+                       | EXT2_FEATURE_RO_COMPAT_LARGE_FILE;
+    if (sb->rev_level == EXT2_DYNAMIC_REV
+        && ((sb->feature_incompat & ~incompat)
+            || (sb->feature_ro_compat & ~ro_compat))) {
+        fprintf(stderr,
+                "The ext2 volume uses features that are not supported.\n");
+        free(sb);
+        return NULL;
+    }
+    if (!(sb->state & EXT2_VALID_FS)) {
+        fprintf(stderr, "The ext2 volume was not cleanly unmounted.\n");
+    }
+
+    // The volume needs to be reachable through the file system while it is
+    // being mounted.
+    ext2_t e = calloc(1, sizeof(*e));
+    e->superblock = sb;
+    e->block_size = (uint32_t)EXT2_MIN_BLOCK_SIZE << sb->log_block_size;
+    e->sectors_per_block = e->block_size / fs->device->sector_size;
+    e->inode_size = sb->rev_level == EXT2_GOOD_OLD_REV
+                  ? EXT2_GOOD_OLD_INODE_SIZE
+                  : sb->inode_size;
+    if (sb->rev_level == EXT2_GOOD_OLD_REV) {
+        sb->first_ino = EXT2_GOOD_OLD_FIRST_INO;
+    }
+    e->group_count = (sb->blocks_count - sb->first_data_block
+                      + sb->blocks_per_group - 1) / sb->blocks_per_group;
+    e->has_filetype = sb->rev_level == EXT2_DYNAMIC_REV
+                   && (sb->feature_incompat & EXT2_FEATURE_INCOMPAT_FILETYPE);
+    e->groups = calloc(e->group_count, sizeof(*e->groups));
+    e->inode_capacity = EXT2_MIN_INODE_CAPACITY;
+    e->inodes = calloc(e->inode_capacity, sizeof(*e->inodes));
+    arena_init(&e->inode_arena, 64 * sizeof(struct ext2_inode_info));
+    fs->assoc_info = e;
+
+    if (!ext2_load_descriptors(fs)) {
+        ext2_unmount(fs);
+        return NULL;
+    }
+
+    struct ext2_inode_info *root = ext2_inode_get(fs, EXT2_ROOT_INO);
+    if (!ext2_is_directory(&root->disk)) {
+        fprintf(stderr, "The ext2 root directory is damaged.\n");
+        ext2_unmount(fs);
+        return NULL;
+    }
+
+    e->root = ext2_load_directory(fs, root);
+    e->current_dir = e->root;
+    return e;
+}
+
+static void ext2_unmount(vfs_t fs)
+{
+    if (fs) {
+        ext2_t e = fs->assoc_info;
+        if (e) {
+            // Write back everything that is still pending before tearing
+            // down the in memory structures. A volume that failed to mount
+            // has nothing to write.
+            if (e->root) {
+                ext2_sync(fs);
+            }
+
+            while (e->directories) {
+                struct ext2_directory *dir = e->directories;
+                e->directories = dir->next;
+                ext2_destroy_directory(dir);
+            }
+            for (uint32_t i = 0; i < e->group_count; ++i) {
+                free(e->groups[i].block_bitmap);
+                free(e->groups[i].inode_bitmap);
+            }
+            for (uint32_t i = 0; i < EXT2_CACHED_BLOCKS; ++i) {
+                free(e->cache[i].data);
+            }
+            arena_destroy(&e->inode_arena);
+            free(e->inodes);
+            free(e->groups);
+            free(e->descriptors);
+            free(e->superblock);
+        }
+        free(fs->assoc_info);
+        fs->assoc_info = NULL;
+    }
+}
+
+
+#pragma mark - Working Directory
+
+static vfs_node_t ext2_current_directory(vfs_t fs)
+{
+    assert(fs);
+    ext2_t e = fs->assoc_info;
+    if (e->current_dir == e->root) {
+        return NULL;
+    }
+
+    // The directory is identified by its inode alone, so the node refers to
+    // the directory itself rather than any one of the entries linking to it.
+    return vfs_node_init(fs,
+                         ".",
+                         vfs_node_directory_attribute,
+                         vfs_node_used,
+                         &e->current_dir->self);
+}
+
+static vfs_node_t ext2_get_directory_list(vfs_t fs)
+{
+    assert(fs);
+    ext2_t e = fs->assoc_info;
+    return ext2_directory_list(e->current_dir);
+}
+
+static vfs_node_t ext2_list_directory(vfs_t fs, vfs_node_t directory)
+{
+    assert(fs);
+    return ext2_directory_list(ext2_directory_for(fs, directory));
+}
+
+static void ext2_set_directory(vfs_t fs, vfs_node_t directory)
+{
+    assert(fs);
+    ext2_t e = fs->assoc_info;
+    if (e) {
+        e->current_dir = ext2_directory_for(fs, directory);
+    }
+}
+
+
+#pragma mark - High Level File Support
+
+static int ext2_is_valid_name(const char *name)
+{
+    size_t len = strlen(name);
+    return len > 0
+        && len <= EXT2_NAME_MAX_LENGTH
+        && strchr(name, '/') == NULL
+        && strcmp(name, ".") != 0
+        && strcmp(name, "..") != 0;
+}
+
+static int ext2_create_directory_block(vfs_t fs,
+                                       struct ext2_inode_info *info,
+                                       uint32_t parent)
+{
+    ext2_t e = fs->assoc_info;
+    if (!ext2_resize_blocks(fs, info, 0, 1)) {
+        return 0;
+    }
+
+    uint32_t run = 0;
+    uint32_t block = ext2_map_block(fs, info, 0, 1, &run);
+    ext2_write_directory_block(fs->device,
+                               ext2_block_sector(e, block),
+                               e->block_size,
+                               info->number,
+                               parent,
+                               NULL,
+                               0);
+    info->disk.size = e->block_size;
+    return 1;
+}
+
+static vfs_node_t ext2_create_node(vfs_t fs,
+                                   struct ext2_directory *dir,
+                                   const char *name,
+                                   enum vfs_node_attributes attributes)
+{
+    ext2_t e = fs->assoc_info;
+    if (!ext2_is_valid_name(name)) {
+        fprintf(stderr, "Could not create %s. It is not a valid name.\n", name);
+        return NULL;
+    }
+
+    uint8_t is_directory = (attributes & vfs_node_directory_attribute) != 0;
+    uint32_t parent_group = ext2_group_of_inode(e, dir->inode->number);
+    uint32_t number = ext2_allocate_inode(fs, parent_group, is_directory);
+    if (!number) {
+        fprintf(stderr, "Could not create %s. There are no free inodes.\n",
+                name);
+        return NULL;
+    }
+
+    uint32_t now = (uint32_t)time(NULL);
+    struct ext2_inode_info *info = ext2_inode_new(fs, number);
+    info->disk.mode = ext2_mode_from_vfs_attributes(attributes);
+    info->disk.atime = info->disk.ctime = info->disk.mtime = now;
+    info->disk.links_count = is_directory ? 2 : 1;
+
+    // A new directory gets its first block straight away, holding its "."
+    // and ".." entries.
+    if (is_directory
+        && !ext2_create_directory_block(fs, info, dir->inode->number)) {
+        fprintf(stderr, "Could not create %s. The device is full.\n", name);
+        ext2_release_inode(fs, number, is_directory);
+        info->disk.links_count = 0;
+        info->disk.dtime = now;
+        return NULL;
+    }
+
+    uint32_t offset = ext2_directory_insert(fs,
+                                            dir,
+                                            name,
+                                            number,
+                                            ext2_file_type_for_mode(
+                                                info->disk.mode));
+    if (offset == NAME_INDEX_NONE) {
+        fprintf(stderr, "Could not create %s. The directory is full.\n", name);
+        ext2_release_blocks(fs, info, 0);
+        ext2_release_inode(fs, number, is_directory);
+        info->disk.links_count = 0;
+        info->disk.dtime = now;
+        info->disk.size = 0;
+        return NULL;
+    }
+
+    if (is_directory) {
+        dir->inode->disk.links_count++;
+        dir->inode->is_dirty = 1;
+    }
+    return ext2_construct_node(fs, dir, offset);
+}
+
+static vfs_node_t ext2_get_file(vfs_t fs,
+                                struct ext2_directory *dir,
+                                const char *name,
+                                uint8_t create_missing,
+                                enum vfs_node_attributes attributes)
+{
+    uint32_t offset = ext2_directory_lookup(dir, name);
+    if (offset != NAME_INDEX_NONE) {
+        return dir->nodes[offset / 4];
+    }
+    else if (!create_missing) {
+        return NULL;
+    }
+    return ext2_create_node(fs, dir, name, attributes);
+}
+
+static vfs_node_t ext2_get_node(vfs_t fs, const char *name)
+{
+    ext2_t e = fs->assoc_info;
+    return ext2_get_file(fs, e->current_dir, name, 0, 0);
+}
+
+static vfs_node_t ext2_lookup(vfs_t fs,
+                              vfs_node_t directory,
+                              const char *name)
+{
+    assert(fs);
+    assert(name);
+    return ext2_get_file(fs, ext2_directory_for(fs, directory), name, 0, 0);
+}
+
+static void ext2_create_file(vfs_t fs,
+                             const char *name,
+                             enum vfs_node_attributes a)
+{
+    ext2_t e = fs->assoc_info;
+    ext2_get_file(fs, e->current_dir, name, 1, a);
+}
+
+static vfs_node_t ext2_create_dir(vfs_t fs,
+                                  const char *name,
+                                  enum vfs_node_attributes a)
+{
+    ext2_t e = fs->assoc_info;
+    return ext2_get_file(fs,
+                         e->current_dir,
+                         name,
+                         1,
+                         a | vfs_node_directory_attribute);
+}
+
+static void ext2_remove_file(vfs_t fs, const char *name)
+{
+    ext2_t e = fs->assoc_info;
+    struct ext2_directory *dir = e->current_dir;
+
+    uint32_t offset = ext2_directory_lookup(dir, name);
+    if (offset == NAME_INDEX_NONE) {
+        return;
+    }
+    else if (!ext2_is_valid_name(name)) {
+        fprintf(stderr, "Could not remove %s.\n", name);
+        return;
+    }
+
+    // Directories have to be emptied before they can be removed, and must
+    // not linger in memory once they have been. Removing one also removes
+    // the link its ".." entry made to its parent.
+    vfs_node_t node = dir->nodes[offset / 4];
+    struct ext2_entry *entry = node->assoc_info;
+    struct ext2_inode_info *info = entry->inode;
+    uint8_t is_directory = ext2_is_directory(&info->disk);
+    if (is_directory) {
+        struct ext2_directory *sub = ext2_directory_for(fs, node);
+        for (uint32_t i = 0; i < sub->size / 4; ++i) {
+            vfs_node_t child = sub->nodes[i];
+            if (child && ext2_is_valid_name(child->name)) {
+                fprintf(stderr,
+                        "Could not remove %s. The directory is not empty.\n",
+                        name);
+                return;
+            }
+        }
+        ext2_drop_directory(fs, sub);
+        info->disk.links_count = 0;
+        if (dir->inode->disk.links_count > 1) {
+            dir->inode->disk.links_count--;
+            dir->inode->is_dirty = 1;
+        }
+    }
+    else if (info->disk.links_count > 0) {
+        info->disk.links_count--;
+    }
+
+    // The inode is only released along with its last link.
+    if (info->disk.links_count == 0) {
+        ext2_release_blocks(fs, info, 0);
+        ext2_release_inode(fs, info->number, is_directory);
+        info->disk.dtime = (uint32_t)time(NULL);
+        info->disk.size = 0;
+        info->disk.blocks = 0;
+        memset(info->disk.block, 0, sizeof(info->disk.block));
+    }
+    info->is_dirty = 1;
+
+    ext2_directory_remove(fs, dir, offset);
+    name_index_remove(&dir->names,
+                      name_hash((const uint8_t *)name,
+                                    (uint32_t)strlen(name)),
+                      offset);
+    dir->nodes[offset / 4] = NULL;
+    node->next_sibling = NULL;
+    vfs_node_destroy(node);
+}
+
+static void ext2_rename(vfs_t fs, const char *old, const char *name)
+{
+    ext2_t e = fs->assoc_info;
+    struct ext2_directory *dir = e->current_dir;
+
+    // Find the entry being renamed, and make sure the new name is not
+    // already taken.
+    uint32_t offset = ext2_directory_lookup(dir, old);
+    if (offset == NAME_INDEX_NONE) {
+        fprintf(stderr, "Could not find %s to rename.\n", old);
+        return;
+    }
+    else if (!ext2_is_valid_name(old)) {
+        fprintf(stderr, "Could not rename %s.\n", old);
+        return;
+    }
+
+    if (ext2_directory_lookup(dir, name) != NAME_INDEX_NONE) {
+        fprintf(stderr, "Could not rename %s. %s already exists.\n", old, name);
+        return;
+    }
+
+    if (!ext2_is_valid_name(name)) {
+        fprintf(stderr, "Could not rename %s. %s is not a valid name.\n",
+                old, name);
+        return;
+    }
+
+    // The new record is added before the old one is removed, so that the
+    // entry is never missing from the directory. Adding it may grow the
+    // directory, which moves its records in memory.
+    vfs_node_t node = dir->nodes[offset / 4];
+    struct ext2_entry *entry = node->assoc_info;
+    uint8_t file_type = ext2_record_at(dir, offset)->file_type;
+    uint32_t new_offset = ext2_directory_insert(fs,
+                                                dir,
+                                                name,
+                                                entry->inode->number,
+                                                file_type);
+    if (new_offset == NAME_INDEX_NONE) {
+        fprintf(stderr, "Could not rename %s. The directory is full.\n", old);
+        return;
+    }
+
+    ext2_directory_remove(fs, dir, offset);
+    name_index_remove(&dir->names,
+                      name_hash((const uint8_t *)old,
+                                    (uint32_t)strlen(old)),
+                      offset);
+    name_index_insert(&dir->names,
+                      name_hash((const uint8_t *)name,
+                                    (uint32_t)strlen(name)),
+                      new_offset);
+    dir->nodes[offset / 4] = NULL;
+    dir->nodes[new_offset / 4] = node;
+    entry->offset = new_offset;
+    vfs_node_set_name(node, name);
+    if (name[0] == '.') {
+        vfs_node_set_attribute(node, vfs_node_hidden_attribute);
+    }
+    else {
+        vfs_node_unset_attribute(node, vfs_node_hidden_attribute);
+    }
+}
+
+
+#pragma mark - File Data
+
+static void ext2_transfer_span(vfs_t fs,
+                               uint64_t position,
+                               uint8_t *data,
+                               uint32_t n,
+                               uint8_t write,
+                               uint8_t **sector_buffer)
+{
+    // Move a run of bytes that is contiguous on the device. Whole sectors of
+    // data are transferred directly, and partial sectors go through a buffer.
+    uint32_t bps = fs->device->sector_size;
+    uint32_t done = 0;
+    while (done < n) {
+        uint32_t sector = (uint32_t)((position + done) / bps);
+        uint32_t sector_offset = (uint32_t)((position + done) % bps);
+        uint32_t remaining = n - done;
+
+        if (sector_offset == 0 && remaining >= bps) {
+            uint32_t count = remaining / bps;
+            if (write) {
+                device_write_sectors(fs->device, sector, count, data + done);
+            }
+            else {
+                device_read_sectors_into(fs->device,
+                                         sector,
+                                         count,
+                                         data + done);
+            }
+            done += count * bps;
+        }
+        else {
+            uint32_t len = MIN(bps - sector_offset, remaining);
+            if (!*sector_buffer) {
+                *sector_buffer = malloc(bps);
+            }
+
+            device_read_sectors_into(fs->device, sector, 1, *sector_buffer);
+            if (write) {
+                memcpy(*sector_buffer + sector_offset, data + done, len);
+                device_write_sectors(fs->device, sector, 1, *sector_buffer);
+            }
+            else {
+                memcpy(data + done, *sector_buffer + sector_offset, len);
+            }
+            done += len;
+        }
+    }
+}
+
+static uint32_t ext2_fill_hole(vfs_t fs,
+                               vfs_node_t node,
+                               uint32_t logical)
+{
+    // A block written in the middle of a hole is allocated on its own, and
+    // cleared so that the rest of it still reads as zeros.
+    ext2_t e = fs->assoc_info;
+    struct ext2_entry *entry = node->assoc_info;
+    struct ext2_inode_info *info = entry->inode;
+    uint32_t count = 0;
+    uint32_t block = ext2_allocate_blocks(fs,
+                                          ext2_allocation_goal(fs,
+                                                               info,
+                                                               logical),
+                                          1,
+                                          &count);
+    if (!block) {
+        return 0;
+    }
+    if (!ext2_map_set(fs, info, logical, block)) {
+        ext2_release_block(fs, block);
+        return 0;
+    }
+
+    uint8_t *zeros = calloc(e->block_size, 1);
+    ext2_write_block(fs, block, zeros);
+    free(zeros);
+    info->disk.blocks += ext2_sectors_per_block_count(e);
+    ext2_discard_node_extents(node);
+    return block;
+}
+
+static uint32_t ext2_file_transfer(vfs_t fs,
+                                   vfs_node_t node,
+                                   uint8_t *data,
+                                   uint32_t n,
+                                   uint32_t offset,
+                                   uint8_t write)
+{
+    ext2_t e = fs->assoc_info;
+    struct ext2_entry *entry = node->assoc_info;
+    struct ext2_inode_info *info = entry->inode;
+    uint8_t *sector_buffer = NULL;
+
+    // Short symbolic links have no blocks to read.
+    if (ext2_is_inline_symlink(e, &info->disk)) {
+        if (write) {
+            return 0;
+        }
+        uint32_t size = info->disk.size;
+        n = offset < size ? MIN(n, size - offset) : 0;
+        memcpy(data, (uint8_t *)info->disk.block + offset, n);
+        return n;
+    }
+
+    // The file is transferred a run of contiguous blocks at a time. Holes
+    // read back as zeros, and are filled in block by block as they are
+    // written to.
+    uint32_t done = 0;
+    while (done < n) {
+        uint64_t position = (uint64_t)offset + done;
+        uint32_t logical = (uint32_t)(position / e->block_size);
+        uint32_t within = (uint32_t)(position % e->block_size);
+        uint32_t last = (uint32_t)((position + (n - done) - 1) / e->block_size);
+
+        uint32_t run = 0;
+        uint32_t block = ext2_map_block(fs,
+                                        info,
+                                        logical,
+                                        last - logical + 1,
+                                        &run);
+        if (!block && write) {
+            block = ext2_fill_hole(fs, node, logical);
+            run = 1;
+            if (!block) {
+                fprintf(stderr,
+                        "Could not write %s. There is not enough free "
+                        "space.\n",
+                        node->name);
+                break;
+            }
+        }
+
+        uint64_t available = ((uint64_t)run * e->block_size) - within;
+        uint32_t len = (uint32_t)MIN((uint64_t)(n - done), available);
+        if (!block) {
+            memset(data + done, 0, len);
+        }
+        else {
+            uint64_t start = ((uint64_t)block * e->block_size) + within;
+            ext2_transfer_span(fs,
+                               start,
+                               data + done,
+                               len,
+                               write,
+                               &sector_buffer);
+        }
+        done += len;
+    }
+
+    free(sector_buffer);
+    return done;
+}
+
+static int ext2_file_resize(vfs_t fs,
+                            vfs_node_t node,
+                            uint32_t size,
+                            uint32_t zero_until)
+{
+    ext2_t e = fs->assoc_info;
+    struct ext2_entry *entry = node->assoc_info;
+    struct ext2_inode_info *info = entry->inode;
+    uint32_t old_size = info->disk.size;
+
+    if (!ext2_resize_blocks(fs,
+                            info,
+                            ext2_blocks_for_size(e, old_size),
+                            ext2_blocks_for_size(e, size))) {
+        fprintf(stderr,
+                "Could not resize %s. There is not enough free space.\n",
+                node->name);
+        return 0;
+    }
+
+    info->disk.size = size;
+    info->is_dirty = 1;
+    ext2_discard_node_extents(node);
+    node->size = size;
+    node->is_dirty = 1;
+    vfs_node_update_modification_time(node);
+
+    // Anything between the old end of the file and the new data must read
+    // back as zeros, regardless of what the blocks previously held.
+    zero_until = MIN(zero_until, size);
+    if (zero_until > old_size) {
+        uint8_t *zeros = calloc(e->block_size, sizeof(*zeros));
+        uint32_t position = old_size;
+        while (position < zero_until) {
+            uint32_t len = MIN(e->block_size, zero_until - position);
+            ext2_file_transfer(fs, node, zeros, len, position, 1);
+            position += len;
+        }
+        free(zeros);
+    }
+    return 1;
+}
+
+static void ext2_file_write(vfs_t fs,
+                            const char *name,
+                            void *data,
+                            uint32_t n)
+{
+    assert(fs);
+
+    ext2_t e = fs->assoc_info;
+    vfs_node_t node = ext2_get_file(fs, e->current_dir, name, 1, 0);
+    if (!node) {
+        fprintf(stderr, "Could not write file. File could not be created!\n");
+        return;
+    }
+
+    struct ext2_entry *entry = node->assoc_info;
+    if (!ext2_is_regular(&entry->inode->disk)) {
+        fprintf(stderr, "Could not write %s. It is not a regular file.\n",
+                name);
+        return;
+    }
+
+    // The whole of the file is replaced, so nothing needs zeroing.
+    if (ext2_file_resize(fs, node, n, 0)) {
+        vfs_node_update_access_time(node);
+        ext2_file_transfer(fs, node, data, n, 0, 1);
+    }
+}
+
+static uint32_t ext2_file_read(vfs_t fs, const char *name, void **data)
+{
+    assert(fs);
+    assert(data);
+
+    // Get the file in question. If we can't find it then ensure data out is
+    // NULL and return 0.
+    ext2_t e = fs->assoc_info;
+    vfs_node_t node = ext2_get_file(fs, e->current_dir, name, 0, 0);
+    if (!node) {
+        *data = NULL;
+        return 0;
+    }
+
+    struct ext2_entry *entry = node->assoc_info;
+    uint32_t size = entry->inode->disk.size;
+    *data = calloc(size, sizeof(uint8_t));
+    return ext2_file_transfer(fs, node, *data, size, 0, 0);
+}
+
+
+#pragma mark - Streaming File Access
+
+static vfs_file_t ext2_open(vfs_t fs,
+                            vfs_node_t directory,
+                            const char *name,
+                            uint8_t create)
+{
+    assert(fs);
+    assert(name);
+
+    // Find the file, creating it if requested. Directories can not be opened.
+    struct ext2_directory *dir = ext2_directory_for(fs, directory);
+    vfs_node_t node = ext2_get_file(fs, dir, name, create, 0);
+    if (!node || (node->attributes & vfs_node_directory_attribute)) {
+        return NULL;
+    }
+
+    // Directories stay resident while the volume is mounted, so the node
+    // remains valid for as long as the file is open.
+    struct ext2_file *info = calloc(1, sizeof(*info));
+    info->dir = dir;
+    return vfs_file_init(fs, node, info);
+}
+
+static uint32_t ext2_pread(vfs_t fs,
+                           vfs_file_t file,
+                           void *data,
+                           uint32_t n,
+                           uint32_t offset)
+{
+    assert(fs);
+    assert(file);
+
+    vfs_node_t node = file->node;
+    if (offset >= node->size) {
+        return 0;
+    }
+
+    n = MIN(n, node->size - offset);
+    return ext2_file_transfer(fs, node, data, n, offset, 0);
+}
+
+static uint32_t ext2_pwrite(vfs_t fs,
+                            vfs_file_t file,
+                            const void *data,
+                            uint32_t n,
+                            uint32_t offset)
+{
+    assert(fs);
+    assert(file);
+
+    // Only regular files can be written. Anything else is opened for the
+    // sake of reading it.
+    vfs_node_t node = file->node;
+    struct ext2_entry *entry = node->assoc_info;
+    if (n == 0 || !ext2_is_regular(&entry->inode->disk)) {
+        return 0;
+    }
+
+    // Make sure the file is large enough to hold the data before writing.
+    uint32_t end = offset + n;
+    if (end < offset) {
+        fprintf(stderr, "Could not write beyond the maximum size of a file.\n");
+        return 0;
+    }
+    else if (end > node->size) {
+        if (!ext2_file_resize(fs, node, end, offset)) {
+            return 0;
+        }
+    }
+    else {
+        node->is_dirty = 1;
+        vfs_node_update_modification_time(node);
+    }
+
+    return ext2_file_transfer(fs, node, (uint8_t *)data, n, offset, 1);
+}
+
+static int ext2_truncate(vfs_t fs, vfs_file_t file, uint32_t size)
+{
+    assert(fs);
+    assert(file);
+
+    struct ext2_entry *entry = file->node->assoc_info;
+    if (!ext2_is_regular(&entry->inode->disk)) {
+        return 0;
+    }
+    return ext2_file_resize(fs, file->node, size, size);
+}
+
+static void ext2_close(vfs_t fs, vfs_file_t file)
+{
+    assert(fs);
+    assert(file);
+
+    // Metadata changes made through the file are written back along with
+    // everything else when the filesystem is next synced.
+    free(file->assoc_info);
+    file->assoc_info = NULL;
+}
+
+
+#pragma mark - Metadata Flushing
+
+static void ext2_flush_descriptors(vfs_t fs)
+{
+    ext2_t e = fs->assoc_info;
+    if (e->descriptors_dirty) {
+        uint32_t first = e->superblock->first_data_block + 1;
+        device_write_sectors(fs->device,
+                             ext2_block_sector(e, first),
+                             e->descriptor_blocks * e->sectors_per_block,
+                             (uint8_t *)e->descriptors);
+        e->descriptors_dirty = 0;
+    }
+    if (e->superblock_dirty) {
+        e->superblock->wtime = (uint32_t)time(NULL);
+        ext2_write_bytes(fs->device,
+                         EXT2_SUPERBLOCK_OFFSET,
+                         sizeof(*e->superblock),
+                         e->superblock);
+        e->superblock_dirty = 0;
+    }
+}
+
+static void ext2_flush(vfs_t fs)
+{
+    ext2_t e = fs->assoc_info;
+    ext2_flush_directory(fs, e->current_dir);
+    ext2_flush_inodes(fs);
+    ext2_flush_bitmaps(fs);
+    ext2_flush_descriptors(fs);
+}
+
+static void ext2_sync(vfs_t fs)
+{
+    assert(fs);
+    ext2_t e = fs->assoc_info;
+
+    // Only write back the structures that have actually been modified since
+    // they were last written to the device. Directories go first, as they
+    // bring the inodes of their entries up to date.
+    struct ext2_directory *dir = e->directories;
+    while (dir) {
+        ext2_flush_directory(fs, dir);
+        dir = dir->next;
+    }
+    ext2_flush_inodes(fs);
+    ext2_flush_bitmaps(fs);
+    ext2_flush_descriptors(fs);
+}
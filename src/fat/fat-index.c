@@ -0,0 +1,104 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fat/fat-index.h>
+
+#define FAT_TAIL_INDEX_MIN_CAPACITY 16
+
+
+#pragma mark - Numeric Tail Index
+
+static void fat_tail_index_allocate(struct fat_tail_index *index,
+                                    uint32_t capacity)
+{
+    // A slot with no next tail is empty, as tails start from one.
+    index->capacity = capacity;
+    index->count = 0;
+    index->slots = calloc(capacity, sizeof(*index->slots));
+}
+
+void fat_tail_index_destroy(struct fat_tail_index *index)
+{
+    if (index) {
+        free(index->slots);
+        index->slots = NULL;
+        index->capacity = 0;
+        index->count = 0;
+    }
+}
+
+static struct fat_tail_slot *fat_tail_index_slot(struct fat_tail_index *index,
+                                                 const uint8_t *basis)
+{
+    // The table is never more than half full, so an empty slot is guaranteed
+    // to terminate the probe.
+    uint32_t mask = index->capacity - 1;
+    uint32_t i = name_hash(basis, 11) & mask;
+    while (index->slots[i].next != 0
+           && memcmp(index->slots[i].basis, basis, 11) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &index->slots[i];
+}
+
+static void fat_tail_index_grow(struct fat_tail_index *index)
+{
+    struct fat_tail_slot *old_slots = index->slots;
+    uint32_t old_capacity = index->capacity;
+
+    fat_tail_index_allocate(index, old_capacity << 1);
+    for (uint32_t i = 0; i < old_capacity; ++i) {
+        if (old_slots[i].next != 0) {
+            *fat_tail_index_slot(index, old_slots[i].basis) = old_slots[i];
+            index->count++;
+        }
+    }
+
+    free(old_slots);
+}
+
+uint32_t *fat_tail_index_next(struct fat_tail_index *index,
+                              const uint8_t *basis)
+{
+    assert(index);
+    assert(basis);
+
+    if (!index->slots) {
+        fat_tail_index_allocate(index, FAT_TAIL_INDEX_MIN_CAPACITY);
+    }
+    else if ((index->count + 1) * 2 > index->capacity) {
+        fat_tail_index_grow(index);
+    }
+
+    // A basis that has not been seen before starts from a tail of one.
+    struct fat_tail_slot *slot = fat_tail_index_slot(index, basis);
+    if (slot->next == 0) {
+        memcpy(slot->basis, basis, sizeof(slot->basis));
+        slot->next = 1;
+        index->count++;
+    }
+    return &slot->next;
+}
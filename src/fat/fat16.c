@@ -0,0 +1,83 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <fat/fat16.h>
+
+
+#pragma mark - FAT16 Table Entries
+
+typedef uint16_t fat_cluster_t;
+
+#define FAT_WIDTH  16
+#define FAT_TYPE_NAME  "FAT16"
+#define FAT_MIN_CLUSTERS  4085
+#define FAT_MAX_CLUSTERS  65524
+#define FAT_CLUSTER_EOF  0xffff
+#define FAT_CLUSTER_EOF_MIN  0xfff8
+#define FAT_TABLE_PAGE_SECTORS  8
+
+// Each entry is a little endian 16-bit value.
+static inline uint32_t fat_table_bytes(uint32_t entries)
+{
+    return entries * 2;
+}
+
+static inline uint32_t fat_table_entries(uint32_t bytes)
+{
+    return bytes / 2;
+}
+
+static inline fat_cluster_t fat_unpack_entry(const uint8_t *fat_data,
+                                             uint32_t entry)
+{
+    uint32_t off = entry * 2;
+    return fat_data[off] | (fat_data[off+1] << 8);
+}
+
+static inline void fat_pack_entry(uint8_t *fat_data,
+                                  uint32_t entry,
+                                  fat_cluster_t value)
+{
+    assert(fat_data);
+
+    uint32_t off = entry * 2;
+    fat_data[off] = value & 0xFF;
+    fat_data[off+1] = (value >> 8) & 0xFF;
+}
+
+#include "fat-engine.inc"
+
+
+#pragma mark - FAT16 Driver
+
+vfs_interface_t fat16_init()
+{
+    return fat_init();
+}
+
+uint8_t fat16_test(vdevice_t dev, fat_bpb_t *bpb_out)
+{
+    return fat_test(dev, bpb_out);
+}
@@ -0,0 +1,93 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <fat/fat32.h>
+
+
+#pragma mark - FAT32 Table Entries
+
+typedef fat32_extended_bpb_t fat_bpb_t;
+typedef fat32_t fat_t;
+typedef uint32_t fat_cluster_t;
+
+#define FAT_WIDTH  32
+#define FAT_TYPE_NAME  "FAT32"
+#define FAT_MIN_CLUSTERS  65525
+#define FAT_MAX_CLUSTERS  0x0FFFFFF5
+#define FAT_CLUSTER_EOF  0x0FFFFFFF
+#define FAT_CLUSTER_EOF_MIN  0x0FFFFFF8
+#define FAT_TABLE_PAGE_SECTORS  8
+
+// Each entry is a little endian 32-bit value, of which only the low 28 bits
+// belong to the entry. The top 4 bits are reserved and must be preserved
+// when the entry is written.
+static inline uint32_t fat_table_bytes(uint32_t entries)
+{
+    return entries * 4;
+}
+
+static inline uint32_t fat_table_entries(uint32_t bytes)
+{
+    return bytes / 4;
+}
+
+static inline fat_cluster_t fat_unpack_entry(const uint8_t *fat_data,
+                                             uint32_t entry)
+{
+    uint32_t off = entry * 4;
+    uint32_t value = (uint32_t)fat_data[off]
+                   | ((uint32_t)fat_data[off+1] << 8)
+                   | ((uint32_t)fat_data[off+2] << 16)
+                   | ((uint32_t)fat_data[off+3] << 24);
+    return value & 0x0FFFFFFF;
+}
+
+static inline void fat_pack_entry(uint8_t *fat_data,
+                                  uint32_t entry,
+                                  fat_cluster_t value)
+{
+    assert(fat_data);
+
+    uint32_t off = entry * 4;
+    fat_data[off] = value & 0xFF;
+    fat_data[off+1] = (value >> 8) & 0xFF;
+    fat_data[off+2] = (value >> 16) & 0xFF;
+    fat_data[off+3] = (fat_data[off+3] & 0xF0) | ((value >> 24) & 0x0F);
+}
+
+#include "fat-engine.inc"
+
+
+#pragma mark - FAT32 Driver
+
+vfs_interface_t fat32_init()
+{
+    return fat_init();
+}
+
+uint8_t fat32_test(vdevice_t dev, fat_bpb_t *bpb_out)
+{
+    return fat_test(dev, bpb_out);
+}
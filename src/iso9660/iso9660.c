@@ -0,0 +1,1148 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <iso9660/iso9660.h>
+
+#include <vfs/vfs.h>
+#include <vfs/node.h>
+#include <vfs/extent.h>
+#include <vfs/file.h>
+
+
+#ifdef MIN
+#   undef MIN
+#endif
+
+#define MIN(a,b) \
+    ({ __typeof__ (a) _a = (a); \
+       __typeof__ (b) _b = (b); \
+       _a < _b ? _a : _b; })
+
+
+#pragma mark - ISO 9660 Constants
+
+// Logical blocks may be any power of two from 512 bytes up to the size of a
+// sector, although anything other than 2048 is rarely seen.
+#define ISO9660_MIN_BLOCK_SIZE  512
+#define ISO9660_MAX_BLOCK_SIZE  ISO9660_DESCRIPTOR_SECTOR_SIZE
+
+// The set of volume descriptors is searched this far for its terminator
+// before the volume is considered damaged.
+#define ISO9660_MAX_DESCRIPTORS  64
+
+// A record name is at most 255 bytes. As UCS-2 that converts to at most 383
+// bytes of UTF-8.
+#define ISO9660_NAME_BUFFER  512
+
+#define ISO9660_ARENA_BLOCK_SIZE  (64 * 1024)
+#define ISO9660_MIN_DIRECTORIES  16
+
+
+#pragma mark - VFS Interface (Prototypes)
+
+static const char *iso9660_name();
+
+static void *iso9660_mount(vfs_t fs);
+static void iso9660_unmount(vfs_t fs);
+
+static void iso9660_format_device(
+    vdevice_t dev,
+    const char *label,
+    uint8_t *bootcode,
+    uint8_t *reserved_data,
+    uint16_t additional_reserved_sectors
+);
+
+static vfs_node_t iso9660_current_directory(vfs_t fs);
+static vfs_node_t iso9660_get_directory_list(vfs_t fs);
+static vfs_node_t iso9660_list_directory(vfs_t fs, vfs_node_t directory);
+static void iso9660_set_directory(vfs_t fs, vfs_node_t directory);
+
+static vfs_node_t iso9660_get_node(vfs_t fs, const char *name);
+static vfs_node_t iso9660_lookup(vfs_t fs,
+                                 vfs_node_t directory,
+                                 const char *name);
+
+static void iso9660_file_write(vfs_t fs,
+                               const char *name,
+                               void *data,
+                               uint32_t n);
+static uint32_t iso9660_file_read(vfs_t fs, const char *name, void **data);
+static vfs_extent_list_t iso9660_node_extents(vfs_t fs, vfs_node_t node);
+
+static vfs_file_t iso9660_open(vfs_t fs,
+                               vfs_node_t directory,
+                               const char *name,
+                               uint8_t create);
+static uint32_t iso9660_pread(vfs_t fs,
+                              vfs_file_t file,
+                              void *data,
+                              uint32_t n,
+                              uint32_t offset);
+static uint32_t iso9660_pwrite(vfs_t fs,
+                               vfs_file_t file,
+                               const void *data,
+                               uint32_t n,
+                               uint32_t offset);
+static int iso9660_truncate(vfs_t fs, vfs_file_t file, uint32_t size);
+static void iso9660_close(vfs_t fs, vfs_file_t file);
+
+static void iso9660_create_file(vfs_t, const char *, enum vfs_node_attributes);
+static vfs_node_t iso9660_create_dir(vfs_t fs,
+                                     const char *name,
+                                     enum vfs_node_attributes a);
+
+static void iso9660_remove_file(vfs_t fs, const char *name);
+static void iso9660_rename(vfs_t fs, const char *old, const char *name);
+
+static void iso9660_flush(vfs_t fs);
+static void iso9660_sync(vfs_t fs);
+
+
+#pragma mark - VFS Interface Creation
+
+vfs_interface_t iso9660_init()
+{
+    vfs_interface_t fs = vfs_interface_init();
+
+    fs->type_name = iso9660_name;
+
+    fs->mount_filesystem = iso9660_mount;
+    fs->unmount_filesystem = iso9660_unmount;
+
+    // Volumes are only ever read. The operations that would modify one are
+    // present so that they can report as much.
+    fs->format_device = iso9660_format_device;
+
+    fs->current_directory = iso9660_current_directory;
+    fs->get_directory_list = iso9660_get_directory_list;
+    fs->list_directory = iso9660_list_directory;
+    fs->set_directory = iso9660_set_directory;
+    fs->get_node = iso9660_get_node;
+    fs->lookup = iso9660_lookup;
+
+    fs->write = iso9660_file_write;
+    fs->read = iso9660_file_read;
+    fs->extents = iso9660_node_extents;
+
+    fs->open = iso9660_open;
+    fs->pread = iso9660_pread;
+    fs->pwrite = iso9660_pwrite;
+    fs->truncate = iso9660_truncate;
+    fs->close = iso9660_close;
+
+    fs->create_file = iso9660_create_file;
+    fs->create_dir = iso9660_create_dir;
+
+    fs->remove = iso9660_remove_file;
+    fs->rename = iso9660_rename;
+
+    fs->flush_directory = iso9660_flush;
+    fs->sync = iso9660_sync;
+
+    return fs;
+}
+
+
+#pragma mark - ISO 9660 Calculations
+
+static uint32_t iso9660_blocks_for_size(iso9660_t iso, uint32_t size)
+{
+    return (uint32_t)(((uint64_t)size + iso->block_size - 1) / iso->block_size);
+}
+
+static uint64_t iso9660_block_offset(iso9660_t iso, uint32_t block)
+{
+    return (uint64_t)block * iso->block_size;
+}
+
+static int iso9660_is_within_volume(iso9660_t iso,
+                                    uint32_t block,
+                                    uint32_t size)
+{
+    uint64_t end = (uint64_t)block + iso9660_blocks_for_size(iso, size);
+    return end <= iso->descriptor->space_size.le;
+}
+
+static uint32_t iso9660_path_hash(uint32_t parent, const char *name)
+{
+    // Directory names are unique within their parent, so the path table is
+    // indexed by the two together.
+    return folded_name_hash(name) ^ (parent * 2654435761u);
+}
+
+static time_t iso9660_time(const uint8_t *date)
+{
+    // Dates are recorded as years since 1900, and carry their offset from
+    // GMT in 15 minute intervals.
+    if (date[0] == 0 && date[1] == 0 && date[2] == 0) {
+        return 0;
+    }
+
+    struct tm tm = { 0 };
+    tm.tm_year = date[0];
+    tm.tm_mon = date[1] - 1;
+    tm.tm_mday = date[2];
+    tm.tm_hour = date[3];
+    tm.tm_min = date[4];
+    tm.tm_sec = date[5];
+    return timegm(&tm) - ((int8_t)date[6] * 15 * 60);
+}
+
+static enum vfs_node_attributes iso9660_translate_to_vfs_attributes(
+    uint8_t flags
+) {
+    enum vfs_node_attributes attributes = vfs_node_read_only_attribute;
+    if (flags & iso9660_flag_hidden) {
+        attributes |= vfs_node_hidden_attribute;
+    }
+    if (flags & iso9660_flag_directory) {
+        attributes |= vfs_node_directory_attribute;
+    }
+    return attributes;
+}
+
+
+#pragma mark - Names
+
+static uint32_t iso9660_utf8_encode(uint32_t c, char *out)
+{
+    if (c < 0x80) {
+        out[0] = (char)c;
+        return 1;
+    }
+    else if (c < 0x800) {
+        out[0] = (char)(0xC0 | (c >> 6));
+        out[1] = (char)(0x80 | (c & 0x3F));
+        return 2;
+    }
+    else if (c < 0x10000) {
+        out[0] = (char)(0xE0 | (c >> 12));
+        out[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (c & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (c >> 18));
+    out[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (c & 0x3F));
+    return 4;
+}
+
+static void iso9660_convert_name(iso9660_t iso,
+                                 const char *raw,
+                                 uint32_t length,
+                                 char *name)
+{
+    // Joliet names are big endian UCS-2, which is converted to UTF-8 with
+    // any surrogate pairs combined. Otherwise the name is used as recorded.
+    uint32_t n = 0;
+    if (iso->is_joliet) {
+        const uint8_t *units = (const uint8_t *)raw;
+        for (uint32_t i = 0; i + 1 < length; i += 2) {
+            uint32_t c = (units[i] << 8) | units[i + 1];
+            if (c >= 0xD800 && c < 0xDC00 && i + 3 < length) {
+                uint32_t low = (units[i + 2] << 8) | units[i + 3];
+                if (low >= 0xDC00 && low < 0xE000) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    i += 2;
+                }
+            }
+            n += iso9660_utf8_encode(c, name + n);
+        }
+    }
+    else {
+        memcpy(name, raw, length);
+        n = length;
+    }
+    name[n] = '\0';
+
+    // Drop the version number from the name of a file, along with the
+    // separator left behind when a file has no extension.
+    char *version = strrchr(name, ';');
+    if (version) {
+        *version = '\0';
+    }
+    n = (uint32_t)strlen(name);
+    if (n > 1 && name[n - 1] == '.') {
+        name[n - 1] = '\0';
+    }
+}
+
+
+#pragma mark - Device Access
+
+static void iso9660_read_bytes(vdevice_t dev,
+                               uint64_t offset,
+                               uint32_t n,
+                               uint8_t *data)
+{
+    // Whole sectors are read straight into the destination, and only the
+    // partial sectors at either end go through a sector sized buffer.
+    uint32_t bps = dev->sector_size;
+    uint32_t sector = (uint32_t)(offset / bps);
+    uint32_t skip = (uint32_t)(offset % bps);
+    uint8_t *buffer = NULL;
+
+    while (n > 0) {
+        if (skip == 0 && n >= bps) {
+            uint32_t count = n / bps;
+            device_read_sectors_into(dev, sector, count, data);
+            sector += count;
+            data += (size_t)count * bps;
+            n -= count * bps;
+        }
+        else {
+            if (!buffer) {
+                buffer = malloc(bps);
+            }
+            uint32_t length = MIN(bps - skip, n);
+            device_read_sectors_into(dev, sector, 1, buffer);
+            memcpy(data, buffer + skip, length);
+            sector++;
+            data += length;
+            n -= length;
+            skip = 0;
+        }
+    }
+    free(buffer);
+}
+
+
+#pragma mark - Path Table
+
+static struct iso9660_directory *iso9660_find_directory(iso9660_t iso,
+                                                        uint32_t parent,
+                                                        const char *name)
+{
+    uint32_t cursor = 0;
+    uint32_t hash = iso9660_path_hash(parent, name);
+    uint32_t i = name_index_first(&iso->paths, hash, &cursor);
+    while (i != NAME_INDEX_NONE) {
+        struct iso9660_directory *dir = &iso->directories[i];
+        if (dir->parent == parent && strcasecmp(dir->name, name) == 0) {
+            return dir;
+        }
+        i = name_index_next(&iso->paths, hash, &cursor);
+    }
+    return NULL;
+}
+
+static int iso9660_load_path_table(vfs_t fs)
+{
+    iso9660_t iso = fs->assoc_info;
+    uint32_t size = iso->descriptor->path_table_size.le;
+    uint32_t block = iso->descriptor->l_path_table;
+    if (size < ISO9660_PATH_RECORD_HEADER
+        || !iso9660_is_within_volume(iso, block, size)) {
+        return 0;
+    }
+
+    uint8_t *table = calloc(size, 1);
+    iso9660_read_bytes(fs->device,
+                       iso9660_block_offset(iso, block),
+                       size,
+                       table);
+
+    // Every directory on the volume is listed here, and a parent is always
+    // listed before any of its children. The directories are numbered from
+    // one, and are kept here numbered from zero.
+    uint32_t capacity = ISO9660_MIN_DIRECTORIES;
+    iso->directories = calloc(capacity, sizeof(*iso->directories));
+    name_index_init(&iso->paths, size / 16);
+
+    uint32_t offset = 0;
+    int valid = 1;
+    while (offset + ISO9660_PATH_RECORD_HEADER <= size) {
+        struct iso9660_path_record *record = (void *)(table + offset);
+        uint32_t length = record->name_length;
+        uint32_t number = iso->directory_count + 1;
+        if (length == 0
+            || offset + ISO9660_PATH_RECORD_HEADER + length > size
+            || record->parent == 0
+            || record->parent > number
+            || (number != ISO9660_ROOT_DIRECTORY && record->parent == number)
+            || !iso9660_is_within_volume(iso, record->extent, 1)) {
+            valid = 0;
+            break;
+        }
+
+        if (iso->directory_count == capacity) {
+            capacity *= 2;
+            iso->directories = realloc(iso->directories,
+                                       capacity * sizeof(*iso->directories));
+        }
+
+        char name[ISO9660_NAME_BUFFER];
+        if (number == ISO9660_ROOT_DIRECTORY) {
+            name[0] = '\0';
+        }
+        else {
+            iso9660_convert_name(iso, record->name, length, name);
+        }
+
+        struct iso9660_directory *dir = &iso->directories[number - 1];
+        memset(dir, 0, sizeof(*dir));
+        dir->parent = record->parent - 1;
+        dir->block = record->extent + record->ext_attr_length;
+        dir->name = arena_strdup(&iso->arena, name);
+        if (number != ISO9660_ROOT_DIRECTORY) {
+            name_index_insert(&iso->paths,
+                              iso9660_path_hash(dir->parent, name),
+                              number - 1);
+        }
+        iso->directory_count = number;
+
+        offset += ISO9660_PATH_RECORD_HEADER + length + (length & 1);
+    }
+
+    free(table);
+    return valid && iso->directory_count > 0;
+}
+
+
+#pragma mark - Directories
+
+static vfs_node_t iso9660_directory_node(vfs_t fs,
+                                         struct iso9660_directory *dir)
+{
+    // Each directory has a single node, whether it is reached through the
+    // path table or by listing its parent.
+    iso9660_t iso = fs->assoc_info;
+    if (!dir->node) {
+        struct iso9660_entry *entry = arena_alloc(&iso->arena,
+                                                  sizeof(*entry));
+        entry->directory = dir;
+        entry->section_count = 0;
+        dir->node = vfs_node_init_in_arena(
+            &iso->arena,
+            fs,
+            dir->name,
+            vfs_node_read_only_attribute | vfs_node_directory_attribute,
+            vfs_node_used,
+            entry
+        );
+    }
+    return dir->node;
+}
+
+static void iso9660_directory_add(struct iso9660_directory *dir,
+                                  vfs_node_t node,
+                                  uint32_t *capacity)
+{
+    if (dir->count == *capacity) {
+        *capacity *= 2;
+        dir->nodes = realloc(dir->nodes, *capacity * sizeof(*dir->nodes));
+    }
+    name_index_insert(&dir->names,
+                      folded_name_hash(node->name),
+                      dir->count);
+    dir->nodes[dir->count++] = node;
+}
+
+static vfs_node_t iso9660_construct_file(vfs_t fs,
+                                         const char *name,
+                                         const struct iso9660_dir_record *r,
+                                         const struct iso9660_section *sections,
+                                         uint32_t count)
+{
+    iso9660_t iso = fs->assoc_info;
+    uint64_t size = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        size += sections[i].size;
+    }
+    if (size > UINT32_MAX) {
+        fprintf(stderr, "Skipping %s. It is too large to be read.\n", name);
+        return NULL;
+    }
+
+    struct iso9660_entry *entry = arena_alloc(
+        &iso->arena,
+        sizeof(*entry) + (count * sizeof(*sections))
+    );
+    entry->directory = NULL;
+    entry->section_count = count;
+    memcpy(entry->sections, sections, count * sizeof(*sections));
+
+    vfs_node_t node = vfs_node_init_in_arena(
+        &iso->arena,
+        fs,
+        name,
+        iso9660_translate_to_vfs_attributes(r->flags),
+        vfs_node_used,
+        entry
+    );
+    node->size = (uint32_t)size;
+    return node;
+}
+
+static void iso9660_load_directory(vfs_t fs, struct iso9660_directory *dir)
+{
+    iso9660_t iso = fs->assoc_info;
+    uint32_t index = (uint32_t)(dir - iso->directories);
+    dir->is_loaded = 1;
+
+    // The size of the directory is only recorded in its own "." record, at
+    // the very start of it.
+    uint8_t *data = malloc(iso->block_size);
+    iso9660_read_bytes(fs->device,
+                       iso9660_block_offset(iso, dir->block),
+                       iso->block_size,
+                       data);
+    struct iso9660_dir_record *self = (void *)data;
+    uint32_t size = self->size.le;
+    if (self->length < ISO9660_DIR_RECORD_HEADER
+        || !iso9660_is_within_volume(iso, dir->block, size)) {
+        fprintf(stderr, "Skipping a damaged directory.\n");
+        size = 0;
+    }
+    size = iso9660_blocks_for_size(iso, size) * iso->block_size;
+    if (size > iso->block_size) {
+        data = realloc(data, size);
+        iso9660_read_bytes(fs->device,
+                           iso9660_block_offset(iso, dir->block),
+                           size,
+                           data);
+    }
+
+    uint32_t capacity = (size / 64) + 4;
+    dir->nodes = calloc(capacity, sizeof(*dir->nodes));
+    name_index_init(&dir->names, capacity);
+
+    // A file may be recorded in several sections, each with a record of its
+    // own. The sections are gathered up until the last of them is found.
+    uint32_t section_capacity = 4;
+    uint32_t section_count = 0;
+    struct iso9660_section *sections = calloc(section_capacity,
+                                              sizeof(*sections));
+
+    uint32_t offset = 0;
+    while (offset < size) {
+        struct iso9660_dir_record *r = (void *)(data + offset);
+        uint32_t remaining = iso->block_size - (offset % iso->block_size);
+        if (remaining < ISO9660_DIR_RECORD_HEADER || r->length == 0) {
+            offset += remaining;
+            continue;
+        }
+        if (r->length < ISO9660_DIR_RECORD_HEADER + r->name_length
+            || r->length > remaining) {
+            fprintf(stderr, "Skipping a damaged block in a directory.\n");
+            offset += remaining;
+            continue;
+        }
+        offset += r->length;
+
+        // The "." and ".." records, and associated files, are not listed.
+        if ((r->name_length == 1 && (uint8_t)r->name[0] <= 1)
+            || (r->flags & iso9660_flag_associated)) {
+            continue;
+        }
+
+        char name[ISO9660_NAME_BUFFER];
+        iso9660_convert_name(iso, r->name, r->name_length, name);
+
+        vfs_node_t node = NULL;
+        if (r->flags & iso9660_flag_directory) {
+            struct iso9660_directory *child = iso9660_find_directory(iso,
+                                                                     index,
+                                                                     name);
+            if (!child) {
+                fprintf(stderr,
+                        "Skipping %s. It is missing from the path table.\n",
+                        name);
+                continue;
+            }
+            node = iso9660_directory_node(fs, child);
+            node->attributes = iso9660_translate_to_vfs_attributes(r->flags);
+        }
+        else {
+            uint32_t block = r->extent.le + r->ext_attr_length;
+            if (r->unit_size || r->interleave_gap) {
+                fprintf(stderr,
+                        "Skipping %s. Interleaved files are not supported.\n",
+                        name);
+                continue;
+            }
+            if (!iso9660_is_within_volume(iso, block, r->size.le)) {
+                fprintf(stderr, "Skipping %s. It is damaged.\n", name);
+                section_count = 0;
+                continue;
+            }
+
+            if (section_count == section_capacity) {
+                section_capacity *= 2;
+                sections = realloc(sections,
+                                   section_capacity * sizeof(*sections));
+            }
+            sections[section_count].block = block;
+            sections[section_count].size = r->size.le;
+            section_count++;
+            if (r->flags & iso9660_flag_multi_extent) {
+                continue;
+            }
+
+            node = iso9660_construct_file(fs, name, r, sections, section_count);
+            section_count = 0;
+            if (!node) {
+                continue;
+            }
+        }
+
+        node->creation_time = iso9660_time(r->date);
+        node->modification_time = node->creation_time;
+        node->access_time = node->creation_time;
+        iso9660_directory_add(dir, node, &capacity);
+    }
+
+    dir->end = vfs_node_init_in_arena(&iso->arena,
+                                      fs,
+                                      "",
+                                      0,
+                                      vfs_node_unused,
+                                      NULL);
+    free(sections);
+    free(data);
+}
+
+static struct iso9660_directory *iso9660_directory_for(vfs_t fs,
+                                                       vfs_node_t directory)
+{
+    // A NULL directory is the root directory. A node that is not a directory
+    // has no directory to return.
+    iso9660_t iso = fs->assoc_info;
+    if (!directory) {
+        return &iso->directories[ISO9660_ROOT_DIRECTORY - 1];
+    }
+    struct iso9660_entry *entry = directory->assoc_info;
+    return entry ? entry->directory : NULL;
+}
+
+static vfs_node_t iso9660_directory_list(vfs_t fs,
+                                         struct iso9660_directory *dir)
+{
+    if (!dir->is_loaded) {
+        iso9660_load_directory(fs, dir);
+    }
+
+    // Link together the nodes in the order their records appear, finishing
+    // with the end of directory marker.
+    vfs_node_t prev = NULL;
+    for (uint32_t i = 0; i < dir->count; ++i) {
+        vfs_node_t node = dir->nodes[i];
+        node->prev_sibling = prev;
+        if (prev) {
+            prev->next_sibling = node;
+        }
+        prev = node;
+    }
+
+    dir->end->prev_sibling = prev;
+    dir->end->next_sibling = NULL;
+    if (prev) {
+        prev->next_sibling = dir->end;
+    }
+    return dir->count ? dir->nodes[0] : dir->end;
+}
+
+static vfs_node_t iso9660_find(vfs_t fs,
+                               struct iso9660_directory *dir,
+                               const char *name)
+{
+    // Directories are found through the path table, so that resolving a
+    // path never needs to read the directories along it. Only files need
+    // the records of their directory.
+    iso9660_t iso = fs->assoc_info;
+    uint32_t index = (uint32_t)(dir - iso->directories);
+    struct iso9660_directory *child = iso9660_find_directory(iso,
+                                                             index,
+                                                             name);
+    if (child) {
+        return iso9660_directory_node(fs, child);
+    }
+
+    if (!dir->is_loaded) {
+        iso9660_load_directory(fs, dir);
+    }
+
+    uint32_t cursor = 0;
+    uint32_t hash = folded_name_hash(name);
+    uint32_t i = name_index_first(&dir->names, hash, &cursor);
+    while (i != NAME_INDEX_NONE) {
+        if (strcasecmp(dir->nodes[i]->name, name) == 0) {
+            return dir->nodes[i];
+        }
+        i = name_index_next(&dir->names, hash, &cursor);
+    }
+    return NULL;
+}
+
+
+#pragma mark - Extents
+
+static vfs_extent_list_t iso9660_node_extents(vfs_t fs, vfs_node_t node)
+{
+    assert(fs);
+    assert(node);
+
+    // The sections of a file map directly on to runs of device sectors.
+    // Every section other than the last is a whole number of blocks, so the
+    // runs follow on from one another within the file.
+    iso9660_t iso = fs->assoc_info;
+    if (!node->extents) {
+        struct iso9660_entry *entry = node->assoc_info;
+        node->extents = vfs_extent_list_init();
+        for (uint32_t i = 0; i < entry->section_count; ++i) {
+            const struct iso9660_section *section = &entry->sections[i];
+            uint32_t blocks = iso9660_blocks_for_size(iso, section->size);
+            if (blocks > 0) {
+                vfs_extent_list_append(node->extents,
+                                       section->block * iso->sectors_per_block,
+                                       blocks * iso->sectors_per_block);
+            }
+        }
+    }
+    return node->extents;
+}
+
+
+#pragma mark - ISO 9660 Formatting
+
+static void iso9660_format_device(
+    vdevice_t dev,
+    const char *label,
+    uint8_t *bootcode,
+    uint8_t *reserved_data,
+    uint16_t additional_reserved_sectors
+) {
+    (void)dev;
+    (void)label;
+    (void)bootcode;
+    (void)reserved_data;
+    (void)additional_reserved_sectors;
+    fprintf(stderr, "ISO 9660 volumes can only be read.\n");
+}
+
+
+#pragma mark - ISO 9660 File System
+
+static const char *iso9660_name()
+{
+    return "iso9660";
+}
+
+static int iso9660_is_joliet(const struct iso9660_volume_descriptor *vd)
+{
+    // The escape sequences select UCS-2 at one of its three levels.
+    const uint8_t *escape = vd->escape_sequences;
+    return vd->type == iso9660_supplementary_descriptor
+        && escape[0] == '%'
+        && escape[1] == '/'
+        && (escape[2] == '@' || escape[2] == 'C' || escape[2] == 'E');
+}
+
+uint8_t iso9660_test(vdevice_t dev, iso9660_descriptor_t *descriptor_out)
+{
+    if (!dev || ISO9660_DESCRIPTOR_SECTOR_SIZE % dev->sector_size) {
+        return 0;
+    }
+
+    // Walk the volume descriptors up to their terminator. The Joliet
+    // descriptor is preferred when there is one, as its names are not
+    // restricted to upper case 8.3.
+    uint64_t device_size = (uint64_t)device_total_sectors(dev)
+                         * dev->sector_size;
+    iso9660_descriptor_t primary = NULL;
+    iso9660_descriptor_t joliet = NULL;
+    iso9660_descriptor_t vd = malloc(sizeof(*vd));
+    int terminated = 0;
+    for (uint32_t i = 0; i < ISO9660_MAX_DESCRIPTORS && !terminated; ++i) {
+        uint64_t offset = (uint64_t)(ISO9660_FIRST_DESCRIPTOR + i)
+                        * ISO9660_DESCRIPTOR_SECTOR_SIZE;
+        if (offset + sizeof(*vd) > device_size) {
+            break;
+        }
+
+        iso9660_read_bytes(dev, offset, sizeof(*vd), (uint8_t *)vd);
+        if (memcmp(vd->standard_id, ISO9660_STANDARD_ID, 5) != 0) {
+            break;
+        }
+        else if (vd->type == iso9660_descriptor_terminator) {
+            terminated = 1;
+        }
+        else if (vd->type == iso9660_primary_descriptor && !primary) {
+            primary = vd;
+            vd = malloc(sizeof(*vd));
+        }
+        else if (iso9660_is_joliet(vd) && !joliet) {
+            joliet = vd;
+            vd = malloc(sizeof(*vd));
+        }
+    }
+    free(vd);
+
+    // The volume has to fit on the device, and its blocks have to be made up
+    // of whole device sectors.
+    vd = joliet ? joliet : primary;
+    uint32_t block_size = vd ? vd->block_size.le : 0;
+    int valid = terminated
+             && vd
+             && block_size >= ISO9660_MIN_BLOCK_SIZE
+             && block_size <= ISO9660_MAX_BLOCK_SIZE
+             && (block_size & (block_size - 1)) == 0
+             && block_size % dev->sector_size == 0
+             && (uint64_t)vd->space_size.le * block_size <= device_size;
+
+    // Only the descriptor that is used is kept.
+    free(vd == primary ? joliet : primary);
+    if (valid && descriptor_out) {
+        *descriptor_out = vd;
+    }
+    else {
+        free(vd);
+    }
+    return valid;
+}
+
+static void *iso9660_mount(vfs_t fs)
+{
+    iso9660_descriptor_t vd = NULL;
+    if (!iso9660_test(fs->device, &vd)) {
+        return NULL;
+    }
+
+    // The volume needs to be reachable through the file system while it is
+    // being mounted.
+    iso9660_t iso = calloc(1, sizeof(*iso));
+    iso->descriptor = vd;
+    iso->block_size = vd->block_size.le;
+    iso->sectors_per_block = iso->block_size / fs->device->sector_size;
+    iso->is_joliet = iso9660_is_joliet(vd);
+    arena_init(&iso->arena, ISO9660_ARENA_BLOCK_SIZE);
+    fs->assoc_info = iso;
+
+    if (!iso9660_load_path_table(fs)) {
+        fprintf(stderr, "The ISO 9660 path table is damaged.\n");
+        iso9660_unmount(fs);
+        return NULL;
+    }
+
+    iso->current_dir = &iso->directories[ISO9660_ROOT_DIRECTORY - 1];
+    return iso;
+}
+
+static void iso9660_unmount(vfs_t fs)
+{
+    if (fs) {
+        iso9660_t iso = fs->assoc_info;
+        if (iso) {
+            // The nodes live in the arena, but any extents built for them
+            // do not. Every directory node belongs to exactly one directory,
+            // and is released through it rather than its parent.
+            for (uint32_t i = 0; i < iso->directory_count; ++i) {
+                struct iso9660_directory *dir = &iso->directories[i];
+                for (uint32_t j = 0; j < dir->count; ++j) {
+                    vfs_node_t node = dir->nodes[j];
+                    struct iso9660_entry *entry = node->assoc_info;
+                    if (!entry->directory) {
+                        node->next_sibling = NULL;
+                        vfs_node_destroy(node);
+                    }
+                }
+                if (dir->node) {
+                    dir->node->next_sibling = NULL;
+                    vfs_node_destroy(dir->node);
+                }
+                if (dir->is_loaded) {
+                    name_index_destroy(&dir->names);
+                }
+                free(dir->nodes);
+            }
+            if (iso->directories) {
+                name_index_destroy(&iso->paths);
+            }
+            arena_destroy(&iso->arena);
+            free(iso->directories);
+            free(iso->descriptor);
+        }
+        free(fs->assoc_info);
+        fs->assoc_info = NULL;
+    }
+}
+
+
+#pragma mark - Working Directory
+
+static vfs_node_t iso9660_current_directory(vfs_t fs)
+{
+    assert(fs);
+    iso9660_t iso = fs->assoc_info;
+    if (iso->current_dir == &iso->directories[ISO9660_ROOT_DIRECTORY - 1]) {
+        return NULL;
+    }
+
+    vfs_node_t node = iso9660_directory_node(fs, iso->current_dir);
+    return vfs_node_init(fs,
+                         ".",
+                         node->attributes,
+                         vfs_node_used,
+                         node->assoc_info);
+}
+
+static vfs_node_t iso9660_get_directory_list(vfs_t fs)
+{
+    assert(fs);
+    iso9660_t iso = fs->assoc_info;
+    return iso9660_directory_list(fs, iso->current_dir);
+}
+
+static vfs_node_t iso9660_list_directory(vfs_t fs, vfs_node_t directory)
+{
+    assert(fs);
+    struct iso9660_directory *dir = iso9660_directory_for(fs, directory);
+    return dir ? iso9660_directory_list(fs, dir) : NULL;
+}
+
+static void iso9660_set_directory(vfs_t fs, vfs_node_t directory)
+{
+    assert(fs);
+    iso9660_t iso = fs->assoc_info;
+    if (iso) {
+        struct iso9660_directory *dir = iso9660_directory_for(fs, directory);
+        if (dir) {
+            iso->current_dir = dir;
+        }
+    }
+}
+
+
+#pragma mark - High Level File Support
+
+static void iso9660_read_only(const char *name)
+{
+    fprintf(stderr, "Could not modify %s. ISO 9660 volumes are read-only.\n",
+            name);
+}
+
+static vfs_node_t iso9660_get_node(vfs_t fs, const char *name)
+{
+    iso9660_t iso = fs->assoc_info;
+    return iso9660_find(fs, iso->current_dir, name);
+}
+
+static vfs_node_t iso9660_lookup(vfs_t fs,
+                                 vfs_node_t directory,
+                                 const char *name)
+{
+    assert(fs);
+    assert(name);
+    struct iso9660_directory *dir = iso9660_directory_for(fs, directory);
+    return dir ? iso9660_find(fs, dir, name) : NULL;
+}
+
+static void iso9660_create_file(vfs_t fs,
+                                const char *name,
+                                enum vfs_node_attributes a)
+{
+    (void)fs;
+    (void)a;
+    iso9660_read_only(name);
+}
+
+static vfs_node_t iso9660_create_dir(vfs_t fs,
+                                     const char *name,
+                                     enum vfs_node_attributes a)
+{
+    (void)fs;
+    (void)a;
+    iso9660_read_only(name);
+    return NULL;
+}
+
+static void iso9660_remove_file(vfs_t fs, const char *name)
+{
+    (void)fs;
+    iso9660_read_only(name);
+}
+
+static void iso9660_rename(vfs_t fs, const char *old, const char *name)
+{
+    (void)fs;
+    (void)name;
+    iso9660_read_only(old);
+}
+
+
+#pragma mark - File Data
+
+static uint32_t iso9660_file_transfer(vfs_t fs,
+                                      vfs_node_t node,
+                                      uint8_t *data,
+                                      uint32_t n,
+                                      uint32_t offset)
+{
+    // Each section is read directly from the device into the destination.
+    iso9660_t iso = fs->assoc_info;
+    struct iso9660_entry *entry = node->assoc_info;
+    uint32_t start = 0;
+    uint32_t done = 0;
+    for (uint32_t i = 0; i < entry->section_count && done < n; ++i) {
+        const struct iso9660_section *section = &entry->sections[i];
+        uint32_t end = start + section->size;
+        if (offset < end) {
+            uint32_t length = MIN(end - offset, n - done);
+            uint64_t position = iso9660_block_offset(iso, section->block)
+                              + (offset - start);
+            iso9660_read_bytes(fs->device, position, length, data + done);
+            done += length;
+            offset += length;
+        }
+        start = end;
+    }
+    return done;
+}
+
+static void iso9660_file_write(vfs_t fs,
+                               const char *name,
+                               void *data,
+                               uint32_t n)
+{
+    (void)fs;
+    (void)data;
+    (void)n;
+    iso9660_read_only(name);
+}
+
+static uint32_t iso9660_file_read(vfs_t fs, const char *name, void **data)
+{
+    assert(fs);
+    assert(data);
+
+    // Get the file in question. If we can't find it then ensure data out is
+    // NULL and return 0.
+    iso9660_t iso = fs->assoc_info;
+    vfs_node_t node = iso9660_find(fs, iso->current_dir, name);
+    if (!node || (node->attributes & vfs_node_directory_attribute)) {
+        *data = NULL;
+        return 0;
+    }
+
+    *data = calloc(node->size, sizeof(uint8_t));
+    return iso9660_file_transfer(fs, node, *data, node->size, 0);
+}
+
+
+#pragma mark - Streaming File Access
+
+static vfs_file_t iso9660_open(vfs_t fs,
+                               vfs_node_t directory,
+                               const char *name,
+                               uint8_t create)
+{
+    assert(fs);
+    assert(name);
+
+    // Opening a file to create it is only done in order to write to it,
+    // which is never possible. Directories can not be opened.
+    if (create) {
+        iso9660_read_only(name);
+        return NULL;
+    }
+
+    vfs_node_t node = iso9660_lookup(fs, directory, name);
+    if (!node || (node->attributes & vfs_node_directory_attribute)) {
+        return NULL;
+    }
+
+    // Nodes stay resident while the volume is mounted, so the node remains
+    // valid for as long as the file is open.
+    return vfs_file_init(fs, node, NULL);
+}
+
+static uint32_t iso9660_pread(vfs_t fs,
+                              vfs_file_t file,
+                              void *data,
+                              uint32_t n,
+                              uint32_t offset)
+{
+    assert(fs);
+    assert(file);
+
+    vfs_node_t node = file->node;
+    if (offset >= node->size) {
+        return 0;
+    }
+
+    n = MIN(n, node->size - offset);
+    return iso9660_file_transfer(fs, node, data, n, offset);
+}
+
+static uint32_t iso9660_pwrite(vfs_t fs,
+                               vfs_file_t file,
+                               const void *data,
+                               uint32_t n,
+                               uint32_t offset)
+{
+    assert(fs);
+    assert(file);
+    (void)data;
+    (void)n;
+    (void)offset;
+    iso9660_read_only(file->node->name);
+    return 0;
+}
+
+static int iso9660_truncate(vfs_t fs, vfs_file_t file, uint32_t size)
+{
+    assert(fs);
+    assert(file);
+    (void)size;
+    iso9660_read_only(file->node->name);
+    return 0;
+}
+
+static void iso9660_close(vfs_t fs, vfs_file_t file)
+{
+    assert(fs);
+    assert(file);
+}
+
+
+#pragma mark - Metadata Flushing
+
+static void iso9660_flush(vfs_t fs)
+{
+    // There is never anything to write back.
+    (void)fs;
+}
+
+static void iso9660_sync(vfs_t fs)
+{
+    // There is never anything to write back.
+    (void)fs;
+}
@@ -21,6 +21,7 @@
 */
 
 #include <assert.h>
+#include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -30,10 +31,14 @@
 #include <shell/scripting.h>
 #include <shell/shell.h>
 #include <common/host.h>
+#include <common/host-tree.h>
+#include <device/virtual.h>
+#include <vfs/interface.h>
 
 #define IMGTOOL_VERSION_STRING  "imgtool version 0.1\n" \
                                 "(c) Tom Hancocks, 2017\n" \
-                                "Includes drivers: fat12\n"
+                                "Includes drivers: fat12, fat16, fat32, " \
+                                "exfat, ext2, iso9660\n"
 
 #pragma mark - Environment Variables
 
@@ -97,6 +102,131 @@ shell_variable_t construct_variables_from_environment(const char *env[])
 }
 
 
+#pragma mark - Image Construction
+
+#define IMAGE_SECTOR_SIZE  512
+
+uint32_t parse_image_size(const char *size)
+{
+    assert(size);
+
+    // Sizes are given in bytes, optionally suffixed with K, M or G, and are
+    // rounded up to a whole number of sectors. Anything else is rejected
+    // rather than quietly read as something smaller. A count too large for
+    // strtoull saturates, and is caught by the limit below.
+    char *suffix = (char *)size;
+    unsigned long long bytes = 0;
+    if (isdigit((unsigned char)*size)) {
+        bytes = strtoull(size, &suffix, 10);
+    }
+
+    unsigned long long scale = 0;
+    switch (*suffix) {
+        case '\0':
+            scale = 1;
+            break;
+        case 'K':
+        case 'k':
+            scale = 1024ULL;
+            break;
+        case 'M':
+        case 'm':
+            scale = 1024ULL * 1024;
+            break;
+        case 'G':
+        case 'g':
+            scale = 1024ULL * 1024 * 1024;
+            break;
+    }
+
+    if (scale == 0 || (scale > 1 && suffix[1] != '\0')) {
+        fprintf(stderr, "Invalid image size: %s. Use bytes, K, M or G.\n",
+                size);
+        return 0;
+    }
+    else if (bytes == 0) {
+        fprintf(stderr, "The image size must be greater than zero.\n");
+        return 0;
+    }
+
+    // The sector count of a device is 32 bits wide.
+    unsigned long long limit = (unsigned long long)UINT32_MAX
+                             * IMAGE_SECTOR_SIZE;
+    if (bytes > limit / scale) {
+        fprintf(stderr, "Image size %s is larger than the limit of %u "
+                        "sectors (%llu bytes).\n",
+                size,
+                UINT32_MAX,
+                limit);
+        return 0;
+    }
+
+    bytes *= scale;
+    return (uint32_t)((bytes + IMAGE_SECTOR_SIZE - 1) / IMAGE_SECTOR_SIZE);
+}
+
+int build_image_from_directory(const char *image_path,
+                               const char *host_path,
+                               const char *type,
+                               const char *size)
+{
+    if (!image_path) {
+        fprintf(stderr, "An image must be specified with -o.\n");
+        return 0;
+    }
+
+    vfs_interface_t fs = vfs_interface_for(type);
+    if (!fs) {
+        fprintf(stderr, "Unrecognised file system type: %s\n", type);
+        return 0;
+    }
+    else if (!fs->build_device) {
+        fprintf(stderr, "Images can not be built as %s\n", type);
+        vfs_interface_destroy(fs);
+        return 0;
+    }
+
+    host_tree_t tree = host_tree_scan(host_path);
+    if (!tree) {
+        vfs_interface_destroy(fs);
+        return 0;
+    }
+
+    // Either use the size that was asked for, or make the image just large
+    // enough to hold the contents of the tree.
+    vdevice_t dev = device_create(image_path, vmedia_floppy);
+    uint32_t sectors = 0;
+    if (strcmp(size, "fit") == 0) {
+        sectors = fs->image_size(dev, tree);
+        if (sectors == 0) {
+            fprintf(stderr, "Unable to determine the size of the image.\n");
+        }
+    }
+    else {
+        sectors = parse_image_size(size);
+    }
+
+    int result = 0;
+    if (sectors != 0) {
+        device_init(dev, IMAGE_SECTOR_SIZE, sectors);
+        result = device_is_inited(dev) && fs->build_device(dev, NULL, tree);
+    }
+
+    if (result) {
+        printf("Built %s with %u files and %u directories (%u sectors)\n",
+               image_path,
+               tree->file_count,
+               tree->directory_count,
+               sectors);
+    }
+
+    device_destroy(dev);
+    host_tree_destroy(tree);
+    vfs_interface_destroy(fs);
+    return result;
+}
+
+
 #pragma mark - Core
 
 int main(int argc, const char * argv[], const char *env[])
@@ -110,8 +240,11 @@ int main(int argc, const char * argv[], const char *env[])
     // work with.
     const char *script_path = NULL;
     const char *image_path = NULL;
+    const char *build_path = NULL;
+    const char *build_type = "fat12";
+    const char *build_size = "fit";
     int c = 0;
-    while ((c = getopt(argc, (char **)argv, "s:o:v")) != -1) {
+    while ((c = getopt(argc, (char **)argv, "s:o:d:t:S:v")) != -1) {
         switch (c) {
             case 's': // User specified script
                 script_path = host_expand_path(optarg);
@@ -121,6 +254,18 @@ int main(int argc, const char * argv[], const char *env[])
                 image_path = host_expand_path(optarg);
                 break;
 
+            case 'd': // User specified a directory to build an image from
+                build_path = host_expand_path(optarg);
+                break;
+
+            case 't': // Filesystem type of the image to build
+                build_type = optarg;
+                break;
+
+            case 'S': // Size of the image to build, or `fit`
+                build_size = optarg;
+                break;
+
             case 'v': // Display the version
                 printf("%s\n", IMGTOOL_VERSION_STRING);
                 break;
@@ -130,6 +275,19 @@ int main(int argc, const char * argv[], const char *env[])
         }
     }
 
+    // Building an image from a directory is a one shot operation, and does
+    // not need the shell at all.
+    if (build_path) {
+        int result = build_image_from_directory(image_path,
+                                                build_path,
+                                                build_type,
+                                                build_size);
+        free((void *)build_path);
+        free((void *)script_path);
+        free((void *)image_path);
+        return result ? 0 : 1;
+    }
+
     // If there is a shell script path specified, construct a new shell script
     // object.
     shell_script_t script = shell_script_open(script_path);
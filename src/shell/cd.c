@@ -21,8 +21,10 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 
 #include <shell/cd.h>
+#include <shell/location.h>
 #include <shell/shell.h>
 
 #include <vfs/vfs.h>
@@ -39,7 +41,32 @@ int shell_cd(shell_t shell, int argc, const char *argv[])
         return SHELL_ERROR_CODE;
     }
 
-    vfs_navigate_to_path(shell->device_filesystem, argv[1]);
+    if (!shell->device_filesystem) {
+        fprintf(stderr, "No filesystem is currently mounted.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    // Relative paths are always on the current volume, so the working
+    // directory can not be moved onto a volume at another mount point.
+    char *path = NULL;
+    vfs_t vfs = shell_resolve_image_path(shell, argv[1], &path);
+    if (!vfs) {
+        return SHELL_ERROR_CODE;
+    }
+    else if (vfs != shell->device_filesystem) {
+        fprintf(stderr,
+                "Could not navigate to %s. It is on another mounted volume.\n",
+                argv[1]);
+        free(path);
+        return SHELL_ERROR_CODE;
+    }
+
+    int result = vfs_navigate_to_path(vfs, path);
+    free(path);
+    if (!result) {
+        fprintf(stderr, "Could not navigate to %s.\n", argv[1]);
+        return SHELL_ERROR_CODE;
+    }
 
     return SHELL_OK;
 }
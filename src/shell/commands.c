@@ -41,6 +41,13 @@
 #include <shell/read.h>
 #include <shell/export.h>
 #include <shell/cd.h>
+#include <shell/sync.h>
+#include <shell/mv.h>
+#include <shell/cp.h>
+#include <shell/get.h>
+#include <shell/import-tree.h>
+#include <shell/insert.h>
+#include <shell/fallocate.h>
 
 void shell_register_commands(shell_t shell)
 {
@@ -50,6 +57,7 @@ void shell_register_commands(shell_t shell)
     shell_add_command(shell, shell_command_create("format", shell_format));
     shell_add_command(shell, shell_command_create("mount", shell_mount));
     shell_add_command(shell, shell_command_create("unmount", shell_unmount));
+    shell_add_command(shell, shell_command_create("mounts", shell_mounts));
     shell_add_command(shell, shell_command_create("touch", shell_touch));
     shell_add_command(shell, shell_command_create("import", shell_import));
     shell_add_command(shell, shell_command_create("export", shell_export));
@@ -64,5 +72,17 @@ void shell_register_commands(shell_t shell)
     shell_add_command(shell, shell_command_create("init", shell_init_dev));
     shell_add_command(shell, shell_command_create("rm", shell_rm));
     shell_add_command(shell, shell_command_create("cd", shell_cd));
+    shell_add_command(shell, shell_command_create("sync", shell_sync));
+    shell_add_command(shell, shell_command_create("begin", shell_begin));
+    shell_add_command(shell, shell_command_create("commit", shell_commit));
+    shell_add_command(shell, shell_command_create("mv", shell_mv));
+    shell_add_command(shell, shell_command_create("cp", shell_cp));
+    shell_add_command(shell, shell_command_create("get", shell_get));
+    shell_add_command(shell, shell_command_create("import-tree",
+                                                  shell_import_tree));
+    shell_add_command(shell, shell_command_create("insert", shell_insert));
+    shell_add_command(shell, shell_command_create("eject", shell_eject));
+    shell_add_command(shell, shell_command_create("fallocate",
+                                                  shell_fallocate));
 }
 
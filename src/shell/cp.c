@@ -0,0 +1,156 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <shell/cp.h>
+#include <shell/shell.h>
+#include <shell/location.h>
+#include <common/host.h>
+#include <vfs/vfs.h>
+
+#define SHELL_CP_CHUNK_SIZE     (64 * 1024)
+
+int shell_copy_to_image(vfs_t vfs,
+                        const char *host_path,
+                        const char *image_path,
+                        uint32_t *copied)
+{
+    FILE *f = fopen(host_path, "rb");
+    if (!f) {
+        fprintf(stderr, "Could not open %s\n", host_path);
+        return 0;
+    }
+
+    // Files on the image are limited to 4GiB, so make sure the source will
+    // actually fit before touching the image.
+    fseek(f, 0L, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0L, SEEK_SET);
+    if (size < 0 || (unsigned long)size > UINT32_MAX) {
+        fprintf(stderr, "%s is too large to copy.\n", host_path);
+        fclose(f);
+        return 0;
+    }
+
+    vfs_file_t file = vfs_open(vfs, image_path, 1);
+    if (!file) {
+        fprintf(stderr, "Could not create %s on the image.\n", image_path);
+        fclose(f);
+        return 0;
+    }
+
+    // Any existing contents are replaced. The data is then streamed across a
+    // chunk at a time, so the size of the file has no bearing on how much
+    // memory is needed.
+    vfs_truncate(file, 0);
+
+    uint8_t *chunk = malloc(SHELL_CP_CHUNK_SIZE);
+    uint32_t offset = 0;
+    size_t n = 0;
+    while ((n = fread(chunk, sizeof(*chunk), SHELL_CP_CHUNK_SIZE, f)) > 0) {
+        if (vfs_pwrite(file, chunk, (uint32_t)n, offset) != n) {
+            fprintf(stderr, "Failed to write %s to the image.\n", image_path);
+            break;
+        }
+        offset += (uint32_t)n;
+    }
+
+    free(chunk);
+    vfs_close(file);
+    fclose(f);
+
+    if (copied) {
+        *copied = offset;
+    }
+    return offset == (uint32_t)size;
+}
+
+int shell_cp(shell_t shell, int argc, const char *argv[])
+{
+    assert(shell);
+
+    if (argc != 3) {
+        fprintf(stderr, "Expected a source and a destination to copy.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    struct shell_location source;
+    struct shell_location destination;
+    if (!shell_parse_location(argv[1], shell_location_host, &source) ||
+        !shell_parse_location(argv[2], shell_location_image, &destination))
+    {
+        fprintf(stderr,
+                "Expected a path for both the source and destination.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    if (destination.kind == shell_location_host) {
+        fprintf(stderr, "Copying to the host is not supported.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    char *image_path = NULL;
+    vfs_t vfs = shell_resolve_location(shell, &destination, &image_path);
+    if (!vfs) {
+        return SHELL_ERROR_CODE;
+    }
+
+    // Copies between two volumes go straight from one device to the other,
+    // and anything else comes from the host.
+    uint32_t copied = 0;
+    int result = 0;
+    if (source.kind != shell_location_host) {
+        char *source_path = NULL;
+        vfs_t source_vfs = shell_resolve_location(shell,
+                                                  &source,
+                                                  &source_path);
+        if (source_vfs) {
+            result = vfs_copy(source_vfs,
+                              source_path,
+                              vfs,
+                              image_path,
+                              &copied);
+            if (!result) {
+                fprintf(stderr, "Failed to copy %s to %s\n",
+                        argv[1], argv[2]);
+            }
+        }
+        free(source_path);
+    }
+    else {
+        const char *host_path = host_expand_path(source.path);
+        result = shell_copy_to_image(vfs, host_path, image_path, &copied);
+        free((void *)host_path);
+    }
+
+    free(image_path);
+    if (!result) {
+        return SHELL_ERROR_CODE;
+    }
+
+    printf("Copied %u bytes to %s\n", copied, destination.path);
+    return SHELL_OK;
+}
@@ -0,0 +1,90 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <shell/fallocate.h>
+#include <shell/location.h>
+#include <shell/shell.h>
+#include <vfs/vfs.h>
+
+static int shell_fallocate_parse_size(const char *argument, uint32_t *size)
+{
+    // Sizes are given in bytes, optionally suffixed with K or M.
+    char *suffix = NULL;
+    unsigned long long bytes = strtoull(argument, &suffix, 10);
+    if (suffix == argument) {
+        return 0;
+    }
+    else if (*suffix == 'K' || *suffix == 'k') {
+        bytes *= 1024;
+        ++suffix;
+    }
+    else if (*suffix == 'M' || *suffix == 'm') {
+        bytes *= 1024 * 1024;
+        ++suffix;
+    }
+
+    if (*suffix != '\0' || bytes > UINT32_MAX) {
+        return 0;
+    }
+    *size = (uint32_t)bytes;
+    return 1;
+}
+
+int shell_fallocate(struct shell *shell, int argc, const char *argv[])
+{
+    assert(shell);
+
+    if (argc != 3) {
+        fprintf(stderr, "Expected a file name and the size to reserve.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    uint32_t size = 0;
+    if (!shell_fallocate_parse_size(argv[2], &size)) {
+        fprintf(stderr, "Invalid size: %s\n", argv[2]);
+        return SHELL_ERROR_CODE;
+    }
+
+    char *path = NULL;
+    vfs_t vfs = shell_resolve_image_path(shell, argv[1], &path);
+    if (!vfs) {
+        return SHELL_ERROR_CODE;
+    }
+    else if (!vfs->filesystem_interface->preallocate) {
+        fprintf(stderr, "Space can not be reserved on %s volumes.\n",
+                vfs->type);
+        free(path);
+        return SHELL_ERROR_CODE;
+    }
+
+    int result = vfs_preallocate(vfs, path, size);
+    free(path);
+    if (!result) {
+        fprintf(stderr, "Could not reserve space for %s\n", argv[1]);
+        return SHELL_ERROR_CODE;
+    }
+
+    return SHELL_OK;
+}
@@ -0,0 +1,191 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <shell/get.h>
+#include <shell/shell.h>
+#include <shell/location.h>
+#include <common/host.h>
+#include <vfs/vfs.h>
+
+#define SHELL_GET_CHUNK_SIZE    (256 * 1024)
+
+struct shell_get_context {
+    vfs_t vfs;
+    uint8_t *chunk;
+    uint32_t files;
+    uint64_t bytes;
+};
+
+static int shell_get_path(struct shell_get_context *ctx,
+                          const char *image_path,
+                          const char *host_path);
+
+static int shell_get_file(struct shell_get_context *ctx,
+                          const char *image_path,
+                          const char *host_path)
+{
+    vfs_file_t file = vfs_open(ctx->vfs, image_path, 0);
+    if (!file) {
+        fprintf(stderr, "Could not open %s on the image.\n", image_path);
+        return 0;
+    }
+
+    int fd = open(host_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Could not create %s\n", host_path);
+        vfs_close(file);
+        return 0;
+    }
+
+    // Stream the file across in large sequential chunks, so that the size
+    // of the file has no bearing on how much memory is needed.
+    int result = 1;
+    uint32_t offset = 0;
+    uint32_t n = 0;
+    while ((n = vfs_pread(file, ctx->chunk, SHELL_GET_CHUNK_SIZE, offset))) {
+        if (pwrite(fd, ctx->chunk, n, offset) != (ssize_t)n) {
+            fprintf(stderr, "Failed to write to %s\n", host_path);
+            result = 0;
+            break;
+        }
+        offset += n;
+    }
+
+    close(fd);
+    vfs_close(file);
+
+    ctx->files++;
+    ctx->bytes += offset;
+    return result;
+}
+
+static int shell_get_directory(struct shell_get_context *ctx,
+                               const char *image_path,
+                               const char *host_path)
+{
+    if (mkdir(host_path, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create the directory %s\n", host_path);
+        return 0;
+    }
+
+    // Take a copy of the names in the directory up front. Exporting its
+    // contents will load other directories, which invalidates the list.
+    vfs_node_t list = vfs_list_directory(ctx->vfs, image_path);
+    uint32_t count = 0;
+    for (vfs_node_t node = list; node; node = node->next_sibling) {
+        count += (node->state == vfs_node_used);
+    }
+
+    char **names = calloc(count, sizeof(*names));
+    count = 0;
+    for (vfs_node_t node = list; node; node = node->next_sibling) {
+        if (node->state == vfs_node_used) {
+            names[count++] = strdup(node->name);
+        }
+    }
+
+    int result = 1;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (strcmp(names[i], ".") != 0 && strcmp(names[i], "..") != 0) {
+            char *image_child = host_join_path(image_path, names[i]);
+            char *host_child = host_join_path(host_path, names[i]);
+            result = shell_get_path(ctx, image_child, host_child) && result;
+            free(image_child);
+            free(host_child);
+        }
+        free(names[i]);
+    }
+    free(names);
+
+    return result;
+}
+
+static int shell_get_path(struct shell_get_context *ctx,
+                          const char *image_path,
+                          const char *host_path)
+{
+    vfs_node_t node = NULL;
+    if (!vfs_resolve(ctx->vfs, image_path, &node)) {
+        fprintf(stderr, "Could not find %s on the image.\n", image_path);
+        return 0;
+    }
+
+    if (!node || (node->attributes & vfs_node_directory_attribute)) {
+        return shell_get_directory(ctx, image_path, host_path);
+    }
+    else {
+        return shell_get_file(ctx, image_path, host_path);
+    }
+}
+
+int shell_get(shell_t shell, int argc, const char *argv[])
+{
+    assert(shell);
+
+    if (argc != 3) {
+        fprintf(stderr, "Expected a source and a destination to export.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    struct shell_location source;
+    struct shell_location destination;
+    if (!shell_parse_location(argv[1], shell_location_image, &source) ||
+        !shell_parse_location(argv[2], shell_location_host, &destination) ||
+        source.kind == shell_location_host ||
+        destination.kind != shell_location_host)
+    {
+        fprintf(stderr, "Expected an image source and a host destination.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    char *image_path = NULL;
+    vfs_t vfs = shell_resolve_location(shell, &source, &image_path);
+    if (!vfs) {
+        return SHELL_ERROR_CODE;
+    }
+
+    struct shell_get_context ctx = {
+        .vfs = vfs,
+        .chunk = malloc(SHELL_GET_CHUNK_SIZE),
+    };
+
+    const char *host_path = host_expand_path(destination.path);
+    int result = shell_get_path(&ctx, image_path, host_path);
+    free((void *)host_path);
+    free(image_path);
+    free(ctx.chunk);
+
+    printf("Exported %u file(s), %llu bytes\n",
+           ctx.files,
+           (unsigned long long)ctx.bytes);
+
+    return result ? SHELL_OK : SHELL_ERROR_CODE;
+}
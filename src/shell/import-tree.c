@@ -0,0 +1,129 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <shell/import-tree.h>
+#include <shell/location.h>
+#include <shell/shell.h>
+#include <shell/cp.h>
+#include <common/host.h>
+#include <common/host-tree.h>
+#include <vfs/vfs.h>
+
+static int shell_import_tree_directories(vfs_t vfs,
+                                         host_tree_entry_t dir,
+                                         const char *image_path)
+{
+    // Create every directory in the tree before any file data is written.
+    // Directories are allocated their clusters as they are created, so this
+    // keeps them together and leaves the file data one sequential run.
+    int result = 1;
+    for (host_tree_entry_t entry = dir->children; entry; entry = entry->next) {
+        if (!entry->is_directory) {
+            continue;
+        }
+
+        char *path = host_join_path(image_path, entry->name);
+        if (!vfs_mkdir(vfs, path)) {
+            fprintf(stderr, "Could not create the directory %s\n", path);
+            result = 0;
+        }
+        else {
+            result = shell_import_tree_directories(vfs, entry, path) && result;
+        }
+        free(path);
+    }
+    return result;
+}
+
+static int shell_import_tree_files(vfs_t vfs,
+                                   host_tree_entry_t dir,
+                                   const char *image_path)
+{
+    // Files are written in the same order as the tree was scanned, and each
+    // one is created just before its data is written so that its clusters
+    // follow on from those of the previous file.
+    int result = 1;
+    for (host_tree_entry_t entry = dir->children; entry; entry = entry->next) {
+        char *path = host_join_path(image_path, entry->name);
+        if (entry->is_directory) {
+            result = shell_import_tree_files(vfs, entry, path) && result;
+        }
+        else {
+            result = shell_copy_to_image(vfs, entry->path, path, NULL)
+                  && result;
+        }
+        free(path);
+    }
+    return result;
+}
+
+int shell_import_tree(shell_t shell, int argc, const char *argv[])
+{
+    assert(shell);
+
+    if (argc != 3) {
+        fprintf(stderr, "Expected a host directory and an image directory.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    char *image_path = NULL;
+    vfs_t vfs = shell_resolve_image_path(shell, argv[2], &image_path);
+    if (!vfs) {
+        return SHELL_ERROR_CODE;
+    }
+
+    // Scan the entire host tree up front, so that nothing is written to the
+    // image if the tree can't be read.
+    const char *host_path = host_expand_path(argv[1]);
+    host_tree_t tree = host_tree_scan(host_path);
+    free((void *)host_path);
+    if (!tree) {
+        free(image_path);
+        return SHELL_ERROR_CODE;
+    }
+
+    // All of the metadata is kept in memory while the tree is populated, and
+    // written back once at the end.
+    vfs_begin(vfs);
+    int result = vfs_mkdir(vfs, image_path);
+    result = result && shell_import_tree_directories(vfs,
+                                                     tree->root,
+                                                     image_path);
+    result = result && shell_import_tree_files(vfs, tree->root, image_path);
+    vfs_commit(vfs);
+
+    if (result) {
+        printf("Imported %u files and %u directories (%llu bytes)\n",
+               tree->file_count,
+               tree->directory_count,
+               (unsigned long long)tree->total_size);
+    }
+
+    host_tree_destroy(tree);
+    free(image_path);
+    return result ? SHELL_OK : SHELL_ERROR_CODE;
+}
@@ -0,0 +1,68 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <shell/insert.h>
+#include <shell/mount.h>
+#include <shell/shell.h>
+#include <vfs/vfs.h>
+#include <vfs/mount-table.h>
+
+int shell_insert(shell_t shell, int argc, const char *argv[])
+{
+    assert(shell);
+
+    if (argc != 2) {
+        fprintf(stderr, "Expected the path of an image to insert.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    if (vfs_mount_table_find(shell->mounts, SHELL_DISC_MOUNT_POINT)) {
+        fprintf(stderr, "An image is already inserted. Eject it first.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    // Inserting an image is a shorthand for mounting it at the disc mount
+    // point, which the `disc:` prefix of a location refers to.
+    return shell_mount_image(shell, argv[1], SHELL_DISC_MOUNT_POINT)
+        ? SHELL_OK
+        : SHELL_ERROR_CODE;
+}
+
+int shell_eject(shell_t shell, int argc, const char *argv[])
+{
+    assert(shell);
+    (void)argc;
+    (void)argv;
+
+    vfs_t disc = vfs_mount_table_remove(shell->mounts, SHELL_DISC_MOUNT_POINT);
+    if (!disc) {
+        fprintf(stderr, "No image is currently inserted.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    vfs_destroy(disc);
+    return SHELL_OK;
+}
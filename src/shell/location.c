@@ -0,0 +1,120 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <shell/location.h>
+#include <shell/insert.h>
+#include <shell/shell.h>
+#include <vfs/mount-table.h>
+
+int shell_parse_location(const char *argument,
+                         enum shell_location_kind fallback,
+                         struct shell_location *location)
+{
+    assert(argument);
+    assert(location);
+
+    // Locations are written as `host:path`, `image:path` or `disc:path`,
+    // the last referring to the image inserted at the disc mount point. When
+    // there is no prefix the path is taken to be in the fallback location.
+    if (strncmp(argument, "host:", 5) == 0) {
+        location->kind = shell_location_host;
+        location->path = argument + 5;
+    }
+    else if (strncmp(argument, "image:", 6) == 0) {
+        location->kind = shell_location_image;
+        location->path = argument + 6;
+    }
+    else if (strncmp(argument, "disc:", 5) == 0) {
+        location->kind = shell_location_disc;
+        location->path = argument + 5;
+    }
+    else {
+        location->kind = fallback;
+        location->path = argument;
+    }
+
+    return *location->path != '\0';
+}
+
+vfs_t shell_resolve_location(struct shell *shell,
+                             const struct shell_location *location,
+                             char **path)
+{
+    assert(shell);
+    assert(location);
+    assert(path);
+    assert(location->kind != shell_location_host);
+
+    // A disc path is always within the inserted image, and is relative to
+    // its own working directory when not absolute.
+    if (location->kind == shell_location_disc) {
+        vfs_t disc = vfs_mount_table_find(shell->mounts,
+                                          SHELL_DISC_MOUNT_POINT);
+        if (!disc) {
+            fprintf(stderr, "No image is inserted for disc:%s\n",
+                    location->path);
+            *path = NULL;
+            return NULL;
+        }
+        *path = strdup(location->path);
+        return disc;
+    }
+
+    // Otherwise the path may be within any of the mounted volumes, and
+    // relative paths are within the current one.
+    vfs_t vfs = vfs_mount_table_resolve(shell->mounts,
+                                        shell->device_filesystem,
+                                        location->path,
+                                        path);
+    if (!vfs) {
+        fprintf(stderr, "No filesystem is mounted for %s\n", location->path);
+        free(*path);
+        *path = NULL;
+    }
+    return vfs;
+}
+
+vfs_t shell_resolve_image_path(struct shell *shell,
+                               const char *argument,
+                               char **path)
+{
+    assert(argument);
+    assert(path);
+
+    struct shell_location location;
+    if (!shell_parse_location(argument, shell_location_image, &location)) {
+        fprintf(stderr, "Expected a path for %s\n", argument);
+        *path = NULL;
+        return NULL;
+    }
+    else if (location.kind == shell_location_host) {
+        fprintf(stderr, "Expected a path on an image, not %s\n", argument);
+        *path = NULL;
+        return NULL;
+    }
+    return shell_resolve_location(shell, &location, path);
+}
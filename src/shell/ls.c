@@ -20,7 +20,10 @@
  SOFTWARE.
 */
 
+#include <stdlib.h>
+
 #include <shell/ls.h>
+#include <shell/location.h>
 #include <shell/shell.h>
 
 #include <vfs/vfs.h>
@@ -28,8 +31,18 @@
 
 int shell_ls(shell_t shell, int argc, const char *argv[])
 {
-    // Ignore all arguments. We don't need them.
-    vfs_node_t dir_list = vfs_get_directory_list(shell->device_filesystem);
+    // With no path the working directory of the current volume is listed.
+    // A path is resolved across the mount table.
+    vfs_node_t dir_list = NULL;
+    if (argc >= 2) {
+        char *path = NULL;
+        vfs_t vfs = shell_resolve_image_path(shell, argv[1], &path);
+        dir_list = vfs ? vfs_list_directory(vfs, path) : NULL;
+        free(path);
+    }
+    else if (shell->device_filesystem) {
+        dir_list = vfs_get_directory_list(shell->device_filesystem);
+    }
     if (!dir_list) {
         fprintf(stderr, "Unable to list directory\n");
         return SHELL_ERROR_CODE;
@@ -21,8 +21,10 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 
 #include <shell/mkdir.h>
+#include <shell/location.h>
 #include <shell/shell.h>
 #include <vfs/vfs.h>
 
@@ -35,7 +37,14 @@ int shell_mkdir(struct shell *shell, int argc, const char *argv[])
         return SHELL_ERROR_CODE;
     }
 
-    vfs_mkdir(shell->device_filesystem, argv[1]);
+    char *path = NULL;
+    vfs_t vfs = shell_resolve_image_path(shell, argv[1], &path);
+    if (!vfs) {
+        return SHELL_ERROR_CODE;
+    }
+
+    vfs_mkdir(vfs, path);
+    free(path);
     
     return SHELL_OK;
 }
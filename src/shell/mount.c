@@ -21,21 +21,139 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
 
 #include <shell/mount.h>
 #include <shell/shell.h>
+#include <device/virtual.h>
+#include <common/host.h>
 #include <vfs/vfs.h>
+#include <vfs/mount-table.h>
+
+static int shell_mount_device(shell_t shell, vdevice_t dev, const char *point)
+{
+    vfs_t vfs = vfs_mount(dev);
+    if (!vfs || !vfs->assoc_info) {
+        fprintf(stderr, "Could not find a filesystem on %s\n", dev->path);
+        if (vfs) {
+            // The device is left for the caller to deal with.
+            vfs->device = NULL;
+            vfs_destroy(vfs);
+        }
+        return 0;
+    }
+
+    if (!vfs_mount_table_add(shell->mounts, point, vfs)) {
+        fprintf(stderr, "Could not mount at %s. It is already in use.\n",
+                point);
+        vfs->device = NULL;
+        vfs_destroy(vfs);
+        return 0;
+    }
+
+    printf("Mounted %s volume \"%s\" at %s.\n", vfs->type, dev->path, point);
+    return 1;
+}
+
+int shell_mount_image(shell_t shell, const char *image, const char *point)
+{
+    assert(shell);
+    assert(image);
+    assert(point);
+
+    const char *path = host_expand_path(image);
+    vdevice_t dev = device_create(path, vmedia_hard_disk);
+    free((void *)path);
+
+    if (!device_is_inited(dev)) {
+        fprintf(stderr, "Could not open %s\n", image);
+        device_destroy(dev);
+        return 0;
+    }
+    else if (!shell_mount_device(shell, dev, point)) {
+        device_destroy(dev);
+        return 0;
+    }
+    return 1;
+}
 
 int shell_mount(shell_t shell, int argc, const char *argv[])
 {
     assert(shell);
-    shell->device_filesystem = vfs_mount(shell->attached_device);
-    return shell->device_filesystem == NULL ? SHELL_ERROR_CODE : SHELL_OK;
+
+    // With no arguments the attached device becomes the current volume. A
+    // mount point on its own takes the attached device and mounts it there,
+    // freeing up the shell to attach another. An image and a mount point
+    // does the same without going through the attached device.
+    if (argc == 1) {
+        shell->device_filesystem = vfs_mount(shell->attached_device);
+        return shell->device_filesystem == NULL ? SHELL_ERROR_CODE : SHELL_OK;
+    }
+    else if (argc == 2) {
+        if (!shell->attached_device) {
+            fprintf(stderr, "There is no device attached to mount.\n");
+            return SHELL_ERROR_CODE;
+        }
+        if (shell->device_filesystem) {
+            fprintf(stderr, "The attached device is already mounted.\n");
+            return SHELL_ERROR_CODE;
+        }
+        if (!shell_mount_device(shell, shell->attached_device, argv[1])) {
+            return SHELL_ERROR_CODE;
+        }
+        shell->attached_device = NULL;
+        return SHELL_OK;
+    }
+    else if (argc == 3) {
+        return shell_mount_image(shell, argv[1], argv[2])
+            ? SHELL_OK
+            : SHELL_ERROR_CODE;
+    }
+
+    fprintf(stderr, "Expected an optional image and mount point.\n");
+    return SHELL_ERROR_CODE;
 }
 
 int shell_unmount(shell_t shell, int argc, const char *argv[])
 {
     assert(shell);
-    shell->device_filesystem = vfs_unmount(shell->device_filesystem);
+
+    if (argc == 1) {
+        shell->device_filesystem = vfs_unmount(shell->device_filesystem);
+        return SHELL_OK;
+    }
+
+    // Volumes at a mount point own their device, so it is released as the
+    // volume is unmounted.
+    vfs_t vfs = vfs_mount_table_remove(shell->mounts, argv[1]);
+    if (!vfs) {
+        fprintf(stderr, "Nothing is mounted at %s\n", argv[1]);
+        return SHELL_ERROR_CODE;
+    }
+    vfs_destroy(vfs);
+    return SHELL_OK;
+}
+
+int shell_mounts(shell_t shell, int argc, const char *argv[])
+{
+    assert(shell);
+    (void)argc;
+    (void)argv;
+
+    if (shell->device_filesystem) {
+        printf("/ %s \"%s\"\n",
+               shell->device_filesystem->type,
+               shell->device_filesystem->device->path);
+    }
+
+    struct vfs_mount_point *point = shell->mounts->first;
+    while (point) {
+        printf("%s %s \"%s\"\n",
+               point->path,
+               point->vfs->type,
+               point->vfs->device->path);
+        point = point->next;
+    }
     return SHELL_OK;
 }
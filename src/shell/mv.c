@@ -0,0 +1,64 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <shell/mv.h>
+#include <shell/location.h>
+#include <shell/shell.h>
+
+#include <vfs/vfs.h>
+
+int shell_mv(shell_t shell, int argc, const char *argv[])
+{
+    assert(shell);
+
+    if (argc != 3) {
+        fprintf(stderr, "Expected the current and new names of the file.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    // Both paths may be within any of the mounted volumes, but it must be
+    // the same one.
+    char *old_path = NULL;
+    char *new_path = NULL;
+    vfs_t vfs = shell_resolve_image_path(shell, argv[1], &old_path);
+    if (!vfs) {
+        return SHELL_ERROR_CODE;
+    }
+    vfs_t new_vfs = shell_resolve_image_path(shell, argv[2], &new_path);
+    int result = SHELL_OK;
+    if (!new_vfs) {
+        result = SHELL_ERROR_CODE;
+    }
+    else if (vfs != new_vfs || !vfs_rename(vfs, old_path, new_path)) {
+        fprintf(stderr,
+                "Could not rename %s. Files stay in their own directory.\n",
+                argv[1]);
+        result = SHELL_ERROR_CODE;
+    }
+
+    free(old_path);
+    free(new_path);
+    return result;
+}
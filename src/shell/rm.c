@@ -21,8 +21,10 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 
 #include <shell/rm.h>
+#include <shell/location.h>
 #include <shell/shell.h>
 
 #include <vfs/vfs.h>
@@ -35,8 +37,15 @@ int shell_rm(shell_t shell, int argc, const char *argv[])
         fprintf(stderr, "Expected a single argument for the file name.\n");
         return SHELL_ERROR_CODE;
     }
-    
-    vfs_remove(shell->device_filesystem, argv[1]);
+
+    char *path = NULL;
+    vfs_t vfs = shell_resolve_image_path(shell, argv[1], &path);
+    if (!vfs) {
+        return SHELL_ERROR_CODE;
+    }
+
+    vfs_remove(vfs, path);
+    free(path);
     
     return SHELL_OK;
 }
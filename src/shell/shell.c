@@ -55,6 +55,7 @@ shell_t shell_init(shell_variable_t vars,
     main_shell->script = script;
     main_shell->image_path = image_path;
     main_shell->first_variable = vars;
+    main_shell->mounts = vfs_mount_table_init();
     shell_register_commands(main_shell);
     
     return main_shell;
@@ -98,6 +99,14 @@ void shell_do(shell_t shell)
         printf("\n");
     }
 
+    // Metadata is written back lazily, so make sure anything still mounted is
+    // unmounted (and therefore synced) before we leave.
+    if (shell->device_filesystem) {
+        shell->device_filesystem = vfs_unmount(shell->device_filesystem);
+    }
+    vfs_mount_table_destroy(shell->mounts);
+    shell->mounts = NULL;
+
     // Clean up
     free(buffer);
 }
@@ -0,0 +1,81 @@
+/*
+ Copyright (c) 2017 Tom Hancocks
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <shell/sync.h>
+#include <shell/shell.h>
+#include <vfs/vfs.h>
+
+int shell_sync(shell_t shell, int argc, const char *argv[])
+{
+    assert(shell);
+    (void)argc;
+    (void)argv;
+
+    if (!shell->device_filesystem) {
+        fprintf(stderr, "No filesystem is currently mounted.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    if (!vfs_sync(shell->device_filesystem)) {
+        printf("A transaction is open. Changes will be written when it is "
+               "committed.\n");
+    }
+    return SHELL_OK;
+}
+
+int shell_begin(shell_t shell, int argc, const char *argv[])
+{
+    assert(shell);
+    (void)argc;
+    (void)argv;
+
+    if (!shell->device_filesystem) {
+        fprintf(stderr, "No filesystem is currently mounted.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    // Defer all metadata write-back until the matching commit.
+    vfs_begin(shell->device_filesystem);
+    return SHELL_OK;
+}
+
+int shell_commit(shell_t shell, int argc, const char *argv[])
+{
+    assert(shell);
+    (void)argc;
+    (void)argv;
+
+    if (!shell->device_filesystem) {
+        fprintf(stderr, "No filesystem is currently mounted.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    if (!vfs_commit(shell->device_filesystem)) {
+        fprintf(stderr, "There is no open transaction to commit.\n");
+        return SHELL_ERROR_CODE;
+    }
+
+    return SHELL_OK;
+}
@@ -0,0 +1,122 @@
+/*
+  Copyright (c) 2017 Tom Hancocks
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include <vfs/extent.h>
+
+vfs_extent_list_t vfs_extent_list_init()
+{
+    return calloc(1, sizeof(struct vfs_extent_list));
+}
+
+void vfs_extent_list_destroy(vfs_extent_list_t list)
+{
+    if (list) {
+        free(list->extents);
+    }
+    free(list);
+}
+
+void vfs_extent_list_append(vfs_extent_list_t list,
+                            uint32_t start,
+                            uint32_t length)
+{
+    assert(list);
+
+    if (length == 0) {
+        return;
+    }
+
+    // If the run continues on directly from the last extent, then simply
+    // extend that extent.
+    if (list->count > 0) {
+        struct vfs_extent *last = &list->extents[list->count - 1];
+        if (last->start + last->length == start) {
+            last->length += length;
+            list->sector_count += length;
+            return;
+        }
+    }
+
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 4;
+        list->extents = realloc(list->extents,
+                                list->capacity * sizeof(*list->extents));
+    }
+
+    struct vfs_extent *extent = &list->extents[list->count++];
+    extent->start = start;
+    extent->length = length;
+    extent->offset = list->sector_count;
+    list->sector_count += length;
+}
+
+uint32_t vfs_extent_list_sector(vfs_extent_list_t list, uint32_t n)
+{
+    assert(list);
+
+    if (n >= list->sector_count) {
+        return UINT32_MAX;
+    }
+
+    // Extents are ordered by their offset within the file, so the extent
+    // containing the sector can be found with a binary search.
+    uint32_t low = 0;
+    uint32_t high = list->count;
+    while (high - low > 1) {
+        uint32_t mid = low + ((high - low) / 2);
+        if (list->extents[mid].offset <= n) {
+            low = mid;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    struct vfs_extent *extent = &list->extents[low];
+    return extent->start + (n - extent->offset);
+}
+
+
+#pragma mark - Iteration
+
+void vfs_extent_iterator_init(struct vfs_extent_iterator *iterator,
+                              vfs_extent_list_t list)
+{
+    assert(iterator);
+    iterator->list = list;
+    iterator->index = 0;
+}
+
+const struct vfs_extent *vfs_extent_iterator_next(
+    struct vfs_extent_iterator *iterator
+)
+{
+    assert(iterator);
+
+    if (!iterator->list || iterator->index >= iterator->list->count) {
+        return NULL;
+    }
+
+    return &iterator->list->extents[iterator->index++];
+}
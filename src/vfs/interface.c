@@ -25,6 +25,11 @@
 #include <vfs/interface.h>
 
 #include <fat/fat12.h>
+#include <fat/fat16.h>
+#include <fat/fat32.h>
+#include <exfat/exfat.h>
+#include <ext2/ext2.h>
+#include <iso9660/iso9660.h>
 
 
 vfs_interface_t vfs_interface_init()
@@ -42,6 +47,21 @@ vfs_interface_t vfs_interface_for(const char *type)
     if (strcmp(type, "fat12") == 0) {
         return fat12_init();
     }
+    else if (strcmp(type, "fat16") == 0) {
+        return fat16_init();
+    }
+    else if (strcmp(type, "fat32") == 0) {
+        return fat32_init();
+    }
+    else if (strcmp(type, "exfat") == 0) {
+        return exfat_init();
+    }
+    else if (strcmp(type, "ext2") == 0) {
+        return ext2_init();
+    }
+    else if (strcmp(type, "iso9660") == 0) {
+        return iso9660_init();
+    }
     return NULL;
 }
 
@@ -50,5 +70,20 @@ vfs_interface_t vfs_interface_for_device(vdevice_t dev)
     if (fat12_test(dev, NULL)) {
         return fat12_init();
     }
+    else if (fat16_test(dev, NULL)) {
+        return fat16_init();
+    }
+    else if (fat32_test(dev, NULL)) {
+        return fat32_init();
+    }
+    else if (exfat_test(dev, NULL)) {
+        return exfat_init();
+    }
+    else if (ext2_test(dev, NULL)) {
+        return ext2_init();
+    }
+    else if (iso9660_test(dev, NULL)) {
+        return iso9660_init();
+    }
     return NULL;
 }
@@ -0,0 +1,164 @@
+/*
+  Copyright (c) 2017 Tom Hancocks
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <vfs/mount-table.h>
+#include <vfs/vfs.h>
+#include <vfs/path.h>
+
+vfs_mount_table_t vfs_mount_table_init()
+{
+    return calloc(1, sizeof(struct vfs_mount_table));
+}
+
+void vfs_mount_table_destroy(vfs_mount_table_t table)
+{
+    // Every volume still in the table is unmounted, which writes back any
+    // metadata that is still pending, and its device released.
+    if (table) {
+        struct vfs_mount_point *point = table->first;
+        while (point) {
+            struct vfs_mount_point *next = point->next;
+            vfs_destroy(point->vfs);
+            free(point->path);
+            free(point);
+            point = next;
+        }
+    }
+    free(table);
+}
+
+static struct vfs_mount_point **vfs_mount_table_link(vfs_mount_table_t table,
+                                                     const char *path)
+{
+    // Finds the link to the named point, or the link at the end of the table
+    // when there is no path.
+    struct vfs_mount_point **link = &table->first;
+    while (*link && (!path || strcmp((*link)->path, path) != 0)) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+int vfs_mount_table_add(vfs_mount_table_t table,
+                        const char *path,
+                        struct vfs *vfs)
+{
+    assert(table);
+    assert(path);
+    assert(vfs);
+
+    // The root belongs to the fallback volume, and each point can only hold
+    // a single volume.
+    char *normalised = vfs_normalise_path(NULL, path);
+    if (strcmp(normalised, "/") == 0 ||
+        *vfs_mount_table_link(table, normalised))
+    {
+        free(normalised);
+        return 0;
+    }
+
+    struct vfs_mount_point *point = calloc(1, sizeof(*point));
+    point->path = normalised;
+    point->length = (uint32_t)strlen(normalised);
+    point->vfs = vfs;
+    *vfs_mount_table_link(table, NULL) = point;
+    return 1;
+}
+
+struct vfs *vfs_mount_table_remove(vfs_mount_table_t table, const char *path)
+{
+    assert(table);
+    assert(path);
+
+    // The volume is handed back to the caller rather than being unmounted.
+    char *normalised = vfs_normalise_path(NULL, path);
+    struct vfs_mount_point **link = vfs_mount_table_link(table, normalised);
+    struct vfs_mount_point *point = *link;
+    free(normalised);
+    if (!point) {
+        return NULL;
+    }
+
+    struct vfs *vfs = point->vfs;
+    *link = point->next;
+    free(point->path);
+    free(point);
+    return vfs;
+}
+
+struct vfs *vfs_mount_table_find(vfs_mount_table_t table, const char *path)
+{
+    assert(table);
+    assert(path);
+
+    char *normalised = vfs_normalise_path(NULL, path);
+    struct vfs_mount_point *point = *vfs_mount_table_link(table, normalised);
+    free(normalised);
+    return point ? point->vfs : NULL;
+}
+
+struct vfs *vfs_mount_table_resolve(vfs_mount_table_t table,
+                                    struct vfs *fallback,
+                                    const char *path,
+                                    char **relative)
+{
+    assert(table);
+    assert(path);
+    assert(relative);
+
+    // Relative paths are always within the fallback volume, and are left
+    // for it to resolve against its own working directory.
+    if (*path != '/') {
+        *relative = strdup(path);
+        return fallback;
+    }
+
+    // Otherwise find the longest mount point that the path is within, and
+    // make the path relative to the root of the volume mounted there.
+    char *normalised = vfs_normalise_path(NULL, path);
+    struct vfs_mount_point *match = NULL;
+    for (struct vfs_mount_point *point = table->first;
+         point;
+         point = point->next)
+    {
+        if ((!match || point->length > match->length) &&
+            strncmp(normalised, point->path, point->length) == 0 &&
+            (normalised[point->length] == '/' ||
+             normalised[point->length] == '\0'))
+        {
+            match = point;
+        }
+    }
+
+    if (!match) {
+        *relative = normalised;
+        return fallback;
+    }
+
+    const char *rest = normalised + match->length;
+    *relative = strdup(*rest ? rest : "/");
+    free(normalised);
+    return match->vfs;
+}
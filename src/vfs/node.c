@@ -20,11 +20,14 @@
   SOFTWARE.
 */
 
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <vfs/node.h>
+#include <vfs/extent.h>
 #include <vfs/vfs.h>
+#include <common/arena.h>
 
 vfs_node_t vfs_node_init(struct vfs *fs,
                          const char *name,
@@ -42,17 +45,60 @@ vfs_node_t vfs_node_init(struct vfs *fs,
     size_t name_len = strlen(name);
     node->name = calloc(name_len + 1, sizeof(*node->name));
     strncpy((void *)node->name, name, name_len);
+    node->owns_name = 1;
     
     return node;
 }
 
+vfs_node_t vfs_node_init_in_arena(struct arena *arena,
+                                  struct vfs *fs,
+                                  const char *name,
+                                  enum vfs_node_attributes attributes,
+                                  enum vfs_node_state state,
+                                  void *node_info)
+{
+    vfs_node_t node = arena_alloc(arena, sizeof(*node));
+
+    node->fs = fs;
+    node->attributes = attributes;
+    node->state = state;
+    node->assoc_info = node_info;
+    node->name = arena_strdup(arena, name);
+    node->is_arena_owned = 1;
+
+    return node;
+}
+
 void vfs_node_destroy(vfs_node_t node)
 {
-    if (node) {
-        vfs_node_destroy(node->next_sibling);
+    // Destroys the node along with all of the siblings that follow it. This
+    // is done iteratively, as a directory can have many thousands of entries.
+    while (node) {
+        vfs_node_t next = node->next_sibling;
+        vfs_extent_list_destroy(node->extents);
+        if (node->owns_name) {
+            free((void *)node->name);
+        }
+        if (!node->is_arena_owned) {
+            free(node);
+        }
+        node = next;
+    }
+}
+
+void vfs_node_set_name(vfs_node_t node, const char *name)
+{
+    assert(node);
+    assert(name);
+
+    if (node->owns_name) {
         free((void *)node->name);
     }
-    free(node);
+
+    size_t name_len = strlen(name);
+    node->name = calloc(name_len + 1, sizeof(*node->name));
+    memcpy((void *)node->name, name, name_len);
+    node->owns_name = 1;
 }
 
 
@@ -0,0 +1,114 @@
+/*
+  Copyright (c) 2017 Tom Hancocks
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <vfs/path-cache.h>
+
+vfs_path_cache_t vfs_path_cache_init()
+{
+    vfs_path_cache_t cache = calloc(1, sizeof(*cache));
+
+    // Entries start out in generation 0, so starting the cache in generation
+    // 1 means they are all considered empty.
+    cache->generation = 1;
+    return cache;
+}
+
+void vfs_path_cache_destroy(vfs_path_cache_t cache)
+{
+    if (cache) {
+        for (uint32_t i = 0; i < VFS_PATH_CACHE_SIZE; ++i) {
+            free(cache->entries[i].path);
+        }
+    }
+    free(cache);
+}
+
+static uint32_t vfs_path_hash(const char *path, uint32_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < length; ++i) {
+        hash ^= (uint8_t)path[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int vfs_path_cache_get(vfs_path_cache_t cache,
+                       const char *path,
+                       uint32_t length,
+                       vfs_node_t *node)
+{
+    assert(cache);
+    assert(path);
+    assert(node);
+
+    uint32_t hash = vfs_path_hash(path, length);
+    struct vfs_path_cache_entry *entry;
+    entry = &cache->entries[hash & (VFS_PATH_CACHE_SIZE - 1)];
+
+    if (entry->generation != cache->generation ||
+        entry->hash != hash ||
+        entry->length != length ||
+        memcmp(entry->path, path, length) != 0)
+    {
+        return 0;
+    }
+
+    *node = entry->node;
+    return 1;
+}
+
+void vfs_path_cache_put(vfs_path_cache_t cache,
+                        const char *path,
+                        uint32_t length,
+                        vfs_node_t node)
+{
+    assert(cache);
+    assert(path);
+
+    // Each path can only live in one slot, so whatever currently occupies it
+    // is simply replaced.
+    uint32_t hash = vfs_path_hash(path, length);
+    struct vfs_path_cache_entry *entry;
+    entry = &cache->entries[hash & (VFS_PATH_CACHE_SIZE - 1)];
+
+    if (entry->length < length || !entry->path) {
+        free(entry->path);
+        entry->path = malloc(length);
+    }
+    memcpy(entry->path, path, length);
+
+    entry->hash = hash;
+    entry->length = length;
+    entry->generation = cache->generation;
+    entry->node = node;
+}
+
+void vfs_path_cache_invalidate(vfs_path_cache_t cache)
+{
+    if (cache) {
+        cache->generation++;
+    }
+}
@@ -109,3 +109,65 @@ vfs_path_node_t vfs_construct_path(const char *path)
     
     return first;
 }
+
+char *vfs_normalise_path(const char *cwd, const char *path)
+{
+    assert(path);
+
+    // Relative paths are resolved against the working directory, so begin
+    // with the working directory and append the path to it.
+    const char *base = (*path == '/' || !cwd) ? "" : cwd;
+    uint32_t base_len = (uint32_t)strlen(base);
+    uint32_t path_len = (uint32_t)strlen(path);
+    char *result = calloc(base_len + path_len + 2, sizeof(*result));
+    uint32_t length = 0;
+
+    // Walk over each component of the combined path, copying it to the
+    // result. Empty and "." components are dropped, and ".." components
+    // remove the last component that was copied.
+    const char *sources[2] = { base, path };
+    for (int s = 0; s < 2; ++s) {
+        const char *ptr = sources[s];
+        while (*ptr) {
+            while (*ptr == '/') {
+                ptr++;
+            }
+
+            const char *start = ptr;
+            while (*ptr && *ptr != '/') {
+                ptr++;
+            }
+            uint32_t component_len = (uint32_t)(ptr - start);
+
+            if (component_len == 0 ||
+                (component_len == 1 && start[0] == '.'))
+            {
+                continue;
+            }
+
+            if (component_len == 2 && start[0] == '.' && start[1] == '.') {
+                while (length > 0 && result[length - 1] != '/') {
+                    length--;
+                }
+                if (length > 0) {
+                    length--;
+                }
+                result[length] = '\0';
+                continue;
+            }
+
+            result[length++] = '/';
+            memcpy(result + length, start, component_len);
+            length += component_len;
+            result[length] = '\0';
+        }
+    }
+
+    // The root directory is the only path that ends with a separator.
+    if (length == 0) {
+        result[length++] = '/';
+        result[length] = '\0';
+    }
+
+    return result;
+}
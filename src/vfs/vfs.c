@@ -26,6 +26,19 @@
 #include <vfs/vfs.h>
 #include <vfs/interface.h>
 
+// Files copied between volumes are moved in chunks of this size, so that
+// the size of the file has no bearing on how much memory is needed.
+#define VFS_COPY_CHUNK_SIZE  (64 * 1024)
+
+#ifdef MIN
+#   undef MIN
+#endif
+
+#define MIN(a,b) \
+    ({ __typeof__ (a) _a = (a); \
+       __typeof__ (b) _b = (b); \
+       _a < _b ? _a : _b; })
+
 vfs_t vfs_init(vdevice_t dev, vfs_interface_t interface)
 {
     assert(dev);
@@ -35,6 +48,7 @@ vfs_t vfs_init(vdevice_t dev, vfs_interface_t interface)
     vfs->device = dev;
     vfs->filesystem_interface = interface;
     vfs->type = interface->type_name();
+    vfs->paths = vfs_path_cache_init();
 
     return vfs;
 }
@@ -45,6 +59,8 @@ void vfs_destroy(vfs_t vfs)
         vfs->filesystem_interface->unmount_filesystem(vfs);
         vfs_interface_destroy(vfs->filesystem_interface);
         device_destroy(vfs->device);
+        vfs_path_cache_destroy(vfs->paths);
+        free(vfs->cwd);
     }
     free(vfs);
 }
@@ -68,6 +84,7 @@ vfs_t vfs_mount(vdevice_t dev)
     // Now mount the file system, and ensure the current directory is root.
     vfs->assoc_info = vfsi->mount_filesystem(vfs);
     vfsi->set_directory(vfs, NULL);
+    vfs->cwd = vfs_normalise_path(NULL, "/");
 
     return vfs;
 }
@@ -75,7 +92,11 @@ vfs_t vfs_mount(vdevice_t dev)
 vfs_t vfs_unmount(vfs_t vfs)
 {
     if (vfs) {
+        // Unmounting implicitly commits any open transaction. The filesystem
+        // is responsible for writing back its dirty metadata as it unmounts.
+        vfs->transaction_depth = 0;
         vfs->filesystem_interface->unmount_filesystem(vfs);
+        vfs_invalidate_paths(vfs);
     }
     return NULL;
 }
@@ -84,7 +105,7 @@ vfs_t vfs_unmount(vfs_t vfs)
 const char *vfs_pwd(vfs_t vfs)
 {
     if (vfs && vfs->assoc_info) {
-        return "/";
+        return vfs->cwd;
     }
     else {
         return "<unmounted>";
@@ -100,51 +121,178 @@ vfs_node_t vfs_get_directory_list(vfs_t vfs)
     return NULL;
 }
 
-void vfs_navigate_to_path(vfs_t vfs, const char *path)
+vfs_node_t vfs_list_directory(vfs_t vfs, const char *path)
 {
     assert(vfs);
-    vfs_path_node_t path_node = vfs_construct_path(path);
 
-    // Get the original directory
-    vfs_node_t orig_dir = vfs->filesystem_interface->current_directory(vfs);
-
-    if (!path_node || (path_node && path_node->is_root)) {
-        // Navigate to the root node.
-        vfs->filesystem_interface->set_directory(vfs, NULL);
+    vfs_node_t dir = NULL;
+    if (!vfs_resolve(vfs, path, &dir) ||
+        (dir && (dir->attributes & vfs_node_directory_attribute) == 0))
+    {
+        return NULL;
     }
 
-    if (!path_node || strlen(path_node->name) == 0) {
-        // We have nothing left to do. Finish.
-        return;
+    return vfs->filesystem_interface->list_directory(vfs, dir);
+}
+
+
+#pragma mark - Path Resolution
+
+static int vfs_resolve_normalised(vfs_t vfs, char *path, vfs_node_t *node)
+{
+    // The full path is the most likely thing to be in the cache, especially
+    // when the same file is queried repeatedly.
+    uint32_t length = (uint32_t)strlen(path);
+    if (vfs_path_cache_get(vfs->paths, path, length, node)) {
+        return 1;
     }
 
-    while (path_node) {
-        // Search for a node in the current directory with the name of the
-        // path node. Fail if we don't and restore the original directory.
-        const char *name = path_node->name;
-        vfs_node_t dir = vfs->filesystem_interface->get_node(vfs, name);
+    // Walk each component of the path, starting at the root. Each prefix of
+    // the path is checked against the cache before asking the filesystem to
+    // look up the component. Only successful lookups are cached.
+    vfs_node_t current = NULL;
+    uint32_t i = 1;
+    while (i < length) {
+        uint32_t start = i;
+        while (i < length && path[i] != '/') {
+            i++;
+        }
 
-        if (!dir || !(dir && dir->attributes & vfs_node_directory_attribute)) {
-            // Failure. Navigate back to the original directory
-            vfs->filesystem_interface->set_directory(vfs, orig_dir);
-            break;
+        // Only directories can be descended into.
+        if (current && !(current->attributes & vfs_node_directory_attribute)) {
+            return 0;
         }
 
-        // Set the directory to this one, and continue descending.
-        vfs->filesystem_interface->set_directory(vfs, dir);
+        if (!vfs_path_cache_get(vfs->paths, path, i, &current)) {
+            char separator = path[i];
+            path[i] = '\0';
+            const char *name = path + start;
+            current = vfs->filesystem_interface->lookup(vfs, current, name);
+            path[i] = separator;
+
+            if (!current) {
+                return 0;
+            }
+            vfs_path_cache_put(vfs->paths, path, i, current);
+        }
 
-        // Next path component
-        path_node = path_node->next;
+        // Skip over the separator.
+        i++;
     }
-    
-    // Clean up
+
+    *node = current;
+    return 1;
+}
+
+int vfs_resolve(vfs_t vfs, const char *path, vfs_node_t *node)
+{
+    assert(vfs);
+    assert(path);
+    assert(node);
+
+    if (!vfs->assoc_info) {
+        return 0;
+    }
+
+    char *normalised = vfs_normalise_path(vfs->cwd, path);
+    int result = vfs_resolve_normalised(vfs, normalised, node);
+    free(normalised);
+    return result;
+}
+
+static int vfs_resolve_parent(vfs_t vfs,
+                              char *normalised,
+                              vfs_node_t *dir,
+                              const char **name)
+{
+    // Split the path into its parent directory and the name within it. The
+    // path is cut in two in place. The root directory has no parent, and so
+    // can not be split.
+    char *separator = strrchr(normalised, '/');
+    if (separator[1] == '\0') {
+        return 0;
+    }
+
+    *name = separator + 1;
+    *dir = NULL;
+    if (separator == normalised) {
+        return 1;
+    }
+
+    *separator = '\0';
+    return vfs_resolve_normalised(vfs, normalised, dir)
+        && ((*dir)->attributes & vfs_node_directory_attribute);
+}
+
+void vfs_invalidate_paths(vfs_t vfs)
+{
+    assert(vfs);
+    vfs_path_cache_invalidate(vfs->paths);
+}
+
+int vfs_navigate_to_path(vfs_t vfs, const char *path)
+{
+    assert(vfs);
+    assert(path);
+
+    if (!vfs->assoc_info) {
+        return 0;
+    }
+
+    // Resolve the destination first, so that the working directory is only
+    // ever changed once and only if the destination is valid.
+    char *normalised = vfs_normalise_path(vfs->cwd, path);
+    vfs_node_t dir = NULL;
+    if (!vfs_resolve_normalised(vfs, normalised, &dir) ||
+        (dir && (dir->attributes & vfs_node_directory_attribute) == 0))
+    {
+        free(normalised);
+        return 0;
+    }
+
+    vfs->filesystem_interface->set_directory(vfs, dir);
+    free(vfs->cwd);
+    vfs->cwd = normalised;
+    return 1;
+}
+
+
+#pragma mark - File Operations
+
+static vfs_node_t vfs_enter_directory(vfs_t vfs, vfs_node_t dir)
+{
+    // Files can only be created, removed and renamed in the working directory
+    // of the filesystem, so it is moved for the duration of the operation.
+    // The original is returned so that it can be put back afterwards.
+    vfs_node_t orig_dir = vfs->filesystem_interface->current_directory(vfs);
+    vfs->filesystem_interface->set_directory(vfs, dir);
+    return orig_dir;
+}
+
+static void vfs_leave_directory(vfs_t vfs, vfs_node_t orig_dir)
+{
+    vfs->filesystem_interface->set_directory(vfs, orig_dir);
     vfs_node_destroy(orig_dir);
 }
 
 void vfs_touch(vfs_t vfs, const char *path)
 {
     assert(vfs);
-    vfs->filesystem_interface->create_file(vfs, path, 0);
+    assert(path);
+
+    if (!vfs->assoc_info) {
+        return;
+    }
+
+    char *normalised = vfs_normalise_path(vfs->cwd, path);
+    vfs_node_t dir = NULL;
+    const char *name = NULL;
+    if (vfs_resolve_parent(vfs, normalised, &dir, &name)) {
+        vfs_node_t orig_dir = vfs_enter_directory(vfs, dir);
+        vfs->filesystem_interface->create_file(vfs, name, 0);
+        vfs_leave_directory(vfs, orig_dir);
+    }
+    free(normalised);
 }
 
 int vfs_mkdir(vfs_t vfs, const char *path)
@@ -152,45 +300,59 @@ int vfs_mkdir(vfs_t vfs, const char *path)
     assert(vfs);
     
     // Get the current directory. We'll need to restore it after the command
-    // completes.
+    // completes, as directories can only be created in the working directory.
     vfs_node_t orig_dir = vfs->filesystem_interface->current_directory(vfs);
+    char *normalised = vfs_normalise_path(vfs->cwd, path);
     
-    // Construct an actual path from the string provided. If the path starts
-    // at root, then navigate to root.
-    vfs_path_node_t path_node = vfs_construct_path(path);
-    if (path_node->is_root) {
-        vfs->filesystem_interface->set_directory(vfs, NULL);
-    }
-
     // Step through the path. Each time we can not find the appropriate
     // directory, create it.
-    while (path_node) {
-        const char *name = path_node->name;
-        vfs_node_t dir = vfs->filesystem_interface->get_node(vfs, name);
+    vfs_node_t dir = NULL;
+    uint32_t length = (uint32_t)strlen(normalised);
+    uint32_t i = 1;
+    int result = 1;
+    while (i < length) {
+        uint32_t start = i;
+        while (i < length && normalised[i] != '/') {
+            i++;
+        }
 
-        // Did we find the directory? If so was it a directory?
-        if (dir->state == vfs_node_used &&
-            (dir->attributes & vfs_node_directory_attribute) == 0)
-        {
-            vfs->filesystem_interface->set_directory(vfs, orig_dir);
-            return 0;
+        char separator = normalised[i];
+        normalised[i] = '\0';
+
+        vfs_node_t node = NULL;
+        if (!vfs_path_cache_get(vfs->paths, normalised, i, &node)) {
+            const char *name = normalised + start;
+            node = vfs->filesystem_interface->lookup(vfs, dir, name);
+
+            // If there was no returned result then simply create the node.
+            if (!node) {
+                vfs->filesystem_interface->set_directory(vfs, dir);
+                node = vfs->filesystem_interface->create_dir(vfs, name, 0);
+            }
+
+            if (node) {
+                vfs_path_cache_put(vfs->paths, normalised, i, node);
+            }
         }
 
-        // If there was no returned result then simply create the node.
-        if (dir->state == vfs_node_unused || dir->state == vfs_node_available) {
-            dir = vfs->filesystem_interface->create_dir(vfs, name, 0);
+        normalised[i] = separator;
+
+        // The directory could not be created, or the name is already in use
+        // by a file.
+        if (!node || (node->attributes & vfs_node_directory_attribute) == 0) {
+            result = 0;
+            break;
         }
 
-        // Navigate into the directory and repeat the process on the next
-        // component.
-        vfs->filesystem_interface->set_directory(vfs, dir);
-        
-        // Go to the next path component.
-        path_node = path_node->next;
+        // Repeat the process on the next component.
+        dir = node;
+        i++;
     }
 
     vfs->filesystem_interface->set_directory(vfs, orig_dir);
-    return 1;
+    vfs_node_destroy(orig_dir);
+    free(normalised);
+    return result;
 }
 
 void vfs_write(vfs_t vfs, const char *name, uint8_t *bytes, uint32_t size)
@@ -206,98 +368,317 @@ uint32_t vfs_read(vfs_t vfs, const char *name, uint8_t **bytes)
     return vfs->filesystem_interface->read(vfs, name, (void **)bytes);
 }
 
-void vfs_remove(vfs_t vfs, const char *name)
+void vfs_remove(vfs_t vfs, const char *path)
 {
     assert(vfs);
-    vfs->filesystem_interface->remove(vfs, name);
+    assert(path);
+
+    if (!vfs->assoc_info) {
+        return;
+    }
+
+    char *normalised = vfs_normalise_path(vfs->cwd, path);
+    vfs_node_t dir = NULL;
+    const char *name = NULL;
+    if (vfs_resolve_parent(vfs, normalised, &dir, &name)) {
+        vfs_node_t orig_dir = vfs_enter_directory(vfs, dir);
+        vfs->filesystem_interface->remove(vfs, name);
+        vfs_leave_directory(vfs, orig_dir);
+    }
+    free(normalised);
+    vfs_invalidate_paths(vfs);
 }
 
-vfs_node_t vfs_get_file(vfs_t vfs, const char *path)
+int vfs_rename(vfs_t vfs, const char *old_path, const char *new_path)
 {
     assert(vfs);
+    assert(old_path);
+    assert(new_path);
 
-    // Get the current directory. We'll need to restore it after the command
-    // completes.
-    vfs_node_t orig_dir = vfs->filesystem_interface->current_directory(vfs);
+    if (!vfs->assoc_info) {
+        return 0;
+    }
 
-    // Construct an actual path from the string provided. If the path starts
-    // at root, then navigate to root.
-    vfs_path_node_t path_node = vfs_construct_path(path);
-    if (path_node->is_root) {
-        vfs->filesystem_interface->set_directory(vfs, NULL);
+    // Entries can only be renamed within the directory that holds them, so
+    // both paths must lead to the same directory.
+    char *old_normalised = vfs_normalise_path(vfs->cwd, old_path);
+    char *new_normalised = vfs_normalise_path(vfs->cwd, new_path);
+    char *new_separator = strrchr(new_normalised, '/');
+    size_t length = (size_t)(strrchr(old_normalised, '/') - old_normalised);
+    vfs_node_t dir = NULL;
+    const char *old_name = NULL;
+    int result = new_separator[1] != '\0'
+              && length == (size_t)(new_separator - new_normalised)
+              && strncmp(old_normalised, new_normalised, length) == 0
+              && vfs_resolve_parent(vfs, old_normalised, &dir, &old_name);
+
+    if (result) {
+        vfs_node_t orig_dir = vfs_enter_directory(vfs, dir);
+        vfs->filesystem_interface->rename(vfs, old_name, new_separator + 1);
+        vfs_leave_directory(vfs, orig_dir);
+        vfs_invalidate_paths(vfs);
     }
 
-    // Step through the path. Each time we can not find the appropriate
-    // directory, create it.
-    while (path_node) {
-        const char *name = path_node->name;
-        vfs_node_t node = vfs->filesystem_interface->get_node(vfs, name);
-
-        // Do we have a node? If not abort.
-        if (!node) {
-            vfs->filesystem_interface->set_directory(vfs, orig_dir);
-            return NULL;
-        }
+    free(old_normalised);
+    free(new_normalised);
+    return result;
+}
+
+
 
-        // Is this the last path_node? Is the directory attribute set?
-        if (!path_node->next) {
-            if (node->attributes & vfs_node_directory_attribute) {
-                // Can't return a dictory here.
-                vfs->filesystem_interface->set_directory(vfs, orig_dir);
-                return NULL;
+#pragma mark - Streaming File Access
+
+vfs_file_t vfs_open(vfs_t vfs, const char *path, int create)
+{
+    assert(vfs);
+    assert(path);
+
+    if (!vfs->assoc_info) {
+        return NULL;
+    }
+
+    // Find the directory the file is in. The root directory itself can not be
+    // opened as a file.
+    char *normalised = vfs_normalise_path(vfs->cwd, path);
+    vfs_node_t dir = NULL;
+    const char *name = NULL;
+    vfs_file_t file = NULL;
+    if (vfs_resolve_parent(vfs, normalised, &dir, &name)) {
+        file = vfs->filesystem_interface->open(vfs, dir, name, create ? 1 : 0);
+    }
+
+    free(normalised);
+    return file;
+}
+
+uint32_t vfs_pread(vfs_file_t file, void *bytes, uint32_t n, uint32_t offset)
+{
+    assert(file);
+    vfs_t vfs = file->fs;
+    return vfs->filesystem_interface->pread(vfs, file, bytes, n, offset);
+}
+
+uint32_t vfs_pwrite(vfs_file_t file,
+                    const void *bytes,
+                    uint32_t n,
+                    uint32_t offset)
+{
+    assert(file);
+    vfs_t vfs = file->fs;
+    return vfs->filesystem_interface->pwrite(vfs, file, bytes, n, offset);
+}
+
+int vfs_truncate(vfs_file_t file, uint32_t size)
+{
+    assert(file);
+    vfs_t vfs = file->fs;
+    return vfs->filesystem_interface->truncate(vfs, file, size);
+}
+
+void vfs_close(vfs_file_t file)
+{
+    if (file) {
+        vfs_t vfs = file->fs;
+        vfs->filesystem_interface->close(vfs, file);
+    }
+    vfs_file_destroy(file);
+}
+
+int vfs_preallocate(vfs_t vfs, const char *path, uint32_t size)
+{
+    assert(vfs);
+    assert(path);
+
+    // The file is created if it does not exist yet, so that space can be
+    // set aside for it before anything is written.
+    if (!vfs->filesystem_interface->preallocate) {
+        return 0;
+    }
+
+    vfs_file_t file = vfs_open(vfs, path, 1);
+    if (!file) {
+        return 0;
+    }
+
+    int result = vfs->filesystem_interface->preallocate(vfs, file, size);
+    vfs_close(file);
+    return result;
+}
+
+#pragma mark - Copying Between Volumes
+
+int vfs_copy(vfs_t source,
+             const char *source_path,
+             vfs_t destination,
+             const char *destination_path,
+             uint32_t *copied)
+{
+    assert(source);
+    assert(destination);
+
+    vfs_file_t from = vfs_open(source, source_path, 0);
+    vfs_file_t to = from ? vfs_open(destination, destination_path, 1) : NULL;
+    if (!to || to->node == from->node) {
+        vfs_close(to);
+        vfs_close(from);
+        return 0;
+    }
+
+    // Any existing contents of the destination are replaced.
+    vfs_truncate(to, 0);
+
+    // When the runs of sectors holding the source account for all of it,
+    // they are read directly from its device. Anything else, such as a file
+    // with holes in it, is read through the filesystem.
+    uint32_t size = from->node->size;
+    uint32_t bps = source->device->sector_size;
+    vfs_extent_list_t extents = source->filesystem_interface->extents(
+        source,
+        from->node
+    );
+    int direct = extents
+              && (uint64_t)extents->sector_count * bps >= size
+              && VFS_COPY_CHUNK_SIZE >= bps;
+
+    uint8_t *chunk = malloc(VFS_COPY_CHUNK_SIZE);
+    uint32_t offset = 0;
+    int failed = 0;
+    if (direct) {
+        struct vfs_extent_iterator it;
+        const struct vfs_extent *extent;
+        vfs_extent_iterator_init(&it, extents);
+        while (!failed && offset < size &&
+               (extent = vfs_extent_iterator_next(&it)))
+        {
+            uint32_t sector = extent->start;
+            uint32_t remaining = extent->length;
+            while (remaining > 0 && offset < size) {
+                uint32_t count = MIN(remaining, VFS_COPY_CHUNK_SIZE / bps);
+                uint32_t n = MIN(count * bps, size - offset);
+                device_read_sectors_into(source->device, sector, count, chunk);
+                if (vfs_pwrite(to, chunk, n, offset) != n) {
+                    failed = 1;
+                    break;
+                }
+                offset += n;
+                sector += count;
+                remaining -= count;
             }
-            else {
-                // We have our candidate!
-                return node;
+        }
+    }
+    else {
+        while (offset < size) {
+            uint32_t n = vfs_pread(from, chunk, VFS_COPY_CHUNK_SIZE, offset);
+            if (n == 0 || vfs_pwrite(to, chunk, n, offset) != n) {
+                break;
             }
+            offset += n;
         }
+    }
 
-        // We need to navigate into the node. Ensure it's a directory, otherwise
-        // fail.
-        if ((node->attributes & vfs_node_directory_attribute) == 0) {
-            vfs->filesystem_interface->set_directory(vfs, orig_dir);
-            return NULL;
-        }
+    free(chunk);
+    vfs_close(to);
+    vfs_close(from);
+
+    if (copied) {
+        *copied = offset;
+    }
+    return offset == size;
+}
+
+#pragma mark - Metadata Write-back
 
-        // Navigate into the directory and repeat the process on the next
-        // component.
-        vfs->filesystem_interface->set_directory(vfs, node);
+int vfs_sync(vfs_t vfs)
+{
+    assert(vfs);
 
-        // Go to the next path component.
-        path_node = path_node->next;
+    // While a transaction is open, write-back is deferred until the outermost
+    // transaction is committed, and the caller is told so.
+    if (vfs->transaction_depth > 0) {
+        return 0;
+    }
+    else if (vfs->assoc_info) {
+        vfs->filesystem_interface->sync(vfs);
     }
+    return 1;
+}
 
-    // If we get here, everything wen't wrong!
-    return NULL;
+void vfs_begin(vfs_t vfs)
+{
+    assert(vfs);
+    vfs->transaction_depth++;
 }
 
-uint32_t vfs_sector_count_of(vfs_t vfs, const char *path)
+int vfs_commit(vfs_t vfs)
 {
     assert(vfs);
 
-    // Get the file. If there is no file return UINT32_MAX to denote no file.
-    vfs_node_t file = vfs_get_file(vfs, path);
-    if (!file) {
+    if (vfs->transaction_depth == 0) {
         return 0;
     }
 
-    return file->sector_count;
+    // Only the outermost commit causes the metadata to be written back.
+    if (--vfs->transaction_depth == 0) {
+        vfs_sync(vfs);
+    }
+
+    return 1;
 }
 
-uint32_t vfs_nth_sector_of(vfs_t vfs, uint32_t n, const char *path)
+
+#pragma mark - Sector Queries
+
+vfs_node_t vfs_get_file(vfs_t vfs, const char *path)
+{
+    assert(vfs);
+
+    // Directories are not files, and can not be returned here.
+    vfs_node_t node = NULL;
+    if (!vfs_resolve(vfs, path, &node) ||
+        !node ||
+        (node->attributes & vfs_node_directory_attribute))
+    {
+        return NULL;
+    }
+
+    return node;
+}
+
+vfs_extent_list_t vfs_extents_of(vfs_t vfs, const char *path)
 {
     assert(vfs);
 
-    // Get the file. If there is no file return UINT32_MAX to denote no file.
     vfs_node_t file = vfs_get_file(vfs, path);
     if (!file) {
-        return UINT32_MAX;
+        return NULL;
+    }
+
+    return vfs->filesystem_interface->extents(vfs, file);
+}
+
+uint32_t vfs_sector_count_of(vfs_t vfs, const char *path)
+{
+    assert(vfs);
+
+    // Get the file. If there is no file return 0 to denote no sectors.
+    vfs_extent_list_t extents = vfs_extents_of(vfs, path);
+    if (!extents) {
+        return 0;
     }
 
-    // Make sure that we have requested a valid sector number.
-    if (n >= file->sector_count) {
+    return extents->sector_count;
+}
+
+uint32_t vfs_nth_sector_of(vfs_t vfs, uint32_t n, const char *path)
+{
+    assert(vfs);
+
+    // Get the file. If there is no file return UINT32_MAX to denote no file.
+    // The extent list also reports UINT32_MAX for an invalid sector number.
+    vfs_extent_list_t extents = vfs_extents_of(vfs, path);
+    if (!extents) {
         return UINT32_MAX;
     }
 
-    return file->sectors[n];
+    return vfs_extent_list_sector(extents, n);
 }